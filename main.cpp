@@ -28,6 +28,7 @@ typedef unsigned short uint16;
 typedef unsigned int uint32;
 
 #include "config.h"
+#include "Capture.h"
 
 // Try to figure out what endian this machine is using. Note that the test
 // below might fail for cross compilation; additionally, multi-byte
@@ -99,61 +100,6 @@ struct Rect
 };
 
 
-// TGA Header struct to make it simple to dump a TGA to disc.
-
-#if defined(_MSC_VER) || defined(__GNUC__)
-#pragma pack(push, 1)
-#pragma pack(1)               // Dont pad the following struct.
-#endif
-
-struct TGAHeader
-{
-    uint8   idLength,           // Length of optional identification sequence.
-        paletteType,        // Is a palette present? (1=yes)
-        imageType;          // Image data type (0=none, 1=indexed, 2=rgb,
-                            // 3=grey, +8=rle packed).
-    uint16  firstPaletteEntry,  // First palette index, if present.
-        numPaletteEntries;  // Number of palette entries, if present.
-    uint8   paletteBits;        // Number of bits per palette entry.
-    uint16  x,                  // Horiz. pixel coord. of lower left of image.
-        y,                  // Vert. pixel coord. of lower left of image.
-        width,              // Image width in pixels.
-        height;             // Image height in pixels.
-    uint8   depth,              // Image color depth (bits per pixel).
-        descriptor;         // Image attribute flags.
-};
-
-#if defined(_MSC_VER) || defined(__GNUC__)
-#pragma pack(pop)
-#endif
-
-
-bool
-WriteTGA(const std::string& filename,
-    const Pixel32* pxl,
-    uint16 width,
-    uint16 height)
-{
-    std::ofstream file(filename.c_str(), std::ios::binary);
-    if (file)
-    {
-        TGAHeader header;
-        memset(&header, 0, sizeof(TGAHeader));
-        header.imageType = 2;
-        header.width = width;
-        header.height = height;
-        header.depth = 32;
-        header.descriptor = 0x20;
-
-        file.write((const char*)&header, sizeof(TGAHeader));
-        file.write((const char*)pxl, sizeof(Pixel32) * width * height);
-
-        return true;
-    }
-    return false;
-}
-
-
 // A horizontal pixel span generated by the FreeType renderer.
 
 struct Span
@@ -322,7 +268,7 @@ WriteGlyphAsTGA(FT_Library& library,
                             }
 
                         // Dump the image to disk.
-                        WriteTGA(fileName, pxl, imgWidth, imgHeight);
+                        utils::capture::writeTGA(fileName, imgWidth, imgHeight, sizeof(Pixel32), reinterpret_cast<const uint8*>(pxl));
 
                         delete[] pxl;
                     }
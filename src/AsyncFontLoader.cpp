@@ -0,0 +1,194 @@
+#include "AsyncFontLoader.h"
+#include "TextSource.h"
+
+#include <algorithm>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double msBetween(Clock::time_point a, Clock::time_point b)
+    {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    }
+}
+
+bool FontLoadHandle::isDone() const
+{
+    auto status = _status.load();
+    return status != FontLoadStatus::QUEUED && status != FontLoadStatus::LOADING;
+}
+
+FontLoadStatus FontLoadHandle::wait() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this]() { return isDone(); });
+    return _status.load();
+}
+
+bool FontLoadHandle::waitFor(std::chrono::milliseconds timeout) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _done.wait_for(lock, timeout, [this]() { return isDone(); });
+}
+
+FontFreeType* FontLoadHandle::get()
+{
+    return wait() == FontLoadStatus::LOADED ? _font.get() : nullptr;
+}
+
+std::unique_ptr<FontFreeType> FontLoadHandle::release()
+{
+    if (wait() != FontLoadStatus::LOADED) return nullptr;
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::move(_font);
+}
+
+bool FontLoadHandle::cancel()
+{
+    // the I/O thread checks the status between chunks and drops the data
+    auto expected = FontLoadStatus::QUEUED;
+    if (_status.compare_exchange_strong(expected, FontLoadStatus::CANCELLED)
+        || (expected == FontLoadStatus::LOADING && _status.compare_exchange_strong(expected, FontLoadStatus::CANCELLED)))
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done.notify_all();
+        return true;
+    }
+    return false;
+}
+
+void FontLoadHandle::finish(FontLoadStatus status)
+{
+    auto expected = FontLoadStatus::LOADING;
+    if (!_status.compare_exchange_strong(expected, status))
+    {
+        // cancelled meanwhile
+        _font.reset();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done.notify_all();
+}
+
+AsyncFontLoader::AsyncFontLoader(size_t chunkSize) : _chunkSize(chunkSize)
+{
+    _thread = std::thread(&AsyncFontLoader::run, this);
+}
+
+AsyncFontLoader::~AsyncFontLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        while (!_queue.empty())
+        {
+            _queue.top().handle->cancel();
+            _queue.pop();
+        }
+        if (_current)
+        {
+            _current->cancel();
+        }
+    }
+    _wake.notify_all();
+    _thread.join();
+}
+
+std::shared_ptr<FontLoadHandle> AsyncFontLoader::load(const std::string& font, float fontSize, float outline, int priority)
+{
+    auto handle = std::make_shared<FontLoadHandle>();
+    handle->_fontName = font;
+    handle->_fontSize = fontSize;
+    handle->_outline = outline;
+    handle->_priority = priority;
+    handle->_queuedAt = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push(Request{ priority, _sequence++, handle });
+    }
+    _wake.notify_one();
+    return handle;
+}
+
+void AsyncFontLoader::pause()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _paused = true;
+}
+
+void AsyncFontLoader::resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _paused = false;
+    }
+    _wake.notify_one();
+}
+
+size_t AsyncFontLoader::getPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queue.size() + (_current ? 1 : 0);
+}
+
+void AsyncFontLoader::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _wake.wait(lock, [this]() { return _stop || (!_paused && !_queue.empty()); });
+        if (_stop) break;
+
+        auto handle = _queue.top().handle;
+        _queue.pop();
+        _current = handle;
+        lock.unlock();
+        loadOne(*handle);
+        lock.lock();
+        _current.reset();
+    }
+}
+
+void AsyncFontLoader::loadOne(FontLoadHandle& handle)
+{
+    auto expected = FontLoadStatus::QUEUED;
+    if (!handle._status.compare_exchange_strong(expected, FontLoadStatus::LOADING))
+    {
+        return; // cancelled while queued
+    }
+
+    auto started = Clock::now();
+    handle._stats.queued = msBetween(handle._queuedAt, started);
+
+    utils::FileTextSource file;
+    std::vector<uint8_t> data;
+    bool ok = file.open(handle._fontName);
+    if (ok)
+    {
+        data.resize(static_cast<size_t>(file.size()));
+        size_t got = 0;
+        while (got < data.size() && handle.getStatus() == FontLoadStatus::LOADING)
+        {
+            size_t n = file.read(reinterpret_cast<char*>(data.data()) + got, std::min(_chunkSize, data.size() - got));
+            if (n == 0) break;
+            got += n;
+        }
+        ok = got == data.size();
+    }
+    if (handle.getStatus() != FontLoadStatus::LOADING)
+    {
+        return;
+    }
+    auto read = Clock::now();
+    handle._stats.read = msBetween(started, read);
+    handle._stats.bytes = data.size();
+
+    if (ok)
+    {
+        handle._font.reset(new FontFreeType(handle._fontName, handle._fontSize, handle._outline));
+        ok = handle._font->loadFont(std::move(data));
+        if (!ok) handle._font.reset();
+    }
+    handle._stats.face = msBetween(read, Clock::now());
+    handle.finish(ok ? FontLoadStatus::LOADED : FontLoadStatus::FAILED);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "FontFreetype.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class FontLoadStatus {
+    QUEUED,
+    LOADING,
+    LOADED,
+    FAILED,
+    CANCELLED,
+};
+
+/**
+* Timings of one load in milliseconds.
+*/
+struct FontLoadStats {
+    double queued = 0;  // waiting for the I/O thread
+    double read = 0;    // reading the file
+    double face = 0;    // creating the face
+    uint64_t bytes = 0;
+
+    double total() const { return queued + read + face; }
+};
+
+/**
+* Result of AsyncFontLoader::load(), similar to a std::future of the font.
+*/
+class FontLoadHandle {
+public:
+    FontLoadStatus getStatus() const { return _status.load(); }
+
+    /**
+    * True once the load has finished, failed or been cancelled.
+    */
+    bool isDone() const;
+
+    /**
+    * Blocks until the load is done, returns the final status.
+    */
+    FontLoadStatus wait() const;
+    bool waitFor(std::chrono::milliseconds timeout) const;
+
+    /**
+    * Waits for the load and returns the font, nullptr if it failed or was
+    * cancelled. The handle keeps the ownership.
+    */
+    FontFreeType* get();
+
+    /**
+    * Waits for the load and hands the font over to the caller.
+    */
+    std::unique_ptr<FontFreeType> release();
+
+    /**
+    * Stops the load if it has not finished yet. A file being read is
+    * abandoned between two chunks. Returns false if it was already done.
+    */
+    bool cancel();
+
+    const std::string& getFontName() const { return _fontName; }
+    int getPriority() const { return _priority; }
+
+    /**
+    * Valid once the status is LOADED or FAILED.
+    */
+    const FontLoadStats& getStats() const { return _stats; }
+
+private:
+    friend class AsyncFontLoader;
+
+    void finish(FontLoadStatus status);
+
+    std::string _fontName;
+    float _fontSize = 0;
+    float _outline = 0;
+    int _priority = 0;
+
+    std::atomic<FontLoadStatus> _status{ FontLoadStatus::QUEUED };
+    std::unique_ptr<FontFreeType> _font;
+    FontLoadStats _stats;
+    std::chrono::steady_clock::time_point _queuedAt;
+
+    mutable std::mutex _mutex;
+    mutable std::condition_variable _done;
+};
+
+/**
+* Loads fonts on a background I/O thread so that large fallback fonts do not
+* block the startup.
+*
+* Requests with a higher priority are served first, equal priorities in
+* request order. Files are read in chunks, the face is created once the whole
+* file is in memory.
+*/
+class AsyncFontLoader {
+public:
+    explicit AsyncFontLoader(size_t chunkSize = 256 * 1024);
+
+    /**
+    * Cancels all pending loads and joins the I/O thread.
+    */
+    virtual ~AsyncFontLoader();
+
+    std::shared_ptr<FontLoadHandle> load(const std::string& font, float fontSize, float outline, int priority = 0);
+
+    /**
+    * Stops starting new loads, e.g. while a frame must not be disturbed by
+    * I/O. A load in progress is finished.
+    */
+    void pause();
+    void resume();
+
+    /**
+    * Number of loads queued or in progress.
+    */
+    size_t getPendingCount() const;
+
+private:
+    struct Request {
+        int priority;
+        uint64_t sequence;
+        std::shared_ptr<FontLoadHandle> handle;
+
+        bool operator<(const Request& o) const
+        {
+            // std::priority_queue pops the largest
+            return priority != o.priority ? priority < o.priority : sequence > o.sequence;
+        }
+    };
+
+    void run();
+    void loadOne(FontLoadHandle& handle);
+
+    size_t _chunkSize = 0;
+    std::priority_queue<Request> _queue;
+    uint64_t _sequence = 0;
+    std::shared_ptr<FontLoadHandle> _current;
+    bool _stop = false;
+    bool _paused = false;
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::thread _thread;
+};
@@ -0,0 +1,512 @@
+#include "BitmapKernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BITMAPKERNELS_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#define BITMAPKERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+    // source pixels [first, first + count) and their weights for each
+    // destination pixel along one axis, the weights of a pixel sum to 1
+    struct Taps {
+        std::vector<int> first;
+        std::vector<int> count;
+        std::vector<int> offset;
+        std::vector<float> weights;
+    };
+
+    void buildTaps(int srcSize, int dstSize, Taps& taps)
+    {
+        const double ratio = static_cast<double>(srcSize) / dstSize;
+        for (int d = 0; d < dstSize; d++)
+        {
+            const double begin = d * ratio;
+            const double end = std::min<double>((d + 1) * ratio, srcSize);
+            const int first = static_cast<int>(begin);
+            taps.first.push_back(first);
+            taps.offset.push_back(static_cast<int>(taps.weights.size()));
+            int count = 0;
+            for (int s = first; s < srcSize && s < end; s++)
+            {
+                const double covered = std::min<double>(end, s + 1) - std::max<double>(begin, s);
+                taps.weights.push_back(static_cast<float>(covered / ratio));
+                count++;
+            }
+            taps.count.push_back(count);
+        }
+    }
+
+    inline uint8_t toByte(float v)
+    {
+        // round half to even like the SIMD conversions
+        return static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, std::nearbyint(v))));
+    }
+
+#if BITMAPKERNELS_SSE2
+    inline __m128 loadPixel(const uint8_t* p)
+    {
+        int v;
+        memcpy(&v, p, 4);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i x = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero);
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero));
+    }
+#elif BITMAPKERNELS_NEON
+    inline float32x4_t loadPixel(const uint8_t* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        const uint16x8_t x = vmovl_u8(vcreate_u8(v));
+        return vcvtq_f32_u32(vmovl_u16(vget_low_u16(x)));
+    }
+#endif
+
+    // horizontal pass, one float per channel
+    void scaleRows(const uint8_t* src, int srcWidth, int srcHeight, const Taps& taps, int dstWidth, float* out)
+    {
+        for (int y = 0; y < srcHeight; y++)
+        {
+            const uint8_t* row = src + y * srcWidth * 4;
+            float* dst = out + y * dstWidth * 4;
+            for (int x = 0; x < dstWidth; x++)
+            {
+                const uint8_t* p = row + taps.first[x] * 4;
+                const float* w = taps.weights.data() + taps.offset[x];
+                const int n = taps.count[x];
+#if BITMAPKERNELS_SSE2
+                __m128 acc = _mm_setzero_ps();
+                for (int k = 0; k < n; k++)
+                {
+                    acc = _mm_add_ps(acc, _mm_mul_ps(loadPixel(p + k * 4), _mm_set1_ps(w[k])));
+                }
+                _mm_storeu_ps(dst + x * 4, acc);
+#elif BITMAPKERNELS_NEON
+                float32x4_t acc = vdupq_n_f32(0.0f);
+                for (int k = 0; k < n; k++)
+                {
+                    acc = vaddq_f32(acc, vmulq_n_f32(loadPixel(p + k * 4), w[k]));
+                }
+                vst1q_f32(dst + x * 4, acc);
+#else
+                float acc[4] = { 0, 0, 0, 0 };
+                for (int k = 0; k < n; k++)
+                {
+                    for (int c = 0; c < 4; c++)
+                    {
+                        acc[c] += p[k * 4 + c] * w[k];
+                    }
+                }
+                memcpy(dst + x * 4, acc, sizeof(acc));
+#endif
+            }
+        }
+    }
+
+    // acc[i] += row[i] * w
+    inline void accumulate(float* acc, const float* row, size_t n, float w)
+    {
+        size_t i = 0;
+#if BITMAPKERNELS_SSE2
+        const __m128 w4 = _mm_set1_ps(w);
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(row + i), w4)));
+        }
+#elif BITMAPKERNELS_NEON
+        for (; i + 4 <= n; i += 4)
+        {
+            vst1q_f32(acc + i, vaddq_f32(vld1q_f32(acc + i), vmulq_n_f32(vld1q_f32(row + i), w)));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            acc[i] += row[i] * w;
+        }
+    }
+
+    inline void storeBytes(uint8_t* dst, const float* v, size_t n)
+    {
+        size_t i = 0;
+#if BITMAPKERNELS_SSE2
+        for (; i + 16 <= n; i += 16)
+        {
+            const __m128i a = _mm_packs_epi32(_mm_cvtps_epi32(_mm_loadu_ps(v + i)), _mm_cvtps_epi32(_mm_loadu_ps(v + i + 4)));
+            const __m128i b = _mm_packs_epi32(_mm_cvtps_epi32(_mm_loadu_ps(v + i + 8)), _mm_cvtps_epi32(_mm_loadu_ps(v + i + 12)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+        }
+#elif BITMAPKERNELS_NEON
+        for (; i + 8 <= n; i += 8)
+        {
+            const int16x4_t a = vqmovn_s32(vcvtnq_s32_f32(vld1q_f32(v + i)));
+            const int16x4_t b = vqmovn_s32(vcvtnq_s32_f32(vld1q_f32(v + i + 4)));
+            vst1_u8(dst + i, vqmovun_s16(vcombine_s16(a, b)));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            dst[i] = toByte(v[i]);
+        }
+    }
+
+    // x / 255 rounded, exact for x <= 255 * 255
+    inline uint32_t div255(uint32_t x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    // round(v / 17), exact for every byte
+    inline uint8_t quantizeA4(uint32_t v)
+    {
+        return static_cast<uint8_t>((v * 15 + 135) >> 8);
+    }
+
+    inline void blendMaskPixel(uint8_t* dst, uint8_t coverage, const uint8_t bgra[4])
+    {
+        const uint32_t a = div255(coverage * bgra[3]);
+        const uint32_t inv = 255 - a;
+        dst[0] = static_cast<uint8_t>(div255(bgra[0] * a) + div255(dst[0] * inv));
+        dst[1] = static_cast<uint8_t>(div255(bgra[1] * a) + div255(dst[1] * inv));
+        dst[2] = static_cast<uint8_t>(div255(bgra[2] * a) + div255(dst[2] * inv));
+        dst[3] = static_cast<uint8_t>(a + div255(dst[3] * inv));
+    }
+
+    inline void blendPixel(uint8_t* dst, const uint8_t* src, uint32_t alpha)
+    {
+        const uint32_t inv = 255 - div255(src[3] * alpha);
+        for (int c = 0; c < 4; c++)
+        {
+            dst[c] = static_cast<uint8_t>(div255(src[c] * alpha) + div255(dst[c] * inv));
+        }
+    }
+
+#if BITMAPKERNELS_SSE2
+    inline __m128i div255(__m128i x)
+    {
+        x = _mm_add_epi16(x, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+
+    // 2 pixels widened to 16 bits, blended with their per pixel source
+    // alpha `a` and premultiplied source `s`
+    inline __m128i over(__m128i d, __m128i s, __m128i a)
+    {
+        const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+        return _mm_add_epi16(s, div255(_mm_mullo_epi16(d, inv)));
+    }
+#elif BITMAPKERNELS_NEON
+    inline uint16x8_t div255(uint16x8_t x)
+    {
+        x = vaddq_u16(x, vdupq_n_u16(128));
+        return vshrq_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+    }
+
+    // 2 pixels, premultiplied source `s` with per channel source alpha `a`
+    inline uint8x8_t over(uint8x8_t d, uint8x8_t s, uint8x8_t a)
+    {
+        return vadd_u8(s, vmovn_u16(div255(vmull_u8(d, vmvn_u8(a)))));
+    }
+#endif
+}
+
+namespace BitmapKernels {
+
+    void downscaleBGRA(const uint8_t* src, int srcWidth, int srcHeight, uint8_t* dst, int dstWidth, int dstHeight)
+    {
+        assert(dstWidth > 0 && dstHeight > 0 && dstWidth <= srcWidth && dstHeight <= srcHeight);
+        Taps columns, rows;
+        buildTaps(srcWidth, dstWidth, columns);
+        buildTaps(srcHeight, dstHeight, rows);
+
+        const size_t rowFloats = static_cast<size_t>(dstWidth) * 4;
+        std::vector<float> scaled(rowFloats * srcHeight);
+        std::vector<float> acc(rowFloats);
+        scaleRows(src, srcWidth, srcHeight, columns, dstWidth, scaled.data());
+
+        for (int y = 0; y < dstHeight; y++)
+        {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            const float* w = rows.weights.data() + rows.offset[y];
+            for (int k = 0; k < rows.count[y]; k++)
+            {
+                accumulate(acc.data(), scaled.data() + (rows.first[y] + k) * rowFloats, rowFloats, w[k]);
+            }
+            storeBytes(dst + y * rowFloats, acc.data(), rowFloats);
+        }
+    }
+
+    void downscaleBGRAScalar(const uint8_t* src, int srcWidth, int srcHeight, uint8_t* dst, int dstWidth, int dstHeight)
+    {
+        assert(dstWidth > 0 && dstHeight > 0 && dstWidth <= srcWidth && dstHeight <= srcHeight);
+        Taps columns, rows;
+        buildTaps(srcWidth, dstWidth, columns);
+        buildTaps(srcHeight, dstHeight, rows);
+
+        const size_t rowFloats = static_cast<size_t>(dstWidth) * 4;
+        std::vector<float> scaled(rowFloats * srcHeight, 0.0f);
+        for (int y = 0; y < srcHeight; y++)
+        {
+            for (int x = 0; x < dstWidth; x++)
+            {
+                for (int k = 0; k < columns.count[x]; k++)
+                {
+                    const uint8_t* p = src + (y * srcWidth + columns.first[x] + k) * 4;
+                    const float w = columns.weights[columns.offset[x] + k];
+                    for (int c = 0; c < 4; c++)
+                    {
+                        scaled[y * rowFloats + x * 4 + c] += p[c] * w;
+                    }
+                }
+            }
+        }
+
+        for (int y = 0; y < dstHeight; y++)
+        {
+            for (size_t i = 0; i < rowFloats; i++)
+            {
+                float v = 0;
+                for (int k = 0; k < rows.count[y]; k++)
+                {
+                    v += scaled[(rows.first[y] + k) * rowFloats + i] * rows.weights[rows.offset[y] + k];
+                }
+                dst[y * rowFloats + i] = toByte(v);
+            }
+        }
+    }
+
+    void blendMaskBGRA(uint8_t* dst, const uint8_t* mask, int count, const uint8_t bgra[4])
+    {
+        uint32_t solid;
+        memcpy(&solid, bgra, 4);
+        const bool opaque = bgra[3] == 255;
+        int i = 0;
+#if BITMAPKERNELS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alpha = _mm_set1_epi16(bgra[3]);
+        const __m128i color = _mm_setr_epi16(bgra[0], bgra[1], bgra[2], 255, bgra[0], bgra[1], bgra[2], 255);
+        for (; i + 4 <= count; i += 4)
+        {
+            uint32_t m;
+            memcpy(&m, mask + i, 4);
+            if (m == 0) continue;
+            uint8_t* p = dst + i * 4;
+            if (m == 0xFFFFFFFFu && opaque)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_set1_epi32(static_cast<int>(solid)));
+                continue;
+            }
+            // per pixel source alpha, repeated for the 4 channels
+            __m128i a = div255(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(m)), zero), alpha));
+            a = _mm_unpacklo_epi16(a, a);
+            const __m128i aLo = _mm_unpacklo_epi32(a, a);
+            const __m128i aHi = _mm_unpackhi_epi32(a, a);
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i lo = over(_mm_unpacklo_epi8(d, zero), div255(_mm_mullo_epi16(color, aLo)), aLo);
+            const __m128i hi = over(_mm_unpackhi_epi8(d, zero), div255(_mm_mullo_epi16(color, aHi)), aHi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(lo, hi));
+        }
+#elif BITMAPKERNELS_NEON
+        const uint8x8_t alpha = vdup_n_u8(bgra[3]);
+        const uint8_t colorBytes[8] = { bgra[0], bgra[1], bgra[2], 255, bgra[0], bgra[1], bgra[2], 255 };
+        const uint8x8_t color = vld1_u8(colorBytes);
+        const uint8_t loIndex[8] = { 0, 0, 0, 0, 1, 1, 1, 1 };
+        const uint8_t hiIndex[8] = { 2, 2, 2, 2, 3, 3, 3, 3 };
+        const uint8x8_t lo = vld1_u8(loIndex);
+        const uint8x8_t hi = vld1_u8(hiIndex);
+        for (; i + 4 <= count; i += 4)
+        {
+            uint32_t m;
+            memcpy(&m, mask + i, 4);
+            if (m == 0) continue;
+            uint8_t* p = dst + i * 4;
+            if (m == 0xFFFFFFFFu && opaque)
+            {
+                vst1q_u32(reinterpret_cast<uint32_t*>(p), vdupq_n_u32(solid));
+                continue;
+            }
+            const uint8x8_t a = vmovn_u16(div255(vmull_u8(vcreate_u8(m), alpha)));
+            const uint8x8_t aLo = vtbl1_u8(a, lo);
+            const uint8x8_t aHi = vtbl1_u8(a, hi);
+            const uint8x16_t d = vld1q_u8(p);
+            const uint8x8_t rLo = over(vget_low_u8(d), vmovn_u16(div255(vmull_u8(color, aLo))), aLo);
+            const uint8x8_t rHi = over(vget_high_u8(d), vmovn_u16(div255(vmull_u8(color, aHi))), aHi);
+            vst1q_u8(p, vcombine_u8(rLo, rHi));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            if (mask[i] == 0) continue;
+            if (mask[i] == 255 && opaque)
+            {
+                memcpy(dst + i * 4, &solid, 4);
+                continue;
+            }
+            blendMaskPixel(dst + i * 4, mask[i], bgra);
+        }
+    }
+
+    void blendMaskBGRAScalar(uint8_t* dst, const uint8_t* mask, int count, const uint8_t bgra[4])
+    {
+        for (int i = 0; i < count; i++)
+        {
+            blendMaskPixel(dst + i * 4, mask[i], bgra);
+        }
+    }
+
+    void blendBGRA(uint8_t* dst, const uint8_t* src, int count, uint8_t alpha)
+    {
+        int i = 0;
+#if BITMAPKERNELS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i fade = _mm_set1_epi16(alpha);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(s, zero)) == 0xFFFF) continue;
+            uint8_t* p = dst + i * 4;
+            __m128i sLo = _mm_unpacklo_epi8(s, zero);
+            __m128i sHi = _mm_unpackhi_epi8(s, zero);
+            if (alpha != 255)
+            {
+                sLo = div255(_mm_mullo_epi16(sLo, fade));
+                sHi = div255(_mm_mullo_epi16(sHi, fade));
+            }
+            const __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            const __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i lo = over(_mm_unpacklo_epi8(d, zero), sLo, aLo);
+            const __m128i hi = over(_mm_unpackhi_epi8(d, zero), sHi, aHi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(lo, hi));
+        }
+#elif BITMAPKERNELS_NEON
+        const uint8x8_t fade = vdup_n_u8(alpha);
+        const uint8_t alphaIndex[8] = { 3, 3, 3, 3, 7, 7, 7, 7 };
+        const uint8x8_t index = vld1_u8(alphaIndex);
+        for (; i + 4 <= count; i += 4)
+        {
+            uint8x16_t s = vld1q_u8(src + i * 4);
+            if (vmaxvq_u8(s) == 0) continue;
+            uint8_t* p = dst + i * 4;
+            uint8x8_t sLo = vget_low_u8(s);
+            uint8x8_t sHi = vget_high_u8(s);
+            if (alpha != 255)
+            {
+                sLo = vmovn_u16(div255(vmull_u8(sLo, fade)));
+                sHi = vmovn_u16(div255(vmull_u8(sHi, fade)));
+            }
+            const uint8x16_t d = vld1q_u8(p);
+            const uint8x8_t rLo = over(vget_low_u8(d), sLo, vtbl1_u8(sLo, index));
+            const uint8x8_t rHi = over(vget_high_u8(d), sHi, vtbl1_u8(sHi, index));
+            vst1q_u8(p, vcombine_u8(rLo, rHi));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            blendPixel(dst + i * 4, src + i * 4, alpha);
+        }
+    }
+
+    void blendBGRAScalar(uint8_t* dst, const uint8_t* src, int count, uint8_t alpha)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            blendPixel(dst + i * 4, src + i * 4, alpha);
+        }
+    }
+
+    void packA4(const uint8_t* src, int count, uint8_t* dst)
+    {
+        int i = 0;
+#if BITMAPKERNELS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i fifteen = _mm_set1_epi16(15);
+        const __m128i bias = _mm_set1_epi16(135);
+        const __m128i lowByte = _mm_set1_epi16(0xFF);
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), fifteen), bias), 8);
+            const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), fifteen), bias), 8);
+            // each 16 bit lane holds a pair, left level | right level << 8
+            const __m128i pairs = _mm_packus_epi16(lo, hi);
+            const __m128i packed = _mm_and_si128(_mm_or_si128(pairs, _mm_srli_epi16(pairs, 4)), lowByte);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i / 2), _mm_packus_epi16(packed, packed));
+        }
+#elif BITMAPKERNELS_NEON
+        const uint8x8_t fifteen = vdup_n_u8(15);
+        const uint16x8_t bias = vdupq_n_u16(135);
+        for (; i + 16 <= count; i += 16)
+        {
+            const uint8x8x2_t pairs = vld2_u8(src + i);     // left pixels, right pixels
+            const uint8x8_t left = vshrn_n_u16(vmlal_u8(bias, pairs.val[0], fifteen), 8);
+            const uint8x8_t right = vshrn_n_u16(vmlal_u8(bias, pairs.val[1], fifteen), 8);
+            vst1_u8(dst + i / 2, vorr_u8(left, vshl_n_u8(right, 4)));
+        }
+#endif
+        packA4Scalar(src + i, count - i, dst + i / 2);
+    }
+
+    void packA4Scalar(const uint8_t* src, int count, uint8_t* dst)
+    {
+        int i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            dst[i / 2] = static_cast<uint8_t>(quantizeA4(src[i]) | (quantizeA4(src[i + 1]) << 4));
+        }
+        if (i < count)
+        {
+            dst[i / 2] = quantizeA4(src[i]);
+        }
+    }
+
+    void unpackA4(const uint8_t* src, int count, uint8_t* dst)
+    {
+        int i = 0;
+#if BITMAPKERNELS_SSE2
+        const __m128i low = _mm_set1_epi8(0x0F);
+        const __m128i seventeen = _mm_set1_epi16(17);
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i / 2));
+            const __m128i left = _mm_and_si128(v, low);
+            const __m128i right = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+            const __m128i levels = _mm_unpacklo_epi8(left, right);
+            const __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(levels, zero), seventeen);
+            const __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(levels, zero), seventeen);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+        }
+#elif BITMAPKERNELS_NEON
+        const uint8x8_t low = vdup_n_u8(0x0F);
+        const uint8x8_t seventeen = vdup_n_u8(17);
+        for (; i + 16 <= count; i += 16)
+        {
+            const uint8x8_t v = vld1_u8(src + i / 2);
+            uint8x8x2_t levels;
+            levels.val[0] = vmul_u8(vand_u8(v, low), seventeen);
+            levels.val[1] = vmul_u8(vshr_n_u8(v, 4), seventeen);
+            vst2_u8(dst + i, levels);
+        }
+#endif
+        unpackA4Scalar(src + i / 2, count - i, dst + i);
+    }
+
+    void unpackA4Scalar(const uint8_t* src, int count, uint8_t* dst)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const uint8_t level = (i & 1) ? src[i / 2] >> 4 : src[i / 2] & 0x0F;
+            dst[i] = static_cast<uint8_t>(level * 17);
+        }
+    }
+}
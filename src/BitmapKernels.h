@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+namespace BitmapKernels {
+
+    /**
+    * Scales a premultiplied BGRA8888 image of srcWidth x srcHeight down to
+    * dstWidth x dstHeight, every destination pixel is the average of the
+    * source area it covers (box filter). The destination must not be larger
+    * than the source in either direction. Vectorized with SSE2 or NEON when
+    * the target supports it.
+    */
+    void downscaleBGRA(const uint8_t* src, int srcWidth, int srcHeight, uint8_t* dst, int dstWidth, int dstHeight);
+
+    /**
+    * Reference implementation of downscaleBGRA() without SIMD.
+    */
+    void downscaleBGRAScalar(const uint8_t* src, int srcWidth, int srcHeight, uint8_t* dst, int dstWidth, int dstHeight);
+
+    /**
+    * Quantizes `count` A8 pixels to 4 bits, rounded to the nearest of the 16
+    * levels, and packs them 2 per byte into (count + 1) / 2 bytes of `dst`:
+    * the left pixel in the low nibble. Vectorized with SSE2 or NEON when the
+    * target supports it.
+    */
+    void packA4(const uint8_t* src, int count, uint8_t* dst);
+
+    /**
+    * Expands `count` pixels packed by packA4() back to A8, level * 17.
+    */
+    void unpackA4(const uint8_t* src, int count, uint8_t* dst);
+
+    /**
+    * Reference implementations of packA4() and unpackA4() without SIMD.
+    */
+    void packA4Scalar(const uint8_t* src, int count, uint8_t* dst);
+    void unpackA4Scalar(const uint8_t* src, int count, uint8_t* dst);
+
+    /**
+    * Composites `count` pixels of `bgra`, a straight alpha color, through the
+    * A8 coverage `mask` over the premultiplied BGRA8888 pixels at `dst`
+    * (source over). Fully covered and empty runs of pixels are stored or
+    * skipped without blending. Integer math, rounded like x * y / 255, and
+    * vectorized with SSE2 or NEON when the target supports it.
+    */
+    void blendMaskBGRA(uint8_t* dst, const uint8_t* mask, int count, const uint8_t bgra[4]);
+
+    /**
+    * Reference implementation of blendMaskBGRA() without SIMD.
+    */
+    void blendMaskBGRAScalar(uint8_t* dst, const uint8_t* mask, int count, const uint8_t bgra[4]);
+
+    /**
+    * Composites `count` premultiplied BGRA8888 pixels of `src`, faded by
+    * `alpha`, over the premultiplied pixels at `dst` (source over).
+    */
+    void blendBGRA(uint8_t* dst, const uint8_t* src, int count, uint8_t alpha);
+
+    /**
+    * Reference implementation of blendBGRA() without SIMD.
+    */
+    void blendBGRAScalar(uint8_t* dst, const uint8_t* src, int count, uint8_t alpha);
+}
@@ -1,16 +1,110 @@
 #include "FontAtlas.h"
 #include <cassert>
-#include "Utils.h"
+#include <cstring>
+#include "Profiler.h"
+#include "BitmapKernels.h"
+#include "Capture.h"
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+    bool isBlank(const uint8_t* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (data[i]) return false;
+        }
+        return true;
+    }
+
+    /**
+    * The smallest [left, right) x [top, bottom) holding all of the coverage
+    * of `bitmap`, false if it has none.
+    */
+    bool coverageBounds(GlyphBitmap& bitmap, int& left, int& top, int& right, int& bottom)
+    {
+        const int pixelBytes = PixelModeSize(bitmap.getPixelMode());
+        const int rowBytes = bitmap.getWidth() * pixelBytes;
+        const uint8_t* data = bitmap.getData().data();
+        top = 0;
+        bottom = bitmap.getHeight();
+        while (top < bottom && isBlank(data + top * rowBytes, rowBytes)) top++;
+        if (top == bottom)
+        {
+            return false;
+        }
+        while (isBlank(data + (bottom - 1) * rowBytes, rowBytes)) bottom--;
+
+        left = bitmap.getWidth();
+        right = 0;
+        for (int y = top; y < bottom; y++)
+        {
+            const uint8_t* row = data + y * rowBytes;
+            int x = 0;
+            while (x < left && isBlank(row + x * pixelBytes, pixelBytes)) x++;
+            left = x;
+            x = bitmap.getWidth();
+            while (x > right && isBlank(row + (x - 1) * pixelBytes, pixelBytes)) x--;
+            right = x;
+        }
+        return true;
+    }
+
+    std::shared_ptr<GlyphBitmap> cropBitmap(GlyphBitmap& bitmap, int left, int top, int right, int bottom)
+    {
+        const int pixelBytes = PixelModeSize(bitmap.getPixelMode());
+        const int rowBytes = (right - left) * pixelBytes;
+        std::vector<uint8_t> data(static_cast<size_t>(rowBytes) * (bottom - top));
+        for (int y = top; y < bottom; y++)
+        {
+            memcpy(data.data() + (y - top) * rowBytes, bitmap.getData().data() + (y * bitmap.getWidth() + left) * pixelBytes, rowBytes);
+        }
+        const Rect rect = bitmap.getRect();
+        auto ret = std::make_shared<GlyphBitmap>(std::move(data), right - left, bottom - top,
+            Rect(rect.getLeft() + left, rect.getBottom() + top, right - left, bottom - top), bitmap.getXAdvance(), bitmap.getPixelMode());
+        ret->setXAdvance64(bitmap.getXAdvance64());
+        return ret;
+    }
+
+    uint64_t hashBitmap(GlyphBitmap& bitmap)
+    {
+        // FNV-1a a word at a time, folded so that every bit reaches the low ones
+        const uint64_t prime = 1099511628211ULL;
+        uint64_t h = 14695981039346656037ULL;
+        h = (h ^ (static_cast<uint64_t>(bitmap.getWidth()) | static_cast<uint64_t>(bitmap.getHeight()) << 24
+            | static_cast<uint64_t>(bitmap.getPixelMode()) << 48)) * prime;
+        const uint8_t* data = bitmap.getData().data();
+        const size_t size = bitmap.getData().size();
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            h = (h ^ word) * prime;
+            h ^= h >> 32;
+        }
+        for (; i < size; i++)
+        {
+            h = (h ^ data[i]) * prime;
+        }
+        return h ^ (h >> 29);
+    }
+}
 
 FontAtlasFrame::FontAtlasFrame(FontAtlasFrame& o)
 {
     // move buffer instead of copy
     std::swap(_buffer, o._buffer);
+    std::swap(_deflated, o._deflated);
     _WIDTH = o._WIDTH;
     _HEIGHT = o._HEIGHT;
     _currentRowX = o._currentRowX;
     _currentRowY = o._currentRowY;
     _currRowHeight = o._currRowHeight;
+    _padding = o._padding;
     _pixelMode = o._pixelMode;
 }
 
@@ -22,35 +116,52 @@ void FontAtlasFrame::init(PixelMode pixelMode, int width, int height)
     _currentRowX = 0;
     _currentRowY = 0;
     _currRowHeight = 0;
-    _buffer.resize(PixelModeSize(pixelMode) * width * height);
+    // the LCD filter leaves colored fringes at the bitmap edges, a blank
+    // texel keeps the neighbours out of them when sampling bilinearly
+    _padding = pixelMode == PixelMode::RGB888 ? 1 : 0;
+    assert(pixelMode != PixelMode::A4 || width % 2 == 0);
+    _deflated.clear();
+    _buffer.resize(PixelModeRowBytes(pixelMode, width) * height);
     std::fill(_buffer.begin(), _buffer.end(), 0);
 }
 
 FontAtlasFrame::FrameResult FontAtlasFrame::append(int width, int height, std::vector<uint8_t> &data, Rect &out)
 {
-    assert(_buffer.size() > 0);
+    PROFILE_SCOPE("atlas.append");
+    assert(_buffer.size() > 0 && !isCompressed());
     assert(width <= _WIDTH && height <= _HEIGHT);
-    bool hasSpace = prepareRow(width, height);
+    // A4 glyphs start on a byte, the odd column left over stays blank
+    const int cellWidth = _pixelMode == PixelMode::A4 ? (width + 1) & ~1 : width;
+    bool hasSpace = prepareRow(cellWidth + _padding, height + _padding);
     if (!hasSpace) {
         return FrameResult::E_FULL;
     }
     
     //update sub-data
-    const int pixelSize = PixelModeSize(_pixelMode);
-    uint8_t* dst = _buffer.data();
-    uint8_t* src = data.data();
-    uint8_t* dstOrigin = pixelSize * (_currentRowY * _WIDTH + _currentRowX)  + dst;
-    const int BytesEachRow = pixelSize * width;
-    for (int i = 0; i < height; i++)
+    const int frameRowBytes = PixelModeRowBytes(_pixelMode, _WIDTH);
+    uint8_t* dstOrigin = _currentRowY * frameRowBytes + PixelModeRowBytes(_pixelMode, _currentRowX) + _buffer.data();
+    if (_pixelMode == PixelMode::A4)
+    {
+        // quantized from the A8 bitmap
+        for (int i = 0; i < height; i++)
+        {
+            BitmapKernels::packA4(data.data() + i * width, width, dstOrigin + i * frameRowBytes);
+        }
+    }
+    else
     {
-        memcpy(dstOrigin + i * _WIDTH * pixelSize, src + i * BytesEachRow, BytesEachRow);
+        const int BytesEachRow = PixelModeRowBytes(_pixelMode, width);
+        for (int i = 0; i < height; i++)
+        {
+            memcpy(dstOrigin + i * frameRowBytes, data.data() + i * BytesEachRow, BytesEachRow);
+        }
     }
 
     out.setOrigin(_currentRowX, _currentRowY);
     out.setSize(width, height);
 
     // move cursor
-    moveToNextCursor(width, height);
+    moveToNextCursor(cellWidth + _padding, height + _padding);
 
     return FrameResult::SUCCESS;
 
@@ -69,13 +180,122 @@ bool FontAtlasFrame::prepareRow(int width, int height)
     return false;
 }
 
+bool FontAtlasFrame::matches(const Rect& rect, const std::vector<uint8_t>& data) const
+{
+    assert(!isCompressed());
+    const int x = static_cast<int>(rect.getLeft());
+    const int y = static_cast<int>(rect.getBottom());
+    const int width = static_cast<int>(rect.getWidth());
+    const int height = static_cast<int>(rect.getHeight());
+    const int frameRowBytes = PixelModeRowBytes(_pixelMode, _WIDTH);
+    const int rowBytes = PixelModeRowBytes(_pixelMode, width);
+    const uint8_t* origin = _buffer.data() + y * frameRowBytes + PixelModeRowBytes(_pixelMode, x);
+    std::vector<uint8_t> packed(_pixelMode == PixelMode::A4 ? rowBytes : 0);
+    for (int i = 0; i < height; i++)
+    {
+        const uint8_t* row = data.data() + i * rowBytes;
+        if (_pixelMode == PixelMode::A4)
+        {
+            BitmapKernels::packA4(data.data() + i * width, width, packed.data());
+            row = packed.data();
+        }
+        if (memcmp(origin + i * frameRowBytes, row, rowBytes) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FontAtlasFrame::unpackA8(uint8_t* out) const
+{
+    assert(!isCompressed());
+    if (_pixelMode == PixelMode::A8)
+    {
+        memcpy(out, _buffer.data(), _buffer.size());
+        return true;
+    }
+    if (_pixelMode != PixelMode::A4)
+    {
+        return false;
+    }
+    const int rowBytes = PixelModeRowBytes(_pixelMode, _WIDTH);
+    for (int y = 0; y < _HEIGHT; y++)
+    {
+        BitmapKernels::unpackA4(_buffer.data() + y * rowBytes, _WIDTH, out + y * _WIDTH);
+    }
+    return true;
+}
+
+bool FontAtlasFrame::compress()
+{
+#ifdef USE_ZLIB
+    if (isCompressed() || _buffer.empty())
+    {
+        return false;
+    }
+    PROFILE_SCOPE("atlas.deflate");
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // coverage is mostly runs of zeros, the run-length strategy finds them
+    // at a fraction of the cost of the default matcher
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15, 8, Z_RLE) != Z_OK)
+    {
+        return false;
+    }
+    std::vector<uint8_t> out(deflateBound(&stream, static_cast<uLong>(_buffer.size())));
+    stream.next_in = _buffer.data();
+    stream.avail_in = static_cast<uInt>(_buffer.size());
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<uInt>(out.size());
+    const int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END)
+    {
+        return false;
+    }
+    out.shrink_to_fit();
+    _deflated.swap(out);
+    std::vector<uint8_t>().swap(_buffer);
+    return true;
+#else
+    return false;
+#endif
+}
 
+bool FontAtlasFrame::decompress()
+{
+#ifdef USE_ZLIB
+    if (!isCompressed())
+    {
+        return false;
+    }
+    PROFILE_SCOPE("atlas.inflate");
+    std::vector<uint8_t> out(getRawBytes());
+    uLongf size = static_cast<uLongf>(out.size());
+    if (uncompress(out.data(), &size, _deflated.data(), static_cast<uLong>(_deflated.size())) != Z_OK || size != out.size())
+    {
+        return false;
+    }
+    _buffer.swap(out);
+    std::vector<uint8_t>().swap(_deflated);
+    return true;
+#else
+    return false;
+#endif
+}
 
 #ifdef ENABLE_INSPECT
-void FontAtlasFrame::inspect(std::ostream& out) const
+bool FontAtlasFrame::capture(const std::string& path) const
 {
-    printf("FontAtlasFrame: (%d,%d)", _WIDTH, _HEIGHT);
-    utils::inspectData(out, _WIDTH, _HEIGHT, PixelModeSize(_pixelMode), _buffer);
+    if (_pixelMode == PixelMode::A4)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(_WIDTH) * _HEIGHT);
+        unpackA8(pixels.data());
+        return utils::capture::writeImage(path, _WIDTH, _HEIGHT, 1, pixels.data());
+    }
+    return utils::capture::writeImage(path, _WIDTH, _HEIGHT, PixelModeSize(_pixelMode), _buffer.data());
 }
 #endif
 
@@ -90,14 +310,90 @@ FontAtlas::~FontAtlas() {}
 
 bool FontAtlas::init() 
 {
-    int pixelSize = PixelModeSize(_pixelMode);
+    std::lock_guard<std::mutex> lock(_mutex);
     _textureFrame.init(_pixelMode, _width, _height);
-    _letterMap.clear();
+    _buffers.clear();
+    _frameUse.clear();
+    _frameUse.emplace_back(_layouts.load(std::memory_order_relaxed));
+    _textureBufferIndex = 0;
+    _colorFrames.clear();
+    _letters.clear();
+    _packed.clear();
+    _normalization = GlyphNormalizationStats();
+    _usedPixels = 0;
     return true;
 }
 
 bool FontAtlas::addLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap)
 {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return insertLetter(ch, bitmap);
+}
+
+bool FontAtlas::insertLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap)
+{
+    if (_letters.find(ch))
+    {
+        return true;
+    }
+
+    PackedGlyph packed;
+    if (!_normalize)
+    {
+        return packLetter(ch, bitmap, packed);
+    }
+
+    const size_t pixels = static_cast<size_t>(bitmap->getWidth()) * bitmap->getHeight();
+    int left, top, right, bottom;
+    if (!coverageBounds(*bitmap, left, top, right, bottom))
+    {
+        // blank glyphs like the space only need their advance
+        PROFILE_COUNT("atlas.empty", 1);
+        _normalization.emptyGlyphs++;
+        _normalization.savedPixels += pixels;
+        addLetterDef(ch, bitmap, Rect(), _textureBufferIndex, false);
+        return true;
+    }
+    if (right - left < bitmap->getWidth() || bottom - top < bitmap->getHeight())
+    {
+        bitmap = cropBitmap(*bitmap, left, top, right, bottom);
+        _normalization.trimmedGlyphs++;
+        _normalization.savedPixels += pixels - static_cast<size_t>(bitmap->getWidth()) * bitmap->getHeight();
+    }
+
+    // look-alikes of other scripts and subpixel offsets of straight glyphs
+    // often render to the same pixels, the hash is checked against the frame
+    const uint64_t hash = hashBitmap(*bitmap);
+    auto it = _packed.find(hash);
+    if (it != _packed.end())
+    {
+        const PackedGlyph& prev = it->second;
+        FontAtlasFrame* frame = prev.color ? &_colorFrames.at(prev.textureID) : residentFrame(prev.textureID);
+        if (frame && frame->matches(prev.rect, bitmap->getData()))
+        {
+            PROFILE_COUNT("atlas.shared", 1);
+            _normalization.sharedGlyphs++;
+            _normalization.savedPixels += static_cast<size_t>(bitmap->getWidth()) * bitmap->getHeight();
+            addLetterDef(ch, bitmap, prev.rect, prev.textureID, prev.color);
+            return true;
+        }
+    }
+    if (!packLetter(ch, bitmap, packed))
+    {
+        return false;
+    }
+    // on a collision the first glyph keeps the slot
+    _packed.emplace(hash, packed);
+    return true;
+}
+
+bool FontAtlas::packLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, PackedGlyph& packed)
+{
+    if (bitmap->getPixelMode() == PixelMode::BGRA8888 && _pixelMode != PixelMode::BGRA8888)
+    {
+        return addColorLetter(ch, bitmap, packed);
+    }
+
     Rect rect;
     FontAtlasFrame::FrameResult ret = _textureFrame.append(bitmap->getWidth(), bitmap->getHeight(), bitmap->getData(), rect);
 
@@ -108,12 +404,19 @@ bool FontAtlas::addLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap)
         return false;
     case FontAtlasFrame::FrameResult::E_FULL:
         // Allocate a new frame & add bitmap the frame
+        PROFILE_COUNT("atlas.frame_rollover", 1);
         _buffers.emplace_back(_textureFrame);
+        _frameUse.back().store(_layouts.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        _frameUse.emplace_back(_layouts.load(std::memory_order_relaxed));
         _textureBufferIndex += 1;
         _textureFrame.init(_pixelMode, _width, _height);
-        return addLetter(ch, bitmap);
+        return packLetter(ch, bitmap, packed);
     case FontAtlasFrame::FrameResult::SUCCESS:
-        addLetterDef(ch, bitmap, rect);
+        _usedPixels += bitmap->getWidth() * bitmap->getHeight();
+        addLetterDef(ch, bitmap, rect, _textureBufferIndex, false);
+        packed.rect = rect;
+        packed.textureID = _textureBufferIndex;
+        packed.color = false;
         return true;
     default:
         //TODO: LOG
@@ -122,40 +425,203 @@ bool FontAtlas::addLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap)
     return false;
 }
 
-void FontAtlas::addLetterDef(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, const Rect& rect)
+bool FontAtlas::addColorLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, PackedGlyph& packed)
+{
+    if (bitmap->getWidth() > _width || bitmap->getHeight() > _height)
+    {
+        return false;
+    }
+    if (_colorFrames.empty())
+    {
+        _colorFrames.emplace_back();
+        _colorFrames.back().init(PixelMode::BGRA8888, _width, _height);
+    }
+
+    Rect rect;
+    auto ret = _colorFrames.back().append(bitmap->getWidth(), bitmap->getHeight(), bitmap->getData(), rect);
+    if (ret == FontAtlasFrame::FrameResult::E_FULL)
+    {
+        PROFILE_COUNT("atlas.frame_rollover", 1);
+        _colorFrames.emplace_back();
+        _colorFrames.back().init(PixelMode::BGRA8888, _width, _height);
+        ret = _colorFrames.back().append(bitmap->getWidth(), bitmap->getHeight(), bitmap->getData(), rect);
+    }
+    if (ret != FontAtlasFrame::FrameResult::SUCCESS)
+    {
+        return false;
+    }
+    addLetterDef(ch, bitmap, rect, getColorFrameCount() - 1, true);
+    packed.rect = rect;
+    packed.textureID = getColorFrameCount() - 1;
+    packed.color = true;
+    return true;
+}
+
+void FontAtlas::addLetterDef(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, const Rect& rect, int textureID, bool color)
 {
-    assert(bitmap->getPixelMode() == _pixelMode);
+    assert(rect.getWidth() == 0 || bitmap->getPixelMode() == (color ? PixelMode::BGRA8888 : _pixelMode == PixelMode::A4 ? PixelMode::A8 : _pixelMode));
 
-    auto& def = _letterMap[ch];
+    FontLetterMap::Entry entry;
+    auto& def = entry.def;
     def.validate = true;
-    def.textureID = _textureBufferIndex;
+    def.color = color;
+    def.textureID = textureID;
     def.xAdvance = bitmap->getXAdvance();
+    def.xAdvance64 = bitmap->getXAdvance64();
     def.rect = bitmap->getRect();
     def.texX = 1.0f * rect.getOrigin().getX() / _textureFrame.getWidth();
     def.texY = 1.0f * rect.getOrigin().getY() / _textureFrame.getHeight();
     def.texWidth = 1.0f * rect.getWidth() / _textureFrame.getWidth();
     def.texHeight = 1.0f * rect.getHeight() / _textureFrame.getHeight();
+    if (rect.getWidth() == 0)
+    {
+        // nothing packed, only the metrics are used
+        def.rect.setSize(0, 0);
+    }
+    else if (!color)
+    {
+        entry.stamp = &_frameUse[textureID];
+    }
+    _letters.insert(ch, entry);
 }
 
 
-FontLetterDefinition* FontAtlas::getOrLoad(uint64_t ch, FontFreeType* font)
+const FontLetterDefinition* FontAtlas::find(uint64_t key) const
 {
-    auto it = _letterMap.find(ch);
-    if (it != _letterMap.end()) return &it->second;
+    if (auto* entry = _letters.find(key)) {
+        PROFILE_COUNT("atlas.hit", 1);
+        return use(*entry);
+    }
+    PROFILE_COUNT("atlas.miss", 1);
+    return nullptr;
+}
 
-    if (font) {
-        auto bitmap = font->getGlyphBitmap(ch);
-        if (bitmap) {
-            if (addLetter(ch, bitmap)) {
-                return getOrLoad(ch, nullptr);
-            }
-        }
+template<typename Rasterize>
+const FontLetterDefinition* FontAtlas::load(uint64_t key, FontFreeType* font, Rasterize rasterize)
+{
+    if (!font) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    // another thread may have added it while this one waited
+    if (auto* entry = _letters.find(key)) {
+        return use(*entry);
+    }
+    PROFILE_SCOPE("atlas.load");
+    auto bitmap = rasterize();
+    if (bitmap && insertLetter(key, bitmap)) {
+        return use(*_letters.find(key));
     }
     return nullptr;
 }
 
 
-FontAtlasFrame& FontAtlas::frameAt(int idx)
+const FontLetterDefinition* FontAtlas::getOrLoad(uint64_t ch, FontFreeType* font)
+{
+    if (auto* def = find(ch)) {
+        return def;
+    }
+    return load(ch, font, [&]() { return font->getGlyphBitmap(ch); });
+}
+
+
+const FontLetterDefinition* FontAtlas::getOrLoadGlyph(uint32_t glyphIndex, FontFreeType* font)
+{
+    // glyph indices are kept apart from the codepoint keys
+    const uint64_t key = (1ULL << 63) | glyphIndex;
+    if (auto* def = find(key)) {
+        return def;
+    }
+    return load(key, font, [&]() { return font->getGlyphBitmapByIndex(glyphIndex); });
+}
+
+
+const FontLetterDefinition* FontAtlas::getOrLoad(char32_t ch, size_t slot, FontFreeType* font)
+{
+    // the slot sits above the 21 bits of the codepoint, below the glyph index flag
+    const uint64_t key = (static_cast<uint64_t>(slot) << 32) | ch;
+    if (auto* def = find(key)) {
+        return def;
+    }
+    return load(key, font, [&]() { return font->getGlyphBitmap(ch); });
+}
+
+
+const FontLetterDefinition* FontAtlas::getOrLoadSubpixel(char32_t ch, int offsetX, FontFreeType* font)
+{
+    // offsets 0..63 are kept in bits 56..62, apart from the plain glyphs
+    const uint64_t key = (static_cast<uint64_t>((offsetX & 63) + 1) << 56) | ch;
+    if (auto* def = find(key)) {
+        return def;
+    }
+    return load(key, font, [&]() { return font->getGlyphBitmapSubpixel(ch, offsetX); });
+}
+
+float FontAtlas::getOccupancy() const
+{
+    return static_cast<float>(_usedPixels) / (static_cast<float>(_width) * _height * getFrameCount());
+}
+
+
+FontAtlasFrame* FontAtlas::frameAt(int idx)
+{
+    // endLayout() compresses frames under the same lock
+    std::lock_guard<std::mutex> lock(_mutex);
+    return residentFrame(idx);
+}
+
+FontAtlasFrame* FontAtlas::residentFrame(int idx)
+{
+    if (idx == _textureBufferIndex)
+    {
+        return &_textureFrame;
+    }
+    auto& frame = _buffers.at(idx);
+    _frameUse[idx].store(_layouts.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (frame.isCompressed() && !frame.decompress())
+    {
+        return nullptr;
+    }
+    return &frame;
+}
+
+void FontAtlas::endLayout()
 {
-    return idx == _textureBufferIndex ? _textureFrame : _buffers.at(idx);
+    const unsigned layouts = ++_layouts;
+    if (_coldFrameAge == 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < _buffers.size(); i++)
+    {
+        if (!_buffers[i].isCompressed() && layouts - _frameUse[i].load(std::memory_order_relaxed) > _coldFrameAge)
+        {
+            _buffers[i].compress();
+        }
+    }
+}
+
+int FontAtlas::getCompressedFrameCount() const
+{
+    int ret = 0;
+    for (auto& frame : _buffers)
+    {
+        if (frame.isCompressed()) ret++;
+    }
+    return ret;
+}
+
+size_t FontAtlas::getResidentBytes() const
+{
+    size_t ret = _textureFrame.getResidentBytes();
+    for (auto& frame : _buffers)
+    {
+        ret += frame.getResidentBytes();
+    }
+    for (auto& frame : _colorFrames)
+    {
+        ret += frame.getResidentBytes();
+    }
+    return ret;
 }
\ No newline at end of file
@@ -1,20 +1,14 @@
 #pragma once
 
 #include "FontFreetype.h"
+#include "FontLetterMap.h"
 
 #include <unordered_map>
 #include <algorithm>
-
-struct FontLetterDefinition
-{
-    float texX = 0, texY =0;
-    float texWidth = 0, texHeight = 0;
-    //int offsetX, offsetY;
-    Rect rect;
-    int textureID = -1;
-    int xAdvance = 0;
-    bool validate = false;
-};
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <mutex>
 
 class FontAtlasFrame
 {
@@ -28,15 +22,50 @@ public:
 
     FontAtlasFrame() = default;
     FontAtlasFrame(FontAtlasFrame&); //move 
+    FontAtlasFrame(FontAtlasFrame&& o) noexcept : FontAtlasFrame(o) {}
     void init(PixelMode mode, int width, int height);
+    /**
+    * Copies the `width` x `height` pixels of `data` to the next free spot,
+    * A4 frames take A8 pixels and quantize them.
+    */
     FrameResult append(int width, int height, std::vector<uint8_t> &, Rect &out);
 
 
     int getWidth() const { return _WIDTH; }
     int getHeight() const { return _HEIGHT; }
+    PixelMode getPixelMode() const { return _pixelMode; }
+    const uint8_t* getData() const { assert(!isCompressed()); return _buffer.data(); }
+
+    /**
+    * Whether the pixels at `rect` are the ones append() would store for
+    * `data`, quantized the same way in A4 frames.
+    */
+    bool matches(const Rect& rect, const std::vector<uint8_t>& data) const;
+
+    /**
+    * Writes the frame as width x height A8 pixels to `out`, expanding A4
+    * frames for uploading to textures of one byte per texel. Returns false
+    * for the other pixel modes.
+    */
+    bool unpackA8(uint8_t* out) const;
+
+    /**
+    * Deflates the pixels of a frame that is no longer appended to and frees
+    * them, getData() is not available until decompress(). Returns false if
+    * the frame is compressed already or zlib is not available (USE_ZLIB).
+    */
+    bool compress();
+    bool decompress();
+    bool isCompressed() const { return !_deflated.empty(); }
+
+    size_t getRawBytes() const { return static_cast<size_t>(PixelModeRowBytes(_pixelMode, _WIDTH)) * _HEIGHT; }
+    size_t getResidentBytes() const { return _buffer.capacity() + _deflated.capacity(); }
 
 #ifdef ENABLE_INSPECT
-    void inspect(std::ostream& out) const;
+    /**
+    * See utils::capture::writeImage().
+    */
+    bool capture(const std::string& path) const;
 #endif
 
 private:
@@ -64,16 +93,38 @@ private:
     }
 
     std::vector<uint8_t> _buffer;
+    std::vector<uint8_t> _deflated;     // zlib stream of _buffer while compressed
     //internal states
     int _WIDTH          = 0;
     int _HEIGHT         = 0;
     int _currentRowY    = 0;
     int _currentRowX    = 0;
     int _currRowHeight  = 0;
+    int _padding        = 0;    // blank texels right of and below each glyph
     PixelMode _pixelMode = PixelMode::A8;
  
 };
 
+/**
+* Atlas space saved by FontAtlas::addLetter() normalizing the bitmaps before
+* packing them.
+*/
+struct GlyphNormalizationStats
+{
+    size_t emptyGlyphs = 0;     // no coverage, only the metrics are kept
+    size_t sharedGlyphs = 0;    // same pixels as a packed glyph, share its rect
+    size_t trimmedGlyphs = 0;   // blank rows or columns cut off the edges
+    size_t savedPixels = 0;     // not packed because of the above
+};
+
+/**
+* Glyph lookups are lock free and may run on any number of threads, while
+* the glyphs missing from the atlas are rasterized and packed one at a time
+* under a lock. The fonts passed to the getOrLoad() calls of an atlas must
+* not be used elsewhere at the same time, and the frames must not be read
+* while glyphs are being added. A frame from frameAt() stays resident while
+* other threads end layouts, for as long as setColdFrameAge() allows.
+*/
 class FontAtlas {
 
 public:
@@ -83,21 +134,125 @@ public:
 
     bool init();
 
+    /**
+    * BGRA8888 bitmaps of color glyphs go to color pages of their own when the
+    * atlas has another pixel mode, the other bitmaps must match the mode. A4
+    * atlases take A8 bitmaps and quantize them.
+    *
+    * Unless normalization is turned off the blank borders of the bitmap are
+    * trimmed first, a bitmap without coverage is not packed at all and one
+    * with the same pixels as a packed glyph shares its rect. A key that is
+    * present keeps its definition.
+    */
     bool addLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap);
 
-    FontLetterDefinition* getOrLoad(uint64_t ch, FontFreeType* font);
+    void setNormalization(bool enabled) { _normalize = enabled; }
+    const GlyphNormalizationStats& getNormalizationStats() const { return _normalization; }
+
+    const FontLetterDefinition* getOrLoad(uint64_t ch, FontFreeType* font);
+
+    /**
+    * Same as getOrLoad, but keyed by the glyph index of `font`, as produced by
+    * the shaping stage.
+    */
+    const FontLetterDefinition* getOrLoadGlyph(uint32_t glyphIndex, FontFreeType* font);
+
+    /**
+    * Same as getOrLoad for the font in slot `slot` of a FontFallbackChain,
+    * slot 0 shares the keys of getOrLoad.
+    */
+    const FontLetterDefinition* getOrLoad(char32_t ch, size_t slot, FontFreeType* font);
+
+    /**
+    * Same as getOrLoad for `ch` rasterized `offsetX` / 64 of a pixel to the
+    * right, see FontFreeType::getGlyphBitmapSubpixel(). Every offset is a
+    * glyph of its own, rasterized when it is first asked for.
+    */
+    const FontLetterDefinition* getOrLoadSubpixel(char32_t ch, int offsetX, FontFreeType* font);
     
-    FontAtlasFrame& frameAt(int idx);
+    /**
+    * Decompresses the frame if it went cold, see setColdFrameAge(). Returns
+    * nullptr if its pixels cannot be restored.
+    *
+    * The frame is marked as used by the current layout, endLayout() on
+    * another thread leaves it resident until the cold frame age has passed
+    * again.
+    */
+    FontAtlasFrame* frameAt(int idx);
+    int getFrameCount() const { return _textureBufferIndex + 1; }
+    FontAtlasFrame& colorFrameAt(int idx) { return _colorFrames.at(idx); }
+    int getColorFrameCount() const { return static_cast<int>(_colorFrames.size()); }
+    size_t getLetterCount() const { return _letters.size(); }
+    /**
+    * Glyph pixels over the pixels of all frames.
+    */
+    float getOccupancy() const;
+
+    /**
+    * Compresses full frames none of whose glyphs were looked up during the
+    * last `layouts` layouts, 0 (the default) keeps every frame resident. A
+    * cold frame is restored by frameAt().
+    */
+    void setColdFrameAge(unsigned layouts) { _coldFrameAge = layouts; }
+
+    /**
+    * Counts a finished layout and compresses the frames that went cold,
+    * which frees their pixels. Called by Label, LabelBatch and StreamingLabel
+    * after laying out against the atlas, takes the lock of frameAt().
+    */
+    void endLayout();
+
+    int getCompressedFrameCount() const;
+    /**
+    * Bytes held by the pixels of all frames, compressed or not.
+    */
+    size_t getResidentBytes() const;
 private:
 
-    void addLetterDef(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, const Rect& rect);
+    const FontLetterDefinition* use(const FontLetterMap::Entry& entry) const
+    {
+        // lookups run on several threads, the check keeps the stamp's cache
+        // line shared once it is current
+        const unsigned layouts = _layouts.load(std::memory_order_relaxed);
+        if (entry.stamp && entry.stamp->load(std::memory_order_relaxed) != layouts)
+        {
+            entry.stamp->store(layouts, std::memory_order_relaxed);
+        }
+        return &entry.def;
+    }
+
+    const FontLetterDefinition* find(uint64_t key) const;
+    template<typename Rasterize>
+    const FontLetterDefinition* load(uint64_t key, FontFreeType* font, Rasterize rasterize);
+
+    struct PackedGlyph
+    {
+        Rect rect;          // texels in the frame
+        int textureID = -1;
+        bool color = false;
+    };
+
+    FontAtlasFrame* residentFrame(int idx);   // frameAt() with the lock held
+    bool insertLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap);
+    bool packLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, PackedGlyph& packed);
+    bool addColorLetter(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, PackedGlyph& packed);
+    void addLetterDef(uint64_t ch, std::shared_ptr<GlyphBitmap> bitmap, const Rect& rect, int textureID, bool color);
 
-    std::unordered_map<uint64_t, FontLetterDefinition> _letterMap;
+    FontLetterMap _letters;
+    std::mutex _mutex;      // held while adding glyphs and compressing frames
+    std::unordered_map<uint64_t, PackedGlyph> _packed;  // by hash of the pixels
+    GlyphNormalizationStats _normalization;
 
     FontAtlasFrame   _textureFrame;
     std::vector<FontAtlasFrame> _buffers;
+    std::deque<std::atomic<unsigned>> _frameUse;    // last layout that used each frame, the current one last
+    std::vector<FontAtlasFrame> _colorFrames;   // BGRA8888, created by the first color glyph
     int _textureBufferIndex =   0;
+    size_t _usedPixels      =   0;
     int _width              =   0;
     int _height             =   0;
     PixelMode _pixelMode    =   PixelMode::A8;
+    std::atomic<unsigned> _layouts{ 0 };
+    unsigned _coldFrameAge  =   0;
+    bool _normalize         =   true;
 };
\ No newline at end of file
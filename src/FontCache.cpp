@@ -0,0 +1,55 @@
+#include "FontCache.h"
+
+#include "ccUTF8.h"
+
+FontCache::FontCache(PixelMode mode, int atlasWidth, int atlasHeight)
+    : _pixelMode(mode), _atlasWidth(atlasWidth), _atlasHeight(atlasHeight)
+{
+}
+
+FontCacheEntry* FontCache::get(const std::string& font, float fontSize, float outline)
+{
+    return get(font, 0, fontSize, outline);
+}
+
+FontCacheEntry* FontCache::get(const std::string& font, int faceIndex, float fontSize, float outline)
+{
+    std::string key = StringUtils::format("%s|%d|%g|%g", font.c_str(), faceIndex, fontSize, outline);
+    auto it = _entries.find(key);
+    if (it != _entries.end()) return it->second.get();
+
+    std::unique_ptr<FontCacheEntry> entry(new FontCacheEntry());
+    auto collection = getCollection(font);
+    if (collection)
+    {
+        entry->font = collection->createFont(faceIndex, fontSize, outline);
+        if (!entry->font) return nullptr;
+    }
+    else
+    {
+        // not an sfnt file, let FreeType try
+        entry->font.reset(new FontFreeType(font, fontSize, outline));
+        if (faceIndex != 0 || !entry->font->loadFont())
+        {
+            return nullptr;
+        }
+    }
+    entry->font->setLCDRendering(_pixelMode == PixelMode::RGB888);
+    entry->atlas.reset(new FontAtlas(_pixelMode, _atlasWidth, _atlasHeight));
+    entry->atlas->init();
+    entry->lineHeight = entry->font->getFontAscender();
+
+    auto* ret = entry.get();
+    _entries.emplace(std::move(key), std::move(entry));
+    return ret;
+}
+
+std::shared_ptr<FontCollection> FontCache::getCollection(const std::string& font)
+{
+    auto it = _collections.find(font);
+    if (it != _collections.end()) return it->second;
+
+    auto collection = FontCollection::open(font);
+    _collections.emplace(font, collection);
+    return collection;
+}
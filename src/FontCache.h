@@ -0,0 +1,53 @@
+#pragma once
+
+#include "FontAtlas.h"
+#include "FontCollection.h"
+#include "FontFreetype.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+struct FontCacheEntry
+{
+    std::unique_ptr<FontFreeType> font;
+    std::unique_ptr<FontAtlas> atlas;
+    int lineHeight = 0;
+};
+
+/**
+* Owns one FontFreeType and its FontAtlas for every (font, face, size, outline),
+* so that labels sharing a style share the glyphs. All faces and sizes of a
+* font file share one FontCollection, faces are opened on first use.
+* With PixelMode::RGB888 the fonts render for LCD panels.
+*/
+class FontCache {
+public:
+    FontCache(PixelMode mode = PixelMode::A8, int atlasWidth = 512, int atlasHeight = 512);
+
+    /**
+    * Returns the entry for the style, loading the font on first use.
+    * Returns nullptr if the font can not be loaded.
+    */
+    FontCacheEntry* get(const std::string& font, float fontSize, float outline);
+
+    /**
+    * Same as above for face `faceIndex` of a font collection.
+    */
+    FontCacheEntry* get(const std::string& font, int faceIndex, float fontSize, float outline);
+
+    void clear()
+    {
+        _entries.clear();
+        _collections.clear();
+    }
+
+private:
+    std::shared_ptr<FontCollection> getCollection(const std::string& font);
+
+    std::unordered_map<std::string, std::unique_ptr<FontCacheEntry>> _entries;
+    std::unordered_map<std::string, std::shared_ptr<FontCollection>> _collections;
+    PixelMode _pixelMode    = PixelMode::A8;
+    int _atlasWidth         = 0;
+    int _atlasHeight        = 0;
+};
@@ -0,0 +1,259 @@
+#include "FontCollection.h"
+#include "FontFreetype.h"
+#include "ccUTF8.h"
+
+#include FT_FREETYPE_H
+
+namespace {
+
+    inline uint16_t readU16(const uint8_t* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+    inline int16_t readS16(const uint8_t* p) { return static_cast<int16_t>(readU16(p)); }
+    inline uint32_t readU32(const uint8_t* p) { return static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+
+    inline uint32_t tag(const char* t)
+    {
+        return static_cast<uint32_t>(t[0]) << 24 | t[1] << 16 | t[2] << 8 | t[3];
+    }
+
+    struct Table {
+        const uint8_t* data = nullptr;
+        uint32_t length = 0;
+    };
+
+    class SfntFace {
+    public:
+        bool init(const uint8_t* file, size_t size, uint32_t offset)
+        {
+            _file = file;
+            _size = size;
+            if (offset > size || size - offset < 12) return false;
+            _directory = file + offset;
+            _version = readU32(_directory);
+            _numTables = readU16(_directory + 4);
+            return static_cast<uint64_t>(offset) + 12 + 16ULL * _numTables <= size;
+        }
+
+        Table find(const char* name) const
+        {
+            const uint32_t wanted = tag(name);
+            for (int i = 0; i < _numTables; i++)
+            {
+                const uint8_t* record = _directory + 12 + 16 * i;
+                if (readU32(record) != wanted) continue;
+                const uint32_t offset = readU32(record + 8);
+                const uint32_t length = readU32(record + 12);
+                if (offset > _size || _size - offset < length) return Table();
+                Table t;
+                t.data = _file + offset;
+                t.length = length;
+                return t;
+            }
+            return Table();
+        }
+
+        bool isTrueType() const { return _version == 0x00010000 || _version == tag("true"); }
+
+    private:
+        const uint8_t* _file = nullptr;
+        size_t _size = 0;
+        const uint8_t* _directory = nullptr;
+        uint32_t _version = 0;
+        int _numTables = 0;
+    };
+
+    // Windows Unicode names are preferred, Macintosh Roman names are read as Latin-1
+    bool readName(const Table& name, uint16_t nameID, std::string& out)
+    {
+        if (name.length < 6) return false;
+        const uint16_t count = readU16(name.data + 2);
+        const uint16_t storage = readU16(name.data + 4);
+        if (6 + 12u * count > name.length) return false;
+
+        int best = -1;
+        int bestScore = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const uint8_t* record = name.data + 6 + 12 * i;
+            if (readU16(record + 6) != nameID) continue;
+            const uint16_t platform = readU16(record);
+            const uint16_t encoding = readU16(record + 2);
+            const uint16_t language = readU16(record + 4);
+            int score = 0;
+            if (platform == 3 && (encoding == 1 || encoding == 10)) score = language == 0x409 ? 4 : 3;
+            else if (platform == 0) score = 2;
+            else if (platform == 1 && encoding == 0) score = 1;
+            if (score > bestScore)
+            {
+                best = i;
+                bestScore = score;
+            }
+        }
+        if (best < 0) return false;
+
+        const uint8_t* record = name.data + 6 + 12 * best;
+        const uint16_t length = readU16(record + 8);
+        const uint32_t offset = storage + readU16(record + 10);
+        if (offset > name.length || name.length - offset < length) return false;
+        const uint8_t* p = name.data + offset;
+
+        out.clear();
+        if (bestScore == 1)
+        {
+            std::u32string latin1(p, p + length);
+            return StringUtils::UTF32ToUTF8(latin1, out);
+        }
+        std::u16string utf16(length / 2, 0);
+        for (size_t i = 0; i < utf16.length(); i++)
+        {
+            utf16[i] = readU16(p + 2 * i);
+        }
+        return StringUtils::UTF16ToUTF8(utf16, out);
+    }
+
+    bool parseFace(const SfntFace& face, FontFaceInfo& info)
+    {
+        Table head = face.find("head");
+        Table hhea = face.find("hhea");
+        if (head.length < 54 || hhea.length < 36) return false;
+
+        info.trueType = face.isTrueType();
+        info.headFlags = readU16(head.data + 16);
+        info.unitsPerEm = readU16(head.data + 18);
+        info.ascender = readS16(hhea.data + 4);
+        info.descender = readS16(hhea.data + 6);
+        info.lineGap = readS16(hhea.data + 8);
+
+        // the fallback of FreeType when hhea has no vertical metrics
+        Table os2 = face.find("OS/2");
+        if (info.ascender == 0 && info.descender == 0 && os2.length >= 78)
+        {
+            const int typoAscender = readS16(os2.data + 68);
+            const int typoDescender = readS16(os2.data + 70);
+            if (typoAscender || typoDescender)
+            {
+                info.ascender = typoAscender;
+                info.descender = typoDescender;
+                info.lineGap = readS16(os2.data + 72);
+            }
+            else
+            {
+                info.ascender = readU16(os2.data + 74);
+                info.descender = -static_cast<int>(readU16(os2.data + 76));
+            }
+        }
+
+        // the bitmap strikes FT_Match_Size picks from, in the order FreeType looks for them
+        for (const char* name : { "CBLC", "EBLC", "bloc" })
+        {
+            Table loc = face.find(name);
+            if (loc.length < 8) continue;
+            const uint32_t count = readU32(loc.data + 4);
+            for (uint32_t i = 0; i < count && 8 + 48 * (i + 1) <= loc.length; i++)
+            {
+                const uint8_t* size = loc.data + 8 + 48 * i;
+                info.strikes.emplace_back(size[44], size[45]);
+            }
+            break;
+        }
+
+        // typographic names first, as FreeType does
+        Table name = face.find("name");
+        if (!readName(name, 16, info.family)) readName(name, 1, info.family);
+        if (!readName(name, 17, info.style)) readName(name, 2, info.style);
+        return info.unitsPerEm > 0;
+    }
+}
+
+int FontFaceInfo::getAscender(float fontSize) const
+{
+    // mirrors FT_Set_Char_Size at 72 dpi followed by FT_Request_Metrics, the
+    // public scale is not rounded to whole pixels
+    const FT_Long height = static_cast<FT_Long>(64.0f * fontSize);
+    const FT_Long ppem = (height + 32) >> 6;
+    FT_Fixed yScale = FT_DivFix(height, unitsPerEm);
+
+    // unless the size rounds to a bitmap strike: the TrueType driver selects it
+    // and FT_Select_Metrics scales the outlines to its whole ppem
+    for (auto& strike : strikes)
+    {
+        if (strike.first == ppem && strike.second == ppem)
+        {
+            yScale = FT_DivFix(ppem << 6, unitsPerEm);
+            break;
+        }
+    }
+
+#if FREETYPE_MAJOR == 2 && FREETYPE_MINOR < 8
+    // older versions reported the hinted metrics of tt_size_reset, rounded
+    // to whole pixels when head.flags bit 3 asks for integer scaling
+    if (trueType && (headFlags & 8))
+    {
+        yScale = FT_DivFix(ppem << 6, unitsPerEm);
+        return static_cast<int>(((FT_MulFix(ascender, yScale) + 32) & -64) >> 6);
+    }
+#endif
+    return static_cast<int>(((FT_MulFix(ascender, yScale) + 63) & -64) >> 6);
+}
+
+std::shared_ptr<FontCollection> FontCollection::open(const std::string& path)
+{
+    auto file = utils::MappedFile::open(path);
+    return file ? open(path, std::move(file)) : nullptr;
+}
+
+std::shared_ptr<FontCollection> FontCollection::open(const std::string& name, std::shared_ptr<utils::MappedFile> file)
+{
+    const uint8_t* data = file->data();
+    const size_t size = file->size();
+    if (size < 12) return nullptr;
+
+    std::vector<uint32_t> offsets;
+    if (readU32(data) == tag("ttcf"))
+    {
+        const uint32_t count = readU32(data + 8);
+        if (12 + 4ULL * count > size) return nullptr;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            offsets.push_back(readU32(data + 12 + 4 * i));
+        }
+    }
+    else
+    {
+        offsets.push_back(0);
+    }
+
+    std::shared_ptr<FontCollection> collection(new FontCollection());
+    for (auto offset : offsets)
+    {
+        SfntFace face;
+        FontFaceInfo info;
+        if (!face.init(data, size, offset) || !parseFace(face, info))
+        {
+            return nullptr;
+        }
+        collection->_faces.push_back(std::move(info));
+    }
+    collection->_name = name;
+    collection->_file = std::move(file);
+    return collection;
+}
+
+int FontCollection::findFace(const std::string& family, const std::string& style) const
+{
+    for (size_t i = 0; i < _faces.size(); i++)
+    {
+        if (_faces[i].family == family && (style.empty() || _faces[i].style == style))
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+std::unique_ptr<FontFreeType> FontCollection::createFont(size_t faceIndex, float fontSize, float outline)
+{
+    if (faceIndex >= _faces.size()) return nullptr;
+    std::unique_ptr<FontFreeType> font(new FontFreeType(_name, fontSize, outline));
+    font->loadFace(shared_from_this(), static_cast<int>(faceIndex));
+    return font;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class FontFreeType;
+
+/**
+* Names and metrics of one face, read from the sfnt tables without FreeType.
+*/
+struct FontFaceInfo
+{
+    std::string family;
+    std::string style;
+    bool trueType = false;      // glyf outlines, CFF otherwise
+    int unitsPerEm = 0;
+    int ascender = 0;           // font units, as FreeType reports them
+    int descender = 0;
+    int lineGap = 0;
+    int headFlags = 0;
+    std::vector<std::pair<int, int>> strikes;   // x and y ppem of the embedded bitmaps
+
+    /**
+    * The ascender in pixels FreeType computes for this size, see FontFreeType::getFontAscender().
+    */
+    int getAscender(float fontSize) const;
+};
+
+/**
+* A font file, or a TrueType collection (.ttc) holding several faces.
+*
+* The file is mapped once and shared by the FontFreeType of all its faces and
+* sizes. Opening it only reads the name and metrics of every face, the FT_Face
+* of a font created by createFont() is opened on its first glyph request.
+*/
+class FontCollection : public std::enable_shared_from_this<FontCollection> {
+public:
+    /**
+    * Returns nullptr if the file can not be read or is not an sfnt font.
+    */
+    static std::shared_ptr<FontCollection> open(const std::string& path);
+    static std::shared_ptr<FontCollection> open(const std::string& name, std::shared_ptr<utils::MappedFile> file);
+
+    size_t getFaceCount() const { return _faces.size(); }
+    const FontFaceInfo& getFaceInfo(size_t faceIndex) const { return _faces[faceIndex]; }
+
+    /**
+    * Returns the index of the first face of `family`, with `style` unless it
+    * is empty, or -1.
+    */
+    int findFace(const std::string& family, const std::string& style = "") const;
+
+    /**
+    * Returns nullptr if faceIndex is out of range.
+    */
+    std::unique_ptr<FontFreeType> createFont(size_t faceIndex, float fontSize, float outline);
+
+    const std::string& getName() const { return _name; }
+    const std::shared_ptr<utils::MappedFile>& getFile() const { return _file; }
+
+private:
+    FontCollection() = default;
+
+    std::string _name;
+    std::shared_ptr<utils::MappedFile> _file;
+    std::vector<FontFaceInfo> _faces;
+};
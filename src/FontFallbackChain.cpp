@@ -0,0 +1,85 @@
+#include "FontFallbackChain.h"
+#include "FontCollection.h"
+
+FontFallbackChain::FontFallbackChain(FontFreeType* primary)
+{
+    if (primary)
+    {
+        addFont(primary);
+    }
+}
+
+FontFallbackChain::~FontFallbackChain() {}
+
+bool FontFallbackChain::addFont(FontFreeType* font)
+{
+    if (!font || _fonts.size() >= MAX_FONTS) return false;
+    _fonts.push_back(font);
+    // characters resolved to the first font may be found in the new one
+    clearCache();
+    return true;
+}
+
+bool FontFallbackChain::addFont(const std::string& font, float fontSize, float outline)
+{
+    auto collection = FontCollection::open(font);
+    std::unique_ptr<FontFreeType> ttf;
+    if (collection)
+    {
+        ttf = collection->createFont(0, fontSize, outline);
+    }
+    else
+    {
+        ttf.reset(new FontFreeType(font, fontSize, outline));
+        if (!ttf->loadFont()) return false;
+    }
+    if (!addFont(ttf.get())) return false;
+    _ownedFonts.push_back(std::move(ttf));
+    return true;
+}
+
+size_t FontFallbackChain::resolveSlow(char32_t ch)
+{
+    size_t slot = 0;
+    for (size_t i = 0; i < _fonts.size(); i++)
+    {
+        if (_fonts[i]->getGlyphIndex(ch))
+        {
+            slot = i;
+            break;
+        }
+    }
+
+    if (ch > 0x10FFFF) return slot;
+
+    const size_t page = ch >> PAGE_BITS;
+    if (page >= _pages.size())
+    {
+        _pages.resize(page + 1);
+    }
+    if (!_pages[page])
+    {
+        _pages[page].reset(new uint8_t[PAGE_SIZE]());
+        _pageCount++;
+    }
+    _pages[page][ch & PAGE_MASK] = static_cast<uint8_t>(slot + 1);
+    return slot;
+}
+
+const FontLetterDefinition* FontFallbackChain::getOrLoad(char32_t ch, FontAtlas* atlas)
+{
+    if (_fonts.empty()) return nullptr;
+    const size_t slot = resolve(ch);
+    return atlas->getOrLoad(ch, slot, _fonts[slot]);
+}
+
+void FontFallbackChain::clearCache()
+{
+    _pages.clear();
+    _pageCount = 0;
+}
+
+size_t FontFallbackChain::getCacheMemoryUsage() const
+{
+    return _pages.capacity() * sizeof(_pages[0]) + _pageCount * PAGE_SIZE;
+}
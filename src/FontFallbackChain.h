@@ -0,0 +1,86 @@
+#pragma once
+
+#include "FontAtlas.h"
+#include "FontFreetype.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+* An ordered list of fonts of one size, characters missing from the first
+* font are taken from the next font which has them.
+*
+* The font resolving a character is looked up once and kept in a page table
+* of one byte per character, so laying out the same scripts again does not
+* touch the charmaps. Glyphs of fallback fonts are stored in the atlas under
+* (font slot, character), glyphs of the first font keep the keys of
+* FontAtlas::getOrLoad(), so an atlas may be shared with code which does not
+* know the chain.
+*/
+class FontFallbackChain {
+public:
+    static const size_t MAX_FONTS = 254;
+    static const int PAGE_BITS = 8;
+
+    explicit FontFallbackChain(FontFreeType* primary = nullptr);
+    ~FontFallbackChain();
+
+    /**
+    * Appends a font owned by the caller. Returns false if the chain is full.
+    */
+    bool addFont(FontFreeType* font);
+
+    /**
+    * Appends a font file owned by the chain, its face is only opened when a
+    * character is not found in the fonts in front of it.
+    * Returns false if the file is not a font or the chain is full.
+    */
+    bool addFont(const std::string& font, float fontSize, float outline);
+
+    size_t getFontCount() const { return _fonts.size(); }
+    FontFreeType* getFont(size_t slot) const { return _fonts[slot]; }
+
+    /**
+    * Returns the slot of the first font with a glyph for `ch`, 0 if no font
+    * has one, so that the first font draws its missing glyph box.
+    */
+    size_t resolve(char32_t ch)
+    {
+        const size_t page = ch >> PAGE_BITS;
+        if (page < _pages.size() && _pages[page])
+        {
+            const uint8_t slot = _pages[page][ch & PAGE_MASK];
+            if (slot) return slot - 1;
+        }
+        return resolveSlow(ch);
+    }
+
+    /**
+    * Returns the glyph of `ch` from the font resolving it, rasterized into
+    * `atlas` on first use.
+    */
+    const FontLetterDefinition* getOrLoad(char32_t ch, FontAtlas* atlas);
+
+    /**
+    * Forgets the resolved characters, e.g. after changing the fonts.
+    */
+    void clearCache();
+
+    /**
+    * Bytes held by the resolution cache.
+    */
+    size_t getCacheMemoryUsage() const;
+
+private:
+    static const size_t PAGE_SIZE = 1 << PAGE_BITS;
+    static const char32_t PAGE_MASK = PAGE_SIZE - 1;
+
+    size_t resolveSlow(char32_t ch);
+
+    std::vector<FontFreeType*> _fonts;
+    std::vector<std::unique_ptr<FontFreeType>> _ownedFonts;
+    // slot + 1 of every resolved character, 0 if not resolved yet
+    std::vector<std::unique_ptr<uint8_t[]>> _pages;
+    size_t _pageCount = 0;
+};
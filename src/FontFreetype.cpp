@@ -1,13 +1,25 @@
 #include "FontFreetype.h"
+#include "BitmapKernels.h"
+#include "FontCollection.h"
+#include "Profiler.h"
 #include "Utils.h"
 
+#include FT_ADVANCES_H
+#include FT_LCD_FILTER_H
+#include FT_OUTLINE_H
+
 #include <cassert>
+#include <cmath>
+#include <mutex>
 
 class FontFreeTypeLibrary {
 public:
     FontFreeTypeLibrary() {
         memset(&_library, 0, sizeof(FT_Library));
         FT_Init_FreeType(&_library);
+        // only used by LCD rendering, builds without ClearType filtering
+        // render LCD glyphs unfiltered and return an error here
+        FT_Library_SetLcdFilter(_library, FT_LCD_FILTER_DEFAULT);
     }
     ~FontFreeTypeLibrary()
     {
@@ -16,12 +28,20 @@ public:
 
     FT_Library * get() { return &_library; }
 
+    /**
+    * Faces of one library may be used from different threads, but creating
+    * and destroying them must be serialized.
+    */
+    std::mutex& faceMutex() { return _faceMutex; }
+
 private:
     FT_Library _library;
+    std::mutex _faceMutex;
 };
 
 namespace {
     std::weak_ptr<FontFreeTypeLibrary> _sFTLibrary;
+    std::mutex _sFTLibraryMutex;
 
     PixelMode FTtoPixelModel(FT_Pixel_Mode mode)
     {
@@ -39,15 +59,68 @@ namespace {
         }
     }
 
+    // LCD bitmaps hold 3 subpixels per pixel in `width`
+    int bitmapPixelWidth(const FT_Bitmap& bitmap)
+    {
+        return bitmap.pixel_mode == FT_PIXEL_MODE_LCD ? bitmap.width / 3 : bitmap.width;
+    }
+
+    // drops the row padding of `pitch`, rows of LCD bitmaps are padded to 4 bytes
+    std::vector<uint8_t> copyBitmapRows(const FT_Bitmap& bitmap, int rowBytes)
+    {
+        std::vector<uint8_t> data(rowBytes * bitmap.rows);
+        if (bitmap.pitch == rowBytes)
+        {
+            if (!data.empty()) memcpy(data.data(), bitmap.buffer, data.size());
+            return data;
+        }
+        // a negative pitch starts with the bottom row
+        const uint8_t* src = bitmap.pitch < 0 ? bitmap.buffer - bitmap.pitch * (static_cast<int>(bitmap.rows) - 1) : bitmap.buffer;
+        for (unsigned y = 0; y < bitmap.rows; y++)
+        {
+            memcpy(data.data() + y * rowBytes, src + y * bitmap.pitch, rowBytes);
+        }
+        return data;
+    }
+
+    // placed by the hinted metrics, LCD bitmaps as rendered
+    std::shared_ptr<GlyphBitmap> createGlyphBitmap(const FT_Bitmap& bitmap, const FT_Glyph_Metrics& metrics, int left, int top)
+    {
+        int x = metrics.horiBearingX >> 6;
+        int y = -(metrics.horiBearingY >> 6);
+        int w = metrics.width >> 6;
+        int h = metrics.height >> 6;
+
+        int adv = metrics.horiAdvance >> 6;
+
+        int bmWidth = bitmapPixelWidth(bitmap);
+        int bmHeight = bitmap.rows;
+        PixelMode mode = FTtoPixelModel(static_cast<FT_Pixel_Mode>(bitmap.pixel_mode));
+        if (mode == PixelMode::RGB888)
+        {
+            // the filter widens the bitmap past the outline
+            x = left;
+            y = -top;
+            w = bmWidth;
+            h = bmHeight;
+        }
+        auto data = copyBitmapRows(bitmap, PixelModeSize(mode) * bmWidth);
+        auto* ret = new GlyphBitmap(std::move(data), bmWidth, bmHeight, Rect(x, y, w, h), adv, mode);
+        return std::shared_ptr<GlyphBitmap>(ret);
+    }
 }
 
 
 FontFreeType::FontFreeType(const std::string& fontName, float fontSize, float outline)
 {
-    _ftLibrary = _sFTLibrary.lock();
-    if (!_ftLibrary)
     {
-        _ftLibrary = std::make_shared< FontFreeTypeLibrary>();
+        std::lock_guard<std::mutex> lock(_sFTLibraryMutex);
+        _ftLibrary = _sFTLibrary.lock();
+        if (!_ftLibrary)
+        {
+            _ftLibrary = std::make_shared< FontFreeTypeLibrary>();
+            _sFTLibrary = _ftLibrary;
+        }
     }
 
     _fontName = fontName;
@@ -67,7 +140,11 @@ FontFreeType::FontFreeType(const std::string& fontName, float fontSize, float ou
 FontFreeType::~FontFreeType()
 {
     if (_stroker) FT_Stroker_Done(_stroker);
-    if (_face) FT_Done_Face(_face);
+    if (_face)
+    {
+        std::lock_guard<std::mutex> lock(_ftLibrary->faceMutex());
+        FT_Done_Face(_face);
+    }
 }
 
 FT_Library& FontFreeType::getFTLibrary()
@@ -77,12 +154,55 @@ FT_Library& FontFreeType::getFTLibrary()
 
 bool FontFreeType::loadFont()
 {
-    _fontData = utils::readFile(_fontName);
+    PROFILE_SCOPE("font.load");
+    std::vector<uint8_t> data;
+    if (!utils::readFile(_fontName, data))
+    {
+        return false;
+    }
+    return loadFont(std::move(data));
+}
+
+bool FontFreeType::loadFont(std::vector<uint8_t>&& data)
+{
+    _fontData = std::move(data);
+    return openFace(_fontData.data(), _fontData.size(), 0);
+}
 
-    if (FT_New_Memory_Face(getFTLibrary(), _fontData.data(), _fontData.size(), 0, &_face))
+bool FontFreeType::loadFace(std::shared_ptr<FontCollection> collection, int faceIndex)
+{
+    if (!collection || faceIndex < 0 || faceIndex >= static_cast<int>(collection->getFaceCount()))
     {
         return false;
     }
+    _collection = std::move(collection);
+    _faceIndex = faceIndex;
+    return true;
+}
+
+bool FontFreeType::ensureFace() const
+{
+    if (_collection)
+    {
+        std::call_once(_openFace, [this]() {
+            auto& file = _collection->getFile();
+            openFace(file->data(), file->size(), _faceIndex);
+        });
+    }
+    return _face != nullptr;
+}
+
+bool FontFreeType::openFace(const uint8_t* data, size_t size, int faceIndex) const
+{
+    PROFILE_SCOPE("font.open_face");
+    {
+        std::lock_guard<std::mutex> lock(_ftLibrary->faceMutex());
+        if (FT_New_Memory_Face(*_ftLibrary->get(), data, size, faceIndex, &_face))
+        {
+            _face = nullptr;
+            return false;
+        }
+    }
 
     if (FT_Select_Charmap(_face, _encoding))
     {
@@ -110,7 +230,29 @@ bool FontFreeType::loadFont()
     const int DPI = 72;
     int fontSizeInPoints = (int)(64.0f * _fontSize); //TODO times CC_CONTENT_SCALE_FACTOR;
 
-    if (FT_Set_Char_Size(_face, fontSizeInPoints, fontSizeInPoints, DPI, DPI))
+    if (!FT_IS_SCALABLE(_face) && _face->num_fixed_sizes > 0)
+    {
+        // color bitmap fonts only come in fixed strikes such as 109 px, take
+        // the smallest one not below the size, glyphs are scaled down once
+        // when they are rendered
+        int best = 0;
+        for (int i = 1; i < _face->num_fixed_sizes; i++)
+        {
+            const FT_Pos ppem = _face->available_sizes[i].y_ppem;
+            const FT_Pos bestPpem = _face->available_sizes[best].y_ppem;
+            const bool fits = ppem >= fontSizeInPoints, bestFits = bestPpem >= fontSizeInPoints;
+            if ((fits && (!bestFits || ppem < bestPpem)) || (!fits && !bestFits && ppem > bestPpem))
+            {
+                best = i;
+            }
+        }
+        if (FT_Select_Size(_face, best))
+        {
+            return false;
+        }
+        _bitmapScale = std::min(1.0f, fontSizeInPoints / static_cast<float>(_face->available_sizes[best].y_ppem));
+    }
+    else if (FT_Set_Char_Size(_face, fontSizeInPoints, fontSizeInPoints, DPI, DPI))
     {
         return false;
     }
@@ -122,6 +264,7 @@ bool FontFreeType::loadFont()
 
 int FontFreeType::getHorizontalKerningForChars(uint64_t a, uint64_t b) const
 {
+    if (!ensureFace()) return 0;
     auto idx1 = FT_Get_Char_Index(_face, static_cast<FT_ULong>(a));
     if (!idx1)
         return 0;
@@ -137,7 +280,7 @@ int FontFreeType::getHorizontalKerningForChars(uint64_t a, uint64_t b) const
 
 std::unique_ptr<std::vector<int>> FontFreeType::getHorizontalKerningForUTF32Text(const std::u32string& text) const
 {
-    if (!_face) return nullptr;
+    if (!ensureFace()) return nullptr;
     if (FT_HAS_KERNING(_face) == 0) return nullptr;
 
     const auto letterNum = text.length();
@@ -150,41 +293,261 @@ std::unique_ptr<std::vector<int>> FontFreeType::getHorizontalKerningForUTF32Text
     return std::unique_ptr<std::vector<int>>(sizes);
 }
 
+bool FontFreeType::getHorizontalKerningForUTF32Text64(const std::u32string& text, int* out) const
+{
+    if (!ensureFace()) return false;
+    if (FT_HAS_KERNING(_face) == 0) return false;
+
+    const auto letterNum = text.length();
+    if (letterNum > 0) out[0] = 0;
+
+    FT_UInt prev = letterNum > 0 ? FT_Get_Char_Index(_face, static_cast<FT_ULong>(text[0])) : 0;
+    for (size_t i = 1; i < letterNum; i++)
+    {
+        FT_UInt cur = FT_Get_Char_Index(_face, static_cast<FT_ULong>(text[i]));
+        FT_Vector kerning;
+        out[i] = prev && cur && !FT_Get_Kerning(_face, prev, cur, FT_KERNING_UNFITTED, &kerning) ? static_cast<int>(kerning.x) : 0;
+        prev = cur;
+    }
+    return true;
+}
+
+bool FontFreeType::getHorizontalKerningForUTF32Text(const std::u32string& text, int* out) const
+{
+    if (!ensureFace()) return false;
+    if (FT_HAS_KERNING(_face) == 0) return false;
+
+    const auto letterNum = text.length();
+    if (letterNum > 0) out[0] = 0;
+
+    for (size_t i = 1; i < letterNum; i++)
+    {
+        out[i] = getHorizontalKerningForChars(text[i - 1], text[i]);
+    }
+    return true;
+}
+
 
 int FontFreeType::getFontAscender() const
 {
-    return static_cast<int>(_face->size->metrics.ascender >> 6);
+    if (_collection) return _collection->getFaceInfo(_faceIndex).getAscender(_fontSize);
+    if (!_face) return 0;
+    return static_cast<int>(std::ceil((_face->size->metrics.ascender >> 6) * _bitmapScale));
 }
 
 const char* FontFreeType::getFontFamily() const
 {
-    if (!_face) return nullptr;
+    if (_collection) return _collection->getFaceInfo(_faceIndex).family.c_str();
+    if (!ensureFace()) return nullptr;
     return _face->family_name;
 }
 
+std::string FontFreeType::getIdentity() const
+{
+    return _fontName + '#' + std::to_string(_faceIndex) + '@' + std::to_string(_fontSize)
+        + '/' + std::to_string(_outlineSize) + (_lcd ? "/lcd" : "");
+}
+
 std::shared_ptr<GlyphBitmap> FontFreeType::getGlyphBitmap(uint64_t ch)
 {
-    if (!_face) return nullptr;
-    const auto load_char_flag = FT_LOAD_RENDER | FT_LOAD_NO_AUTOHINT;
-    if (FT_Load_Char(_face, static_cast<FT_ULong>(ch), load_char_flag))
+    PROFILE_SCOPE("font.glyph_bitmap");
+    if (!ensureFace()) return nullptr;
+    if (useOutlineCache())
+    {
+        return renderOutline(FT_Get_Char_Index(_face, static_cast<FT_ULong>(ch)));
+    }
+    if (FT_Load_Char(_face, static_cast<FT_ULong>(ch), getRenderFlags()))
     {
         return nullptr;
     }
+    return renderGlyphSlot();
+}
 
-    auto& metrics = _face->glyph->metrics;
-    int x = metrics.horiBearingX >> 6;
-    int y = -(metrics.horiBearingY >> 6);
-    int w = metrics.width >> 6;
-    int h = metrics.height >> 6;
+std::shared_ptr<GlyphBitmap> FontFreeType::getGlyphBitmapByIndex(uint32_t glyphIndex)
+{
+    PROFILE_SCOPE("font.glyph_bitmap");
+    if (!ensureFace()) return nullptr;
+    if (useOutlineCache())
+    {
+        return renderOutline(glyphIndex);
+    }
+    if (FT_Load_Glyph(_face, glyphIndex, getRenderFlags()))
+    {
+        return nullptr;
+    }
+    return renderGlyphSlot();
+}
 
-    int adv = metrics.horiAdvance >> 6;
+std::shared_ptr<GlyphBitmap> FontFreeType::getGlyphBitmapSubpixel(uint64_t ch, int offsetX)
+{
+    PROFILE_SCOPE("font.glyph_bitmap");
+    if (!ensureFace()) return nullptr;
+    // light and LCD hinting only snap vertically, the outline keeps its x position
+    auto* entry = _outlines.get(_face, FT_Get_Char_Index(_face, static_cast<FT_ULong>(ch)),
+        FT_LOAD_NO_AUTOHINT | (_lcd ? FT_LOAD_TARGET_LCD : FT_LOAD_TARGET_LIGHT));
+    if (!entry) return nullptr;
 
-    auto& bitmap = _face->glyph->bitmap;
-    int bmWidth = bitmap.width;
-    int bmHeight = bitmap.rows;
-    PixelMode mode = FTtoPixelModel(static_cast<FT_Pixel_Mode>(bitmap.pixel_mode));
-    int size = PixelModeSize(mode) * bmWidth * bmHeight;
-    std::vector<uint8_t> data((uint8_t*)bitmap.buffer, (uint8_t*)bitmap.buffer + size);
-    auto* ret = new GlyphBitmap(std::move(data), bmWidth, bmHeight, Rect(x, y, w, h), adv, mode);
+    // the cached outline is moved for rendering and moved back
+    FT_Glyph image = entry->glyph;
+    FT_Vector origin = { offsetX & 63, 0 };
+    if (FT_Glyph_To_Bitmap(&image, _lcd ? FT_RENDER_MODE_LCD : FT_RENDER_MODE_LIGHT, &origin, 0))
+    {
+        return nullptr;
+    }
+
+    auto* bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(image);
+    auto& bitmap = bitmapGlyph->bitmap;
+    const PixelMode mode = FTtoPixelModel(static_cast<FT_Pixel_Mode>(bitmap.pixel_mode));
+    const int width = bitmapPixelWidth(bitmap);
+    const int height = bitmap.rows;
+    auto data = copyBitmapRows(bitmap, PixelModeSize(mode) * width);
+    const int advance64 = static_cast<int>((entry->linearHoriAdvance + 512) >> 10);
+    auto* ret = new GlyphBitmap(std::move(data), width, height,
+        Rect(bitmapGlyph->left, -bitmapGlyph->top, width, height), (advance64 + 32) >> 6, mode);
+    ret->setXAdvance64(advance64);
+    if (image != entry->glyph)
+    {
+        FT_Done_Glyph(image);
+    }
     return std::shared_ptr<GlyphBitmap>(ret);
 }
+
+FT_Int32 FontFreeType::getRenderFlags() const
+{
+    FT_Int32 flags = FT_LOAD_RENDER | FT_LOAD_NO_AUTOHINT;
+    if (_lcd) flags |= FT_LOAD_TARGET_LCD;
+    if (FT_HAS_COLOR(_face)) flags |= FT_LOAD_COLOR;
+    return flags;
+}
+
+std::shared_ptr<GlyphBitmap> FontFreeType::renderGlyphSlot()
+{
+    if (_face->glyph->bitmap.pixel_mode == FT_PIXEL_MODE_BGRA)
+    {
+        return renderColorGlyphSlot();
+    }
+
+    FT_GlyphSlot slot = _face->glyph;
+    return createGlyphBitmap(slot->bitmap, slot->metrics, slot->bitmap_left, slot->bitmap_top);
+}
+
+bool FontFreeType::useOutlineCache() const
+{
+    // color glyphs are layered or bitmaps, they are rendered by FT_Load_Glyph
+    return FT_IS_SCALABLE(_face) && !FT_HAS_COLOR(_face);
+}
+
+std::shared_ptr<GlyphBitmap> FontFreeType::renderOutline(uint32_t glyphIndex)
+{
+    auto* entry = _outlines.get(_face, glyphIndex, FT_LOAD_NO_AUTOHINT | (_lcd ? FT_LOAD_TARGET_LCD : 0));
+    if (!entry) return nullptr;
+
+    // keeps the cached glyph, embedded bitmaps are returned as they are
+    FT_Glyph image = entry->glyph;
+    if (FT_Glyph_To_Bitmap(&image, _lcd ? FT_RENDER_MODE_LCD : FT_RENDER_MODE_NORMAL, nullptr, 0))
+    {
+        return nullptr;
+    }
+    auto* bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(image);
+    auto ret = createGlyphBitmap(bitmapGlyph->bitmap, entry->metrics, bitmapGlyph->left, bitmapGlyph->top);
+    if (image != entry->glyph)
+    {
+        FT_Done_Glyph(image);
+    }
+    return ret;
+}
+
+std::shared_ptr<GlyphBitmap> FontFreeType::getGlyphOutlineBitmap(uint64_t ch)
+{
+    PROFILE_SCOPE("font.glyph_bitmap");
+    if (!_stroker || !ensureFace() || !useOutlineCache()) return nullptr;
+    auto* entry = _outlines.get(_face, FT_Get_Char_Index(_face, static_cast<FT_ULong>(ch)), FT_LOAD_NO_AUTOHINT | (_lcd ? FT_LOAD_TARGET_LCD : 0));
+    if (!entry || entry->glyph->format != FT_GLYPH_FORMAT_OUTLINE) return nullptr;
+
+    FT_Glyph image = nullptr;
+    if (FT_Glyph_Copy(entry->glyph, &image))
+    {
+        return nullptr;
+    }
+    if (FT_Glyph_StrokeBorder(&image, _stroker, 0, 1) || FT_Glyph_To_Bitmap(&image, _lcd ? FT_RENDER_MODE_LCD : FT_RENDER_MODE_NORMAL, nullptr, 1))
+    {
+        FT_Done_Glyph(image);
+        return nullptr;
+    }
+
+    // the border reaches past the metrics of the glyph, place it as rendered
+    auto* bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(image);
+    auto& bitmap = bitmapGlyph->bitmap;
+    const PixelMode mode = FTtoPixelModel(static_cast<FT_Pixel_Mode>(bitmap.pixel_mode));
+    const int width = bitmapPixelWidth(bitmap);
+    const int height = bitmap.rows;
+    auto data = copyBitmapRows(bitmap, PixelModeSize(mode) * width);
+    auto* ret = new GlyphBitmap(std::move(data), width, height,
+        Rect(bitmapGlyph->left, -bitmapGlyph->top, width, height), entry->metrics.horiAdvance >> 6, mode);
+    FT_Done_Glyph(image);
+    return std::shared_ptr<GlyphBitmap>(ret);
+}
+
+std::shared_ptr<GlyphBitmap> FontFreeType::renderColorGlyphSlot()
+{
+    FT_GlyphSlot slot = _face->glyph;
+    auto& bitmap = slot->bitmap;
+    const int srcWidth = bitmap.width;
+    const int srcHeight = bitmap.rows;
+    auto data = copyBitmapRows(bitmap, srcWidth * 4);
+
+    int width = srcWidth;
+    int height = srcHeight;
+    if (_bitmapScale < 1.0f && srcWidth > 0 && srcHeight > 0)
+    {
+        width = std::max(1, static_cast<int>(std::lround(srcWidth * _bitmapScale)));
+        height = std::max(1, static_cast<int>(std::lround(srcHeight * _bitmapScale)));
+        std::vector<uint8_t> scaled(width * height * 4);
+        BitmapKernels::downscaleBGRA(data.data(), srcWidth, srcHeight, scaled.data(), width, height);
+        data.swap(scaled);
+    }
+
+    const int x = static_cast<int>(std::lround(slot->bitmap_left * _bitmapScale));
+    const int y = -static_cast<int>(std::lround(slot->bitmap_top * _bitmapScale));
+    const int advance64 = static_cast<int>(std::lround(slot->advance.x * _bitmapScale));
+    auto* ret = new GlyphBitmap(std::move(data), width, height, Rect(x, y, width, height), (advance64 + 32) >> 6, PixelMode::BGRA8888);
+    ret->setXAdvance64(advance64);
+    return std::shared_ptr<GlyphBitmap>(ret);
+}
+
+uint32_t FontFreeType::getGlyphIndex(uint64_t ch) const
+{
+    if (!ensureFace()) return 0;
+    return FT_Get_Char_Index(_face, static_cast<FT_ULong>(ch));
+}
+
+int FontFreeType::getGlyphAdvance(uint32_t glyphIndex)
+{
+    if (!ensureFace()) return 0;
+    // the advances of the bitmaps, hinted like the glyphs getGlyphBitmap() renders
+    if (useOutlineCache())
+    {
+        auto* entry = _outlines.get(_face, glyphIndex, FT_LOAD_NO_AUTOHINT | (_lcd ? FT_LOAD_TARGET_LCD : 0));
+        return entry ? static_cast<int>(entry->metrics.horiAdvance >> 6) : 0;
+    }
+    FT_Fixed advance = 0;
+    if (FT_Get_Advance(_face, glyphIndex, getRenderFlags() & ~FT_LOAD_RENDER, &advance))
+    {
+        return 0;
+    }
+    if (FT_HAS_COLOR(_face))
+    {
+        const int advance64 = static_cast<int>(std::lround((advance >> 10) * _bitmapScale));
+        return (advance64 + 32) >> 6;
+    }
+    return static_cast<int>(advance >> 16);
+}
+
+int FontFreeType::getHorizontalKerningForGlyphs(uint32_t a, uint32_t b) const
+{
+    if (!ensureFace() || !a || !b) return 0;
+    FT_Vector kerning;
+    if (FT_Get_Kerning(_face, a, b, FT_KERNING_DEFAULT, &kerning))
+        return 0;
+    return static_cast<int>(kerning.x >> 6);
+}
@@ -7,12 +7,15 @@
 
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "OutlineCache.h"
 #include "defs.h"
 
 class FontFreeTypeLibrary;
+class FontCollection;
 
 class FontFreeType
 {
@@ -23,24 +26,112 @@ public:
     FT_Library& getFTLibrary();
 
     bool loadFont();
+    /**
+    * Creates the face from file data read elsewhere, e.g. by AsyncFontLoader.
+    */
+    bool loadFont(std::vector<uint8_t>&& data);
+    /**
+    * Uses face `faceIndex` of a font file or collection shared with other
+    * fonts. Nothing is parsed now, the FT_Face is opened by the first request
+    * which needs it, metrics and names are answered from the collection.
+    */
+    bool loadFace(std::shared_ptr<FontCollection> collection, int faceIndex);
+
+    /**
+    * False until a lazily loaded face has been opened.
+    */
+    bool isFaceOpen() const { return _face != nullptr; }
 
     int getHorizontalKerningForChars(uint64_t a, uint64_t b) const;
     std::unique_ptr<std::vector<int>> getHorizontalKerningForUTF32Text(const std::u32string &text) const;
+    /**
+    * Writes one kerning offset per character of `text` into `out`, which must
+    * hold text.length() items. Returns false if the font has no kerning.
+    */
+    bool getHorizontalKerningForUTF32Text(const std::u32string &text, int *out) const;
+    /**
+    * Same as above in 26.6 fixed point, not rounded to whole pixels.
+    */
+    bool getHorizontalKerningForUTF32Text64(const std::u32string &text, int *out) const;
+
+    /**
+    * Renders glyphs for LCD panels with FT_LOAD_TARGET_LCD and the FreeType
+    * LCD filter, one coverage byte per subpixel. The bitmaps are RGB888 and
+    * need an atlas of that mode, see getPixelMode().
+    */
+    void setLCDRendering(bool enable) { _lcd = enable; }
+    bool isLCDRendering() const { return _lcd; }
+    PixelMode getPixelMode() const { return _lcd ? PixelMode::RGB888 : PixelMode::A8; }
 
     int getFontAscender() const;
     const char* getFontFamily() const;
 
+    /**
+    * File, face, size, outline and rendering as one string. Fonts with the
+    * same identity produce the same glyphs and metrics.
+    */
+    std::string getIdentity() const;
+
+    /**
+    * Color glyphs (CBDT, sbix) are BGRA8888 and scaled down from the strike
+    * of the font to its size, see FontAtlas::addLetter().
+    */
     std::shared_ptr<GlyphBitmap> getGlyphBitmap(uint64_t ch);
+    std::shared_ptr<GlyphBitmap> getGlyphBitmapByIndex(uint32_t glyphIndex);
+    /**
+    * Renders `ch` moved right by `offsetX` / 64 of a pixel, for subpixel
+    * positioning. The outline is only hinted vertically, the rect is the
+    * placement of the bitmap and the advance is not rounded, see
+    * GlyphBitmap::getXAdvance64().
+    */
+    std::shared_ptr<GlyphBitmap> getGlyphBitmapSubpixel(uint64_t ch, int offsetX);
+
+    /**
+    * Renders the border of `ch` stroked by the outline size of the font,
+    * nullptr if the font has no outline or the glyph is not scalable.
+    */
+    std::shared_ptr<GlyphBitmap> getGlyphOutlineBitmap(uint64_t ch);
+
+    /**
+    * Glyphs of scalable fonts are loaded once into the outline cache, filled,
+    * stroked and subpixel renderings all start from it.
+    */
+    OutlineCache& getOutlineCache() { return _outlines; }
+
+    uint32_t getGlyphIndex(uint64_t ch) const;
+    /**
+    * The advance in pixels of the bitmap getGlyphBitmapByIndex() returns.
+    */
+    int getGlyphAdvance(uint32_t glyphIndex);
+    int getHorizontalKerningForGlyphs(uint32_t a, uint32_t b) const;
+
+    FT_Face getFTFace() const { return ensureFace() ? _face : nullptr; }
 
 private:
+    FT_Int32 getRenderFlags() const;
+    std::shared_ptr<GlyphBitmap> renderGlyphSlot();
+    bool useOutlineCache() const;
+    std::shared_ptr<GlyphBitmap> renderOutline(uint32_t glyphIndex);
+    std::shared_ptr<GlyphBitmap> renderColorGlyphSlot();
+    bool openFace(const uint8_t* data, size_t size, int faceIndex) const;
+    bool ensureFace() const;
+
     std::shared_ptr<FontFreeTypeLibrary> _ftLibrary;
     std::vector<uint8_t> _fontData;
     float _outlineSize = 0.0f;
     float _fontSize = 0.0f;
-    float _lineHeight = 0.0f;
+    mutable float _lineHeight = 0.0f;
     std::string _fontName;
+    std::shared_ptr<FontCollection> _collection;
+    int _faceIndex = 0;
+    bool _lcd = false;
+    // size over strike size of bitmap-only fonts, glyphs are scaled by it
+    mutable float _bitmapScale = 1.0f;
+    mutable std::once_flag _openFace;
 
     FT_Stroker _stroker = { 0 };
-    FT_Face    _face = { 0 };
-    FT_Encoding _encoding = FT_ENCODING_UNICODE;
+    mutable FT_Face    _face = { 0 };
+    mutable FT_Encoding _encoding = FT_ENCODING_UNICODE;
+    // holds library memory, destroyed before _ftLibrary
+    OutlineCache _outlines;
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "FontLetterMap.h"
+
+namespace {
+
+    const size_t INITIAL_CAPACITY = 256;
+
+    inline size_t slotOf(uint64_t key)
+    {
+        // keys differ in their low bits and in the flags at the top, the
+        // finalizer of MurmurHash3 spreads both over the mask
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+}
+
+FontLetterMap::Table::Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity])
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        slots[i].key.store(0, std::memory_order_relaxed);
+        slots[i].entry.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+FontLetterMap::FontLetterMap() : _table(nullptr), _size(0)
+{
+    clear();
+}
+
+FontLetterMap::~FontLetterMap()
+{
+}
+
+const FontLetterMap::Entry* FontLetterMap::find(uint64_t key) const
+{
+    const Table* table = _table.load(std::memory_order_acquire);
+    for (size_t i = slotOf(key) & table->mask;; i = (i + 1) & table->mask)
+    {
+        const Slot& slot = table->slots[i];
+        const Entry* entry = slot.entry.load(std::memory_order_acquire);
+        if (!entry)
+        {
+            return nullptr;
+        }
+        // written before the entry was published
+        if (slot.key.load(std::memory_order_relaxed) == key)
+        {
+            return entry;
+        }
+    }
+}
+
+const FontLetterMap::Entry* FontLetterMap::insert(uint64_t key, const Entry& entry)
+{
+    if (const Entry* present = find(key))
+    {
+        return present;
+    }
+
+    Table* table = _tables.back().get();
+    const size_t size = _size.load(std::memory_order_relaxed);
+    if ((size + 1) * 2 > table->mask + 1)
+    {
+        // readers keep probing the old table until the new one is published
+        std::unique_ptr<Table> grown(new Table((table->mask + 1) * 2));
+        for (size_t i = 0; i <= table->mask; i++)
+        {
+            const Entry* e = table->slots[i].entry.load(std::memory_order_relaxed);
+            if (e)
+            {
+                place(*grown, table->slots[i].key.load(std::memory_order_relaxed), e);
+            }
+        }
+        table = grown.get();
+        _tables.push_back(std::move(grown));
+        _table.store(table, std::memory_order_release);
+    }
+
+    _entries.push_back(entry);
+    const Entry* ret = &_entries.back();
+    place(*table, key, ret);
+    _size.store(size + 1, std::memory_order_relaxed);
+    return ret;
+}
+
+void FontLetterMap::place(Table& table, uint64_t key, const Entry* entry)
+{
+    size_t i = slotOf(key) & table.mask;
+    while (table.slots[i].entry.load(std::memory_order_relaxed))
+    {
+        i = (i + 1) & table.mask;
+    }
+    table.slots[i].key.store(key, std::memory_order_relaxed);
+    table.slots[i].entry.store(entry, std::memory_order_release);
+}
+
+void FontLetterMap::clear()
+{
+    _tables.clear();
+    _tables.emplace_back(new Table(INITIAL_CAPACITY));
+    _table.store(_tables.back().get(), std::memory_order_release);
+    _entries.clear();
+    _size.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "defs.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+struct FontLetterDefinition
+{
+    float texX = 0, texY =0;
+    float texWidth = 0, texHeight = 0;
+    //int offsetX, offsetY;
+    Rect rect;
+    int textureID = -1;
+    int xAdvance = 0;
+    int xAdvance64 = 0;     // 26.6
+    bool validate = false;
+    bool color = false;     // textureID is a color page, see FontAtlas::colorFrameAt()
+
+    /** False for blank glyphs like the space, they only advance the cursor. */
+    bool hasQuad() const { return rect.getWidth() > 0 && rect.getHeight() > 0; }
+};
+
+/**
+* The glyphs of a FontAtlas by key, for one writer and any number of readers
+* at the same time.
+*
+* Lookups take no lock: entries are immutable once inserted and are published
+* into an open addressing table with a release store. When the table gets
+* half full the writer publishes a copy twice the size, the tables readers
+* may still be probing are only freed by clear(). Inserts must be serialized
+* by the caller.
+*/
+class FontLetterMap {
+public:
+    struct Entry {
+        FontLetterDefinition def;
+        std::atomic<unsigned>* stamp = nullptr;     // of the frame holding the pixels, bumped by lookups
+    };
+
+    FontLetterMap();
+    ~FontLetterMap();
+
+    FontLetterMap(const FontLetterMap&) = delete;
+    FontLetterMap& operator=(const FontLetterMap&) = delete;
+
+    /**
+    * Returns nullptr if `key` is not in the map. Safe with a concurrent
+    * insert(), the entry stays valid until clear().
+    */
+    const Entry* find(uint64_t key) const;
+
+    /**
+    * Publishes a copy of `entry` under `key` and returns it, or the entry
+    * present under `key` already. Writer only.
+    */
+    const Entry* insert(uint64_t key, const Entry& entry);
+
+    size_t size() const { return _size.load(std::memory_order_relaxed); }
+
+    /**
+    * Drops all entries and the retired tables, not safe with readers.
+    */
+    void clear();
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<const Entry*> entry;
+    };
+
+    struct Table {
+        explicit Table(size_t capacity);
+
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    static void place(Table& table, uint64_t key, const Entry* entry);
+
+    std::atomic<const Table*> _table;
+    std::vector<std::unique_ptr<Table>> _tables;    // the current one last
+    std::deque<Entry> _entries;     // never moved, readers hold pointers
+    std::atomic<size_t> _size;
+};
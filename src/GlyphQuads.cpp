@@ -0,0 +1,131 @@
+#include "GlyphQuads.h"
+#include "TextLayout.h"
+
+#if defined(__AVX__)
+#define GLYPHQUADS_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLYPHQUADS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GLYPHQUADS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+    inline void writeQuad(C3F_T2F_C4B* quad, float l, float b, float r, float t,
+        float ul, float vb, float ur, float vt, const Vec4<uint8_t>& color)
+    {
+        quad[0].vertex.set(l, b, 0.0f);
+        quad[0].texCoord.set(ul, vb);
+        quad[0].color = color;
+        quad[1].vertex.set(r, b, 0.0f);
+        quad[1].texCoord.set(ur, vb);
+        quad[1].color = color;
+        quad[2].vertex.set(l, t, 0.0f);
+        quad[2].texCoord.set(ul, vt);
+        quad[2].color = color;
+        quad[3].vertex.set(r, t, 0.0f);
+        quad[3].texCoord.set(ur, vt);
+        quad[3].color = color;
+    }
+
+    // transforms 4 quads at once into the four position arrays
+    struct Lanes4 {
+        float l[4], b[4], r[4], t[4];
+    };
+
+    inline void transform4(const GlyphQuads& q, size_t i, float tx, float ty, float scale, Lanes4& out)
+    {
+#if GLYPHQUADS_AVX || GLYPHQUADS_SSE2
+        const __m128 s = _mm_set1_ps(scale);
+        const __m128 x = _mm_set1_ps(tx);
+        const __m128 y = _mm_set1_ps(ty);
+        _mm_storeu_ps(out.l, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q.x0.data() + i), s), x));
+        _mm_storeu_ps(out.r, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q.x1.data() + i), s), x));
+        _mm_storeu_ps(out.b, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q.y0.data() + i), s), y));
+        _mm_storeu_ps(out.t, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q.y1.data() + i), s), y));
+#elif GLYPHQUADS_NEON
+        const float32x4_t x = vdupq_n_f32(tx);
+        const float32x4_t y = vdupq_n_f32(ty);
+        vst1q_f32(out.l, vmlaq_n_f32(x, vld1q_f32(q.x0.data() + i), scale));
+        vst1q_f32(out.r, vmlaq_n_f32(x, vld1q_f32(q.x1.data() + i), scale));
+        vst1q_f32(out.b, vmlaq_n_f32(y, vld1q_f32(q.y0.data() + i), scale));
+        vst1q_f32(out.t, vmlaq_n_f32(y, vld1q_f32(q.y1.data() + i), scale));
+#else
+        for (int k = 0; k < 4; k++)
+        {
+            out.l[k] = q.x0[i + k] * scale + tx;
+            out.r[k] = q.x1[i + k] * scale + tx;
+            out.b[k] = q.y0[i + k] * scale + ty;
+            out.t[k] = q.y1[i + k] * scale + ty;
+        }
+#endif
+    }
+}
+
+namespace GlyphQuadKernels {
+
+    void scaleTranslate(float* v, size_t n, float scale, float offset)
+    {
+        size_t i = 0;
+#if GLYPHQUADS_AVX
+        const __m256 s8 = _mm256_set1_ps(scale);
+        const __m256 o8 = _mm256_set1_ps(offset);
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(v + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(v + i), s8), o8));
+        }
+#endif
+#if GLYPHQUADS_AVX || GLYPHQUADS_SSE2
+        const __m128 s4 = _mm_set1_ps(scale);
+        const __m128 o4 = _mm_set1_ps(offset);
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm_storeu_ps(v + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(v + i), s4), o4));
+        }
+#elif GLYPHQUADS_NEON
+        const float32x4_t o4 = vdupq_n_f32(offset);
+        for (; i + 4 <= n; i += 4)
+        {
+            vst1q_f32(v + i, vmlaq_n_f32(o4, vld1q_f32(v + i), scale));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            v[i] = v[i] * scale + offset;
+        }
+    }
+
+    void expand(const GlyphQuads& q, float tx, float ty, float scale, const Vec4<uint8_t>& color, C3F_T2F_C4B* out)
+    {
+        const size_t n = q.size();
+        size_t i = 0;
+        Lanes4 lanes;
+        for (; i + 4 <= n; i += 4)
+        {
+            transform4(q, i, tx, ty, scale, lanes);
+            for (int k = 0; k < 4; k++)
+            {
+                writeQuad(out + (i + k) * 4, lanes.l[k], lanes.b[k], lanes.r[k], lanes.t[k],
+                    q.u0[i + k], q.v0[i + k], q.u1[i + k], q.v1[i + k], color);
+            }
+        }
+        for (; i < n; i++)
+        {
+            writeQuad(out + i * 4, q.x0[i] * scale + tx, q.y0[i] * scale + ty, q.x1[i] * scale + tx, q.y1[i] * scale + ty,
+                q.u0[i], q.v0[i], q.u1[i], q.v1[i], color);
+        }
+    }
+
+    void expandScalar(const GlyphQuads& q, float tx, float ty, float scale, const Vec4<uint8_t>& color, C3F_T2F_C4B* out)
+    {
+        const size_t n = q.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            writeQuad(out + i * 4, q.x0[i] * scale + tx, q.y0[i] * scale + ty, q.x1[i] * scale + tx, q.y1[i] * scale + ty,
+                q.u0[i], q.v0[i], q.u1[i], q.v1[i], color);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Arena.h"
+#include "defs.h"
+
+#include <cstddef>
+
+struct C3F_T2F_C4B;
+
+/**
+* Glyph quads of one line kept as structure of arrays, so that translation
+* and vertex expansion run over contiguous floats.
+*/
+struct GlyphQuads {
+    explicit GlyphQuads(utils::MonotonicArena& arena)
+        : x0(arena), y0(arena), x1(arena), y1(arena), u0(arena), v0(arena), u1(arena), v1(arena), page(arena) {}
+
+    /**
+    * Set in `page` for glyphs on a color page, see FontAtlas::colorFrameAt().
+    */
+    static const int COLOR_PAGE = 1 << 16;
+
+    void push(float l, float b, float r, float t, float ul, float vb, float ur, float vt, int pg = 0)
+    {
+        x0.push_back(l); y0.push_back(b); x1.push_back(r); y1.push_back(t);
+        u0.push_back(ul); v0.push_back(vb); u1.push_back(ur); v1.push_back(vt);
+        page.push_back(pg);
+    }
+
+    void clear()
+    {
+        x0.clear(); y0.clear(); x1.clear(); y1.clear();
+        u0.clear(); v0.clear(); u1.clear(); v1.clear();
+        page.clear();
+    }
+
+    size_t size() const { return x0.size(); }
+
+    utils::ArenaVector<float> x0, y0, x1, y1;
+    utils::ArenaVector<float> u0, v0, u1, v1;
+    utils::ArenaVector<int> page;   // atlas frame of the glyph, | COLOR_PAGE for color frames
+};
+
+namespace GlyphQuadKernels {
+
+    /**
+    * v[i] = v[i] * scale + offset, vectorized with AVX, SSE2 or NEON when the
+    * target supports it.
+    */
+    void scaleTranslate(float* v, size_t n, float scale, float offset);
+
+    /**
+    * Expands quads [0, quads.size()) into 4 vertices each: left-bottom,
+    * right-bottom, left-top, right-top. Positions are scaled then translated
+    * by (tx, ty).
+    */
+    void expand(const GlyphQuads& quads, float tx, float ty, float scale, const Vec4<uint8_t>& color, C3F_T2F_C4B* out);
+
+    /**
+    * Reference implementation of expand() without SIMD.
+    */
+    void expandScalar(const GlyphQuads& quads, float tx, float ty, float scale, const Vec4<uint8_t>& color, C3F_T2F_C4B* out);
+}
@@ -1,137 +1,10 @@
 #include "Label.h"
+#include "Capture.h"
 #include "ccUTF8.h"
+#include "Profiler.h"
 
 #include <cassert>
 
-#include <fstream>
-
-#define cout_vect(vec) \
-        std::cout << "{" << vec.getX() << "," << vec.getY() << "}";
-
-class TextSpace {
-    /**
-    *   Y 
-    *   ^
-    *   |
-    *   |
-    *   +------> X
-    */
-public:
-    void fillRect(Rect &rect, Rect &uv);
-    void reset();
-
-    inline bool validate() const { return _data.size() > 0; }
-
-    void inspect(std::ostream &) const;
-
-    void translate(float x, float y);
-
-    Vec2<float> center() const;
-
-    float getWidth() const { return  _data.size() > 0 ? _right - _left : 0; }
-    float getHeight() const { return _data.size() > 0 ? _top - _bottom : 0; }
-private:
-    float _left   = FLT_MAX;
-    float _bottom = FLT_MAX;
-    float _right  = FLT_MIN;
-    float _top    = FLT_MIN;
-    float _x = 0.0f;
-    float _y = 0.0f;
-    std::vector<Rect>   _data;
-    std::vector<Rect>  _uv;
-};
-
-struct TextSpaceArray {
-
-    void addSpace(const TextSpace& space)
-    {
-        _maxWidth = std::max(_maxWidth, space.getWidth());
-        _data.push_back(space);
-    }
-
-    float _maxWidth = FLT_MIN;
-    std::vector<TextSpace> _data;
-};
-
-void TextSpace::reset()
-{
-    _left = FLT_MAX;
-    _bottom = FLT_MAX;
-    _right = FLT_MIN;
-    _top = FLT_MIN;
-    _x = 0.0f;
-    _y = 0.0f;
-    _data.clear();
-    _uv.clear();
-}
-
-void TextSpace::fillRect(Rect &rect, Rect &uv)
-{
-    _left = std::min(_left, rect.getLeft());
-    _right = std::max(_right, rect.getRight());
-    _bottom = std::min(_bottom, rect.getBottom());
-    _top = std::max(_top, rect.getTop());
-    _data.push_back(rect);
-    _uv.push_back(uv);
-}
-
-void TextSpace::translate(float x, float y)
-{
-    _x = x;
-    _y = y;
-}
-
-Vec2<float> TextSpace::center() const
-{
-    Vec2<float> ret((_left + _right) / 2.0f, (_bottom + _top) / 2.0f);
-    return ret;
-}
-
-void TextSpace::inspect(std::ostream &out) const
-{
-
-    const int size = _data.size();
-
-    Vec2<float> offset(_x, _y);
-
-    for (int i = 0; i < size; i++)
-    {
-        auto rect = _data[i];
-        rect.setOrigin(rect.getOrigin() + offset);
-        auto uv = _uv[i];
-        out << "Triangle[{";
-        out << "{" << rect.getLeft() << "," << rect.getBottom() << "}, ";
-        out << "{" << rect.getRight() << "," << rect.getBottom() << "}, ";
-        out << "{" << rect.getLeft() << "," << rect.getTop() << "}";
-        out << "},";
-        out << "VertexTextureCoordinates -> {";
-        out << "{" << uv.getLeft() << ", " << uv.getBottom() << "},";
-        out << "{" << uv.getRight() << ", " << uv.getBottom()<< "},";
-        out << "{" << uv.getLeft() << ", " << uv.getTop() << "}";
-        out << "}],";
-
-        out << "Triangle[{";
-        out << "{" << rect.getRight() << "," << rect.getBottom() << "}, ";
-        out << "{" << rect.getRight() << "," << rect.getTop() << "}, ";
-        out << "{" << rect.getLeft() << "," << rect.getTop() << "}";
-        out << "},";
-        out << "VertexTextureCoordinates -> {";
-        out << "{" << uv.getRight() << ", " << uv.getBottom() << "},";
-        out << "{" << uv.getRight() << ", " << uv.getTop() << "},";
-        out << "{" << uv.getLeft() << ", " << uv.getTop() << "}";
-        out << "}]";
-
-        if (i != size - 1)
-        {
-            out << ",";
-        }
-        out.flush();
-    }
-}
-
-
-
-
 bool Label::init(const std::string& font, const std::string& text, float fontSize, float outline)
 {
     _ttfFont = new FontFreeType(font, fontSize, outline);
@@ -144,7 +17,7 @@ bool Label::init(const std::string& font, const std::string& text, float fontSiz
     _fontSize = fontSize;
     _outline = outline;
 
-    StringUtils::UTF8ToUTF32(text.c_str(), _u32string);
+    StringUtils::UTF8ToUTF32(text, _u32string);
 
     _lineHeight = _ttfFont->getFontAscender();
 
@@ -158,146 +31,153 @@ Label::~Label()
     delete _ttfFont;
 }
 
-bool Label::updateContent()
+bool Label::setString(const std::string& text)
 {
-    std::vector<C3F_T2F_C4B> rows;
-    FontLetterDefinition* letterDef;
-    Rect row;
-
-    int contentWidth = 0;
-    int contentHeight = 0;
-    int rowHeight = _lineHeight;
-
-    //TODO: kerning
+    if (!_ttfFont || !StringUtils::UTF8ToUTF32(text, _u32string)) return false;
+    _string = text;
+    return updateContent();
+}
 
-    //LabelCursor cursor;
-    int cursorX = 0;
-    int cursorY = _lineHeight;
+void Label::setShaper(TextShaper* shaper)
+{
+    _shaper = shaper;
+    if (_ttfFont)
+    {
+        updateContent();
+    }
+}
 
-    //  std::cout << "Graphics[{";
+bool Label::addFallbackFont(const std::string& font)
+{
+    if (!_ttfFont) return false;
+    if (!_fallback)
+    {
+        _fallback.reset(new FontFallbackChain(_ttfFont));
+    }
+    if (!_fallback->addFont(font, _fontSize, _outline)) return false;
+    _fallback->getFont(_fallback->getFontCount() - 1)->setLCDRendering(_ttfFont->isLCDRendering());
+    updateContent();
+    return true;
+}
 
-    TextSpaceArray spaces;
+void Label::setSubpixelBins(int bins)
+{
+    _subpixelBins = std::max(1, bins);
+    if (_ttfFont)
+    {
+        updateContent();
+    }
+}
 
-    TextSpace space;
+void Label::setLCDRendering(bool enable)
+{
+    if (!_ttfFont || _ttfFont->isLCDRendering() == enable) return;
+    _ttfFont->setLCDRendering(enable);
+    delete _fontAtlas;
+    _fontAtlas = new FontAtlas(_ttfFont->getPixelMode(), 512, 512);
+    _fontAtlas->init();
+    if (_fallback)
+    {
+        for (size_t i = 1; i < _fallback->getFontCount(); i++)
+        {
+            _fallback->getFont(i)->setLCDRendering(enable);
+        }
+    }
+    updateContent();
+}
 
-    auto kerning = _ttfFont->getHorizontalKerningForUTF32Text(_u32string);
+bool Label::updateContent()
+{
+    PROFILE_SCOPE("label.update");
+    TextLayoutStyle style;
+    style.lineHeight = _lineHeight;
+    style.spaceX = _spaceX;
+    style.alignH = _alignH;
+    style.subpixelBins = _subpixelBins;
 
+    _scratch.reset();
+    TextSpaceArray& spaces = _scratch.spaces;
 
-    for (int i = 0; i < _u32string.size(); i++)
+    if (_shaper)
     {
-        auto ch = _u32string[i];
-
-        if (ch == u'\r')
+        TextLayout::layoutShapedLines(_u32string, _shaper, _fontAtlas, _ttfFont, style, spaces);
+    }
+    else if (_subpixelBins > 1 && !_fallback)
+    {
+        const int* kerning = nullptr;
+        if (_enableKerning)
         {
-            cursorX = 0;
-            continue;
+            _scratch.kerning.resize(_u32string.length());
+            if (_ttfFont->getHorizontalKerningForUTF32Text64(_u32string, _scratch.kerning.data()))
+            {
+                kerning = _scratch.kerning.data();
+            }
         }
 
-        if (ch == u'\n')
+        TextLayout::layoutSubpixelLines(_u32string, kerning, _fontAtlas, _ttfFont, style, spaces);
+    }
+    else
+    {
+        const int* kerning = nullptr;
+        if (_enableKerning)
         {
-            //  cursorY += _lineHeight;
-            cursorX = 0;
-            if (space.validate())
+            _scratch.kerning.resize(_u32string.length());
+            if (_ttfFont->getHorizontalKerningForUTF32Text(_u32string, _scratch.kerning.data()))
             {
-                spaces.addSpace(space);
-                space.reset();
+                kerning = _scratch.kerning.data();
             }
-            continue;
         }
 
-        letterDef = _fontAtlas->getOrLoad(ch, _ttfFont);
-        if (!letterDef) continue;
-
-        if (kerning) {
-            cursorX += kerning->at(i);
+        if (_fallback)
+        {
+            TextLayout::layoutFallbackLines(_u32string, kerning, _fontAtlas, _fallback.get(), style, spaces);
         }
+        else
+        {
+            TextLayout::layoutLines(_u32string, kerning, _fontAtlas, _ttfFont, style, spaces);
+        }
+    }
 
-        //cursor.fillRect(letterDef->get)
-        Rect& rect = letterDef->rect;
-        int left = cursorX + rect.getLeft();
-        int right = cursorX + rect.getRight();
-#if 0
-        int top = cursorY + rect.getBottom();
-        int bottom = cursorY + rect.getTop();
-#else
-        int bottom = cursorY + rect.getBottom();
-        int top = cursorY + rect.getTop();
-#endif
-        Vec2<int> lt(left, top);
-        Vec2<int> lb(left, bottom);
-        Vec2<int> rt(right, top);
-        Vec2<int> rb(right, bottom);
-
-
-        Rect letterRect(left, bottom, right - left, top - bottom);
-        Rect letterTexture(letterDef->texX, letterDef->texY, letterDef->texWidth, letterDef->texHeight);
-
-        space.fillRect(letterRect, letterTexture);
-
-        cursorX += _spaceX + letterDef->xAdvance;
+    TextLayout::alignLines(spaces, style);
+    _fontAtlas->endLayout();
 
- 
-    }
+    _vertices.resize(spaces.quadCount() * 4);
+    TextLayout::fillVertices(spaces, _vertices.data());
 
 #ifdef ENABLE_INSPECT
-    std::fstream dataFile;
-    std::string filename = "C:\\Projects\\freetype-tests\\build\\Debug\\output3.txt";
-    dataFile.open(filename.c_str(), std::fstream::out);
-    _fontAtlas->frameAt(0).inspect(dataFile);
-    dataFile.close();
-#endif
-
-    if (space.validate())
+    if (const uint64_t id = utils::capture::sample())
     {
-        spaces.addSpace(space);
-        space.reset();
+        capture(utils::capture::filePath("label", id, ""));
     }
+#endif
 
-    std::cout << std::endl;
-
-    float max_width = spaces._maxWidth;
-    float max_height = spaces._data.size() * _lineHeight;
-    auto& list = spaces._data;
-
-    std::fstream cmdFile;
-    std::string filename2 = "C:\\Projects\\freetype-tests\\build\\Debug\\output_draw.txt";
-    cmdFile.open(filename2.c_str(), std::fstream::out);
-
-    cmdFile << "Graphics[{Texture[img], ";
-
-    Vec2<float> K;
-    Vec2<float> M;
+    return true;
+}
 
-    for(int i=0;i<list.size();i++)
+#ifdef ENABLE_INSPECT
+bool Label::capture(const std::string& prefix) const
+{
+    if (!_fontAtlas)
     {
-        auto& s = list[i];
-        auto c = s.center();
-        if(_alignH == LabelAlignmentH::CENTER)
-        {
-            K.set(0, - max_height / 2 + i * _lineHeight + _lineHeight / 2.0f);
-            M = K - s.center();
-        }
-        else if (_alignH == LabelAlignmentH::LEFT)
-        {
-            K.set(-max_width/2 + s.getWidth() / 2.0f, -max_height / 2 + i * _lineHeight + _lineHeight / 2.0f);
-            M = K - s.center();
-        }
-        else
-        {
-            K.set(max_width / 2 - s.getWidth() / 2.0f, -max_height / 2 + i * _lineHeight + _lineHeight / 2.0f);
-            M = K - s.center();
-        }
-
-        s.translate(M.getX(), M.getY());
-        s.inspect(cmdFile);
-        if (i != list.size() - 1)
+        return false;
+    }
+    bool ret = TextLayout::captureQuads(_scratch.spaces, prefix + ".quads");
+    for (int i = 0; i < _fontAtlas->getFrameCount(); i++)
+    {
+        const FontAtlasFrame* frame = _fontAtlas->frameAt(i);
+        if (!frame)
         {
-            cmdFile << ",";
+            ret = false;
+            continue;
         }
+        const PixelMode mode = frame->getPixelMode();
+        const char* suffix = mode == PixelMode::A8 || mode == PixelMode::A4 ? ".pgm" : ".tga";
+        ret = frame->capture(prefix + "_frame" + std::to_string(i) + suffix) && ret;
     }
-    cmdFile << "}, Background -> LightBlue, Axes -> True, GridLines -> Automatic, ImageSize -> Large]";
-
-    cmdFile.close();
-
-    return true;
+    for (int i = 0; i < _fontAtlas->getColorFrameCount(); i++)
+    {
+        ret = _fontAtlas->colorFrameAt(i).capture(prefix + "_color" + std::to_string(i) + ".tga") && ret;
+    }
+    return ret;
 }
+#endif
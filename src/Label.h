@@ -1,30 +1,68 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <FontAtlas.h>
+#include <FontFallbackChain.h>
 #include <FontFreetype.h>
+#include <TextLayout.h>
 
 
-enum class LabelAlignmentH
-{
-    LEFT, CENTER, RIGHT
-};
-enum class LabelAlignmentV {
-    TOP, CENTER, BOTTOM
-};
-
-struct C3F_T2F_C4B {
-    Vec3<float> vertex;
-    Vec2<float> texCoord;
-    Vec4<uint8_t> color;
-};
-
 class Label {
 public:
     Label() = default;
     bool init(const std::string& font, const std::string& text, float fontSize, float outline);
     virtual ~Label();
 
+    const std::vector<C3F_T2F_C4B>& getVertices() const { return _vertices; }
+
+    /**
+    * Replaces the text and lays it out again with the same font.
+    */
+    bool setString(const std::string& text);
+
+    /**
+    * Enables the shaping stage for bidirectional and complex scripts, the
+    * shaper and its run cache may be shared by many labels. Pass nullptr to
+    * map characters to glyphs directly.
+    */
+    void setShaper(TextShaper* shaper);
+
+    /**
+    * Draws the characters missing from the font with `font`, fallback fonts
+    * are tried in the order they were added. Ignored by the shaping stage.
+    */
+    bool addFallbackFont(const std::string& font);
+
+    /**
+    * Positions glyphs at 1 / `bins` of a pixel instead of whole pixels, each
+    * character gets up to `bins` rasterized variants. 1 turns it off, fallback
+    * fonts and the shaping stage always use whole pixels.
+    */
+    void setSubpixelBins(int bins);
+
+    /**
+    * Renders the glyphs for LCD panels into an RGB888 atlas, which replaces
+    * the current one, see FontFreeType::setLCDRendering().
+    */
+    void setLCDRendering(bool enable);
+
+    FontAtlas* getFontAtlas() const { return _fontAtlas; }
+
+    /**
+    * The laid out lines behind getVertices(), valid until the text changes.
+    */
+    const TextSpaceArray& getTextSpaces() const { return _scratch.spaces; }
+
+#ifdef ENABLE_INSPECT
+    /**
+    * Writes the quads of the current layout to `<prefix>.quads` and the
+    * atlas frames to `<prefix>_frame<i>.pgm` and `<prefix>_color<i>.tga`.
+    * Layouts picked by utils::capture::sample() are written the same way.
+    */
+    bool capture(const std::string& prefix) const;
+#endif
+
 protected:
     bool updateContent();
     
@@ -41,4 +79,9 @@ private:
     LabelAlignmentV _alignV = LabelAlignmentV::CENTER;
     LabelAlignmentH _alignH = LabelAlignmentH::LEFT;
     bool        _enableKerning = true;
+    TextShaper* _shaper     = nullptr;
+    int     _subpixelBins   = 1;
+    std::unique_ptr<FontFallbackChain> _fallback;
+    std::vector<C3F_T2F_C4B> _vertices;
+    TextLayoutScratch _scratch;
 };
\ No newline at end of file
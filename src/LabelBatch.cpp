@@ -0,0 +1,152 @@
+#include "LabelBatch.h"
+
+#include "ccUTF8.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <unordered_map>
+
+LabelBatch::LabelBatch(int threads)
+{
+    if (threads <= 0)
+    {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    _threads = std::max(1, threads);
+    for (int i = 0; i < _threads; i++)
+    {
+        _scratch.emplace_back(new TextLayoutScratch());
+    }
+}
+
+LabelBatch::~LabelBatch() {}
+
+bool LabelBatch::prepare(const LabelDesc* descs, size_t count)
+{
+    if (_jobs.size() < count)
+    {
+        _jobs.resize(count);
+    }
+    _ranges.assign(count, LabelBatchRange());
+
+    // unique glyphs of each atlas
+    std::unordered_map<FontCacheEntry*, std::vector<char32_t>> glyphs;
+
+    bool ret = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& desc = descs[i];
+        auto& job = _jobs[i];
+        job.entry = _fontCache.get(desc.font, desc.fontSize, desc.outline);
+        if (!job.entry || !StringUtils::UTF8ToUTF32(desc.text, job.text))
+        {
+            job.entry = nullptr;
+            ret = false;
+            continue;
+        }
+        job.style.lineHeight = job.entry->lineHeight;
+        job.style.spaceX = desc.spaceX;
+        job.style.alignH = desc.alignH;
+        job.kerning.resize(job.text.length());
+        job.hasKerning = desc.enableKerning && job.entry->font->getHorizontalKerningForUTF32Text(job.text, job.kerning.data());
+
+        auto& list = glyphs[job.entry];
+        list.insert(list.end(), job.text.begin(), job.text.end());
+    }
+
+    for (auto& it : glyphs)
+    {
+        auto& list = it.second;
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+        for (auto ch : list)
+        {
+            if (ch == u'\r' || ch == u'\n') continue;
+            it.first->atlas->getOrLoad(ch, it.first->font.get());
+        }
+    }
+
+    // all glyphs are resident, size the shared buffer exactly
+    int vertexCount = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& job = _jobs[i];
+        auto& range = _ranges[i];
+        range.vertexOffset = vertexCount;
+        if (!job.entry) continue;
+        int quads = 0;
+        for (auto ch : job.text)
+        {
+            if (ch == u'\r' || ch == u'\n') continue;
+            auto* letterDef = job.entry->atlas->getOrLoad(ch, nullptr);
+            if (letterDef && letterDef->hasQuad()) quads++;
+        }
+        range.vertexCount = quads * 4;
+        range.atlas = job.entry->atlas.get();
+        vertexCount += range.vertexCount;
+    }
+    _vertices.resize(vertexCount);
+    return ret;
+}
+
+void LabelBatch::layoutJob(TextLayoutScratch& scratch, int idx)
+{
+    auto& job = _jobs[idx];
+    auto& range = _ranges[idx];
+    if (!job.entry) return;
+
+    scratch.reset();
+    TextLayout::layoutLines(job.text, job.hasKerning ? job.kerning.data() : nullptr,
+        job.entry->atlas.get(), nullptr, job.style, scratch.spaces);
+    TextLayout::alignLines(scratch.spaces, job.style);
+
+    int written = TextLayout::fillVertices(scratch.spaces, _vertices.data() + range.vertexOffset);
+    assert(written == range.vertexCount);
+    range.width = scratch.spaces._data.empty() ? 0 : scratch.spaces._maxWidth;
+    range.height = scratch.spaces._data.size() * job.style.lineHeight;
+    range.validate = true;
+}
+
+bool LabelBatch::layout(const LabelDesc* descs, size_t count)
+{
+    bool ret = prepare(descs, count);
+
+    const int total = static_cast<int>(count);
+    const int workers = std::min(_threads, total);
+    std::atomic<int> next(0);
+
+    auto run = [&](int threadIdx) {
+        TextLayoutScratch& scratch = *_scratch[threadIdx];
+        for (int i = next++; i < total; i = next++)
+        {
+            layoutJob(scratch, i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < workers; t++)
+    {
+        threads.emplace_back(run, t);
+    }
+    run(0);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    // one layout per atlas, however many labels used it
+    std::vector<FontAtlas*> atlases;
+    for (auto& range : _ranges)
+    {
+        if (range.atlas) atlases.push_back(range.atlas);
+    }
+    std::sort(atlases.begin(), atlases.end());
+    atlases.erase(std::unique(atlases.begin(), atlases.end()), atlases.end());
+    for (auto* atlas : atlases)
+    {
+        atlas->endLayout();
+    }
+    return ret;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "FontCache.h"
+#include "TextLayout.h"
+
+#include <string>
+#include <vector>
+
+struct LabelDesc
+{
+    std::string font;
+    std::string text;
+    float fontSize = 0;
+    float outline = 0;
+    int spaceX = 0;
+    LabelAlignmentH alignH = LabelAlignmentH::LEFT;
+    bool enableKerning = true;
+};
+
+struct LabelBatchRange
+{
+    int vertexOffset = 0;
+    int vertexCount = 0;
+    float width = 0;
+    float height = 0;
+    FontAtlas* atlas = nullptr;
+    bool validate = false;
+};
+
+/**
+* Lays out many labels in one call.
+*
+* Glyphs are collected over all labels and loaded into the shared atlases once,
+* then the labels are laid out on worker threads, each with its own scratch
+* arena, and written into one vertex buffer. Label `i` owns the vertices
+* described by getRanges()[i].
+*/
+class LabelBatch {
+public:
+    /**
+    * @param threads number of threads used for layout, 0 picks the hardware concurrency.
+    */
+    explicit LabelBatch(int threads = 0);
+    virtual ~LabelBatch();
+
+    bool layout(const LabelDesc* descs, size_t count);
+    bool layout(const std::vector<LabelDesc>& descs) { return layout(descs.data(), descs.size()); }
+
+    const std::vector<C3F_T2F_C4B>& getVertices() const { return _vertices; }
+    const std::vector<LabelBatchRange>& getRanges() const { return _ranges; }
+
+    FontCache& getFontCache() { return _fontCache; }
+
+private:
+    struct Job {
+        FontCacheEntry* entry = nullptr;
+        std::u32string text;
+        std::vector<int> kerning;
+        bool hasKerning = false;
+        TextLayoutStyle style;
+    };
+
+    bool prepare(const LabelDesc* descs, size_t count);
+    void layoutJob(TextLayoutScratch& scratch, int idx);
+
+    FontCache _fontCache;
+    std::vector<Job> _jobs;
+    std::vector<std::unique_ptr<TextLayoutScratch>> _scratch;
+    std::vector<C3F_T2F_C4B> _vertices;
+    std::vector<LabelBatchRange> _ranges;
+    int _threads = 1;
+};
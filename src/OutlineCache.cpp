@@ -0,0 +1,96 @@
+#include "OutlineCache.h"
+#include "Profiler.h"
+
+#include <cstdlib>
+
+namespace {
+
+    size_t glyphBytes(FT_Glyph glyph)
+    {
+        if (glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+        {
+            const FT_Outline& outline = reinterpret_cast<FT_OutlineGlyph>(glyph)->outline;
+            return sizeof(FT_OutlineGlyphRec) + outline.n_points * (sizeof(FT_Vector) + sizeof(char))
+                + outline.n_contours * sizeof(short);
+        }
+        if (glyph->format == FT_GLYPH_FORMAT_BITMAP)
+        {
+            const FT_Bitmap& bitmap = reinterpret_cast<FT_BitmapGlyph>(glyph)->bitmap;
+            return sizeof(FT_BitmapGlyphRec) + std::abs(bitmap.pitch) * bitmap.rows;
+        }
+        return sizeof(FT_GlyphRec);
+    }
+}
+
+OutlineCache::OutlineCache(size_t maxBytes) : _maxBytes(maxBytes)
+{
+}
+
+OutlineCache::~OutlineCache()
+{
+    clear();
+}
+
+const OutlineCache::Entry* OutlineCache::get(FT_Face face, uint32_t glyphIndex, FT_Int32 loadFlags)
+{
+    // the entry returned by the previous call may be dropped now
+    trim(_maxBytes);
+
+    const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(loadFlags)) << 32) | glyphIndex;
+    auto it = _items.find(key);
+    if (it != _items.end())
+    {
+        PROFILE_COUNT("outline.hit", 1);
+        _hits++;
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return &it->second->entry;
+    }
+
+    PROFILE_COUNT("outline.miss", 1);
+    _misses++;
+    FT_Glyph glyph = nullptr;
+    if (FT_Load_Glyph(face, glyphIndex, loadFlags) || FT_Get_Glyph(face->glyph, &glyph))
+    {
+        return nullptr;
+    }
+
+    _lru.emplace_front();
+    Item& item = _lru.front();
+    item.key = key;
+    item.entry.glyph = glyph;
+    item.entry.metrics = face->glyph->metrics;
+    item.entry.linearHoriAdvance = face->glyph->linearHoriAdvance;
+    item.entry.bytes = sizeof(Item) + glyphBytes(glyph);
+    _bytes += item.entry.bytes;
+    _items.emplace(key, _lru.begin());
+    return &item.entry;
+}
+
+void OutlineCache::setMaxBytes(size_t maxBytes)
+{
+    _maxBytes = maxBytes;
+    trim(maxBytes);
+}
+
+void OutlineCache::trim(size_t maxBytes)
+{
+    while (_bytes > maxBytes && !_lru.empty())
+    {
+        Item& item = _lru.back();
+        _bytes -= item.entry.bytes;
+        FT_Done_Glyph(item.entry.glyph);
+        _items.erase(item.key);
+        _lru.pop_back();
+    }
+}
+
+void OutlineCache::clear()
+{
+    for (auto& item : _lru)
+    {
+        FT_Done_Glyph(item.entry.glyph);
+    }
+    _lru.clear();
+    _items.clear();
+    _bytes = 0;
+}
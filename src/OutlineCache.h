@@ -0,0 +1,71 @@
+#pragma once
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_GLYPH_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+/**
+* Loaded glyphs of one face at one size, so that rendering a glyph again,
+* stroking it or moving it to a subpixel offset does not parse and hint it
+* from the font data again.
+*
+* Entries are keyed by (glyph index, load flags) and hold a copy of the
+* FT_Glyph, an outline for scalable fonts or the embedded bitmap otherwise.
+* The least recently used entries are dropped once the glyphs take more than
+* the byte budget.
+*/
+class OutlineCache {
+public:
+    struct Entry {
+        FT_Glyph glyph = nullptr;       // owned, copy it before changing it
+        FT_Glyph_Metrics metrics;       // of the loaded slot, hinted
+        FT_Fixed linearHoriAdvance = 0; // 16.16, not hinted
+        size_t bytes = 0;
+    };
+
+    explicit OutlineCache(size_t maxBytes = 256 * 1024);
+    ~OutlineCache();
+
+    OutlineCache(const OutlineCache&) = delete;
+    OutlineCache& operator=(const OutlineCache&) = delete;
+
+    /**
+    * Returns the glyph loaded with `loadFlags`, which must not render,
+    * loading it on a miss. Returns nullptr if FreeType can not load it. The
+    * entry stays valid until the next call.
+    */
+    const Entry* get(FT_Face face, uint32_t glyphIndex, FT_Int32 loadFlags);
+
+    /**
+    * The budget is enforced when get() is called, a budget of 0 keeps
+    * nothing and every get() loads the glyph.
+    */
+    void setMaxBytes(size_t maxBytes);
+    size_t getMaxBytes() const { return _maxBytes; }
+
+    size_t getBytes() const { return _bytes; }
+    size_t getCount() const { return _lru.size(); }
+    size_t getHits() const { return _hits; }
+    size_t getMisses() const { return _misses; }
+    void clear();
+
+private:
+    struct Item {
+        uint64_t key;
+        Entry entry;
+    };
+    typedef std::list<Item> ItemList;
+
+    void trim(size_t maxBytes);
+
+    size_t _maxBytes;
+    size_t _bytes = 0;
+    ItemList _lru;
+    std::unordered_map<uint64_t, ItemList::iterator> _items;
+    size_t _hits = 0;
+    size_t _misses = 0;
+};
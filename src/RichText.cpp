@@ -0,0 +1,209 @@
+#include "RichText.h"
+
+#include "ccUTF8.h"
+
+#include <cassert>
+
+bool AttributedString::append(const std::string& utf8, const TextRunStyle& style)
+{
+    std::u32string text;
+    if (!StringUtils::UTF8ToUTF32(utf8, text))
+    {
+        return false;
+    }
+    TextRun run;
+    run.start = _text.length();
+    run.length = text.length();
+    run.style = style;
+    _text.append(text);
+    _runs.push_back(run);
+    return true;
+}
+
+void AttributedString::clear()
+{
+    _text.clear();
+    _runs.clear();
+}
+
+RichLabel::RichLabel(FontCache& cache) : _fontCache(cache)
+{
+}
+
+RichLabel::~RichLabel() {}
+
+bool RichLabel::init(const AttributedString& text, LabelAlignmentH alignH)
+{
+    _text = text;
+    _alignH = alignH;
+
+    bool ret = true;
+    _runFonts.clear();
+    for (auto& run : _text.getRuns())
+    {
+        auto* entry = _fontCache.get(run.style.font, run.style.fontSize, run.style.outline);
+        ret = ret && entry;
+        _runFonts.push_back(entry);
+    }
+    return updateContent() && ret;
+}
+
+int RichLabel::batchFor(FontAtlas* atlas, int textureID, bool color)
+{
+    for (size_t i = 0; i < _batches.size(); i++)
+    {
+        if (_batches[i].atlas == atlas && _batches[i].textureID == textureID && _batches[i].color == color) return static_cast<int>(i);
+    }
+    TextDrawBatch batch;
+    batch.atlas = atlas;
+    batch.textureID = textureID;
+    batch.color = color;
+    _batches.push_back(batch);
+    return static_cast<int>(_batches.size()) - 1;
+}
+
+bool RichLabel::updateContent()
+{
+    _scratch.reset();
+    _lineHeights.clear();
+    _quadInfo.clear();
+    _batches.clear();
+
+    TextSpaceArray& spaces = _scratch.spaces;
+    const auto& text = _text.getText();
+    const auto& runs = _text.getRuns();
+
+    int cursorX = 0;
+    int lineAscender = 0;
+    char32_t prevCh = 0;
+    FontCacheEntry* prevEntry = nullptr;
+    TextSpace* space = &spaces.openSpace();
+
+    // glyphs are placed against baseline 0, then the line is moved down by its
+    // tallest ascender so that all runs share the baseline
+    auto closeLine = [&]() {
+        if (space->validate())
+        {
+            space->translate(0, lineAscender);
+            _lineHeights.push_back(lineAscender);
+        }
+        spaces.closeSpace();
+        cursorX = 0;
+        lineAscender = 0;
+        prevEntry = nullptr;
+    };
+
+    for (size_t r = 0; r < runs.size(); r++)
+    {
+        auto* entry = _runFonts[r];
+        if (!entry) continue;
+        const auto& run = runs[r];
+
+        for (size_t i = run.start; i < run.start + run.length; i++)
+        {
+            auto ch = text[i];
+
+            if (ch == u'\r')
+            {
+                cursorX = 0;
+                prevEntry = nullptr;
+                continue;
+            }
+
+            if (ch == u'\n')
+            {
+                closeLine();
+                space = &spaces.openSpace();
+                continue;
+            }
+
+            auto* letterDef = entry->atlas->getOrLoad(ch, entry->font.get());
+            if (!letterDef) continue;
+
+            if (prevEntry == entry)
+            {
+                cursorX += entry->font->getHorizontalKerningForChars(prevCh, ch);
+            }
+
+            lineAscender = std::max(lineAscender, entry->lineHeight);
+            prevCh = ch;
+            prevEntry = entry;
+            const Rect& rect = letterDef->rect;
+            space->fillRect(cursorX + rect.getLeft(), rect.getBottom(), cursorX + rect.getRight(), rect.getTop(), *letterDef);
+            if (!letterDef->hasQuad())
+            {
+                cursorX += letterDef->xAdvance;
+                continue;
+            }
+
+            QuadInfo info;
+            info.batch = batchFor(entry->atlas.get(), letterDef->textureID, letterDef->color);
+            info.color = run.style.color;
+            if (letterDef->color)
+            {
+                // only the opacity of the run applies to color glyphs
+                info.color = Vec4<uint8_t>(255, 255, 255, run.style.color.getK());
+            }
+            _quadInfo.push_back(info);
+            cursorX += letterDef->xAdvance;
+        }
+    }
+    closeLine();
+
+    // align the lines, the block is centered on the origin
+    auto& list = spaces._data;
+    float totalHeight = 0;
+    for (auto h : _lineHeights)
+    {
+        totalHeight += h;
+    }
+    float lineTop = -totalHeight / 2;
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        auto& s = list[i];
+        float x = 0;
+        if (_alignH == LabelAlignmentH::LEFT)
+        {
+            x = -spaces._maxWidth / 2 + s.getWidth() / 2.0f;
+        }
+        else if (_alignH == LabelAlignmentH::RIGHT)
+        {
+            x = spaces._maxWidth / 2 - s.getWidth() / 2.0f;
+        }
+        s.translate(x - s.center().getX(), lineTop);
+        lineTop += _lineHeights[i];
+    }
+    _width = list.empty() ? 0 : spaces._maxWidth;
+    _height = totalHeight;
+
+    // group the quads by texture
+    int offset = 0;
+    for (auto& info : _quadInfo)
+    {
+        _batches[info.batch].vertexCount += 4;
+    }
+    for (auto& batch : _batches)
+    {
+        batch.vertexOffset = offset;
+        offset += batch.vertexCount;
+        batch.vertexCount = 0;
+    }
+
+    _lineVertices.resize(spaces.quadCount() * 4);
+    TextLayout::fillVertices(spaces, _lineVertices.data());
+
+    _vertices.resize(offset);
+    for (size_t q = 0; q < _quadInfo.size(); q++)
+    {
+        auto& info = _quadInfo[q];
+        auto& batch = _batches[info.batch];
+        C3F_T2F_C4B* dst = _vertices.data() + batch.vertexOffset + batch.vertexCount;
+        for (int k = 0; k < 4; k++)
+        {
+            dst[k] = _lineVertices[q * 4 + k];
+            dst[k].color = info.color;
+        }
+        batch.vertexCount += 4;
+    }
+    return true;
+}
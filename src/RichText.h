@@ -0,0 +1,101 @@
+#pragma once
+
+#include "FontCache.h"
+#include "TextLayout.h"
+
+#include <string>
+#include <vector>
+
+struct TextRunStyle
+{
+    std::string font;
+    float fontSize = 0;
+    float outline = 0;
+    Vec4<uint8_t> color = Vec4<uint8_t>(255, 255, 255, 255);
+};
+
+struct TextRun
+{
+    size_t start = 0;   // in characters of AttributedString::getText()
+    size_t length = 0;
+    TextRunStyle style;
+};
+
+/**
+* UTF-32 text split into runs, each run carries its own font, size and color.
+*/
+class AttributedString {
+public:
+    AttributedString() = default;
+
+    bool append(const std::string& utf8, const TextRunStyle& style);
+    void clear();
+
+    const std::u32string& getText() const { return _text; }
+    const std::vector<TextRun>& getRuns() const { return _runs; }
+
+private:
+    std::u32string _text;
+    std::vector<TextRun> _runs;
+};
+
+/**
+* Vertices sharing one atlas texture, drawable with a single call. Color
+* batches sample a BGRA8888 page of the atlas, see FontAtlas::colorFrameAt(),
+* and keep the colors of the glyphs.
+*/
+struct TextDrawBatch
+{
+    FontAtlas* atlas = nullptr;
+    int textureID = -1;
+    bool color = false;
+    int vertexOffset = 0;
+    int vertexCount = 0;
+};
+
+/**
+* Label made of several runs.
+*
+* All runs are laid out in one pass, glyphs of a line share the baseline of
+* the tallest run, and the vertices are grouped into one batch per atlas
+* texture instead of one label per style. Emoji and other color glyphs get
+* batches of their own, in the order they first appear between the others.
+*/
+class RichLabel {
+public:
+    explicit RichLabel(FontCache& cache);
+    virtual ~RichLabel();
+
+    bool init(const AttributedString& text, LabelAlignmentH alignH = LabelAlignmentH::LEFT);
+
+    const std::vector<C3F_T2F_C4B>& getVertices() const { return _vertices; }
+    const std::vector<TextDrawBatch>& getBatches() const { return _batches; }
+
+    float getWidth() const { return _width; }
+    float getHeight() const { return _height; }
+
+protected:
+    bool updateContent();
+
+private:
+    struct QuadInfo {
+        int batch;
+        Vec4<uint8_t> color;
+    };
+
+    int batchFor(FontAtlas* atlas, int textureID, bool color);
+
+    FontCache& _fontCache;
+    AttributedString _text;
+    std::vector<FontCacheEntry*> _runFonts;
+    LabelAlignmentH _alignH = LabelAlignmentH::LEFT;
+    float _width = 0;
+    float _height = 0;
+
+    TextLayoutScratch _scratch;
+    std::vector<int> _lineHeights;
+    std::vector<QuadInfo> _quadInfo;
+    std::vector<C3F_T2F_C4B> _lineVertices;
+    std::vector<C3F_T2F_C4B> _vertices;
+    std::vector<TextDrawBatch> _batches;
+};
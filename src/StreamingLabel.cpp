@@ -0,0 +1,134 @@
+#include "StreamingLabel.h"
+
+#include <algorithm>
+#include <cstring>
+
+StreamingLabel::StreamingLabel(size_t chunkSize) : _chunk(chunkSize)
+{
+}
+
+StreamingLabel::~StreamingLabel() {}
+
+bool StreamingLabel::init(const std::string& font, std::unique_ptr<utils::TextSource> source, float fontSize, float outline)
+{
+    _ttfFont.reset(new FontFreeType(font, fontSize, outline));
+    if (!_ttfFont->loadFont()) return false;
+    _fontAtlas.reset(new FontAtlas(PixelMode::A8, 512, 512));
+    _fontAtlas->init();
+    _lineHeight = _ttfFont->getFontAscender();
+
+    _source = std::move(source);
+    return _source && indexLines();
+}
+
+bool StreamingLabel::indexLines()
+{
+    _lineOffsets.clear();
+    _lineOffsets.push_back(0);
+    _lineCount = 1;
+    if (!_source->seek(0)) return false;
+
+    // a line break never appears inside a multi-byte sequence, the bytes are
+    // scanned without decoding
+    uint64_t offset = 0;
+    size_t got;
+    while ((got = _source->read(_chunk.data(), _chunk.size())) > 0)
+    {
+        const char* begin = _chunk.data();
+        const char* end = begin + got;
+        for (const char* p = begin; (p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr; p++)
+        {
+            if (_lineCount % LINE_INDEX_STRIDE == 0)
+            {
+                _lineOffsets.push_back(offset + (p - begin) + 1);
+            }
+            _lineCount++;
+        }
+        offset += got;
+    }
+    return true;
+}
+
+void StreamingLabel::layoutLine(size_t windowLine)
+{
+    if (!_line.empty() && _line.back() == u'\r')
+    {
+        _line.pop_back();
+    }
+
+    TextLayoutStyle style;
+    style.lineHeight = _lineHeight;
+    style.spaceX = _spaceX;
+
+    const int* kerning = nullptr;
+    if (_enableKerning)
+    {
+        _scratch.kerning.resize(_line.length());
+        if (_ttfFont->getHorizontalKerningForUTF32Text(_line, _scratch.kerning.data()))
+        {
+            kerning = _scratch.kerning.data();
+        }
+    }
+
+    TextSpaceArray& spaces = _scratch.spaces;
+    const size_t before = spaces._data.size();
+    TextLayout::layoutLines(_line, kerning, _fontAtlas.get(), _ttfFont.get(), style, spaces);
+    if (spaces._data.size() > before)
+    {
+        spaces._data.back().translate(0, static_cast<float>(windowLine * _lineHeight));
+    }
+}
+
+bool StreamingLabel::setWindow(size_t firstLine, size_t lineCount)
+{
+    _scratch.reset();
+    _vertices.clear();
+    _firstLine = std::min(firstLine, _lineCount);
+    const size_t lastLine = std::min(_lineCount, _firstLine + std::min(lineCount, _lineCount));
+    if (_firstLine == lastLine) return true;
+
+    const size_t indexed = _firstLine / LINE_INDEX_STRIDE;
+    if (!_source->seek(_lineOffsets[indexed])) return false;
+    size_t line = indexed * LINE_INDEX_STRIDE;
+
+    _decoder.reset();
+    _line.clear();
+
+    size_t got;
+    while (line < lastLine && (got = _source->read(_chunk.data(), _chunk.size())) > 0)
+    {
+        const char* p = _chunk.data();
+        const char* end = p + got;
+        while (p < end && line < lastLine)
+        {
+            const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+            const char* stop = lineEnd ? lineEnd : end;
+
+            // lines in front of the window are skipped without decoding
+            if (line >= _firstLine && !_decoder.decode(p, stop - p, _line)) return false;
+            if (!lineEnd) break;
+
+            if (line >= _firstLine)
+            {
+                if (!_decoder.finish()) return false;
+                layoutLine(line - _firstLine);
+                _line.clear();
+            }
+            line++;
+            p = lineEnd + 1;
+        }
+    }
+
+    // the last line of the document has no line break
+    if (line < lastLine)
+    {
+        if (!_decoder.finish()) return false;
+        layoutLine(line - _firstLine);
+    }
+
+    TextSpaceArray& spaces = _scratch.spaces;
+    _vertices.resize(spaces.quadCount() * 4);
+    TextLayout::fillVertices(spaces, _vertices.data());
+    _fontAtlas->endLayout();
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "FontAtlas.h"
+#include "FontFreetype.h"
+#include "TextLayout.h"
+#include "TextSource.h"
+#include "ccUTF8.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+* Label for texts too large to be laid out at once, such as logs or licenses.
+*
+* init() scans the source once and keeps the byte offset of every
+* LINE_INDEX_STRIDE-th line. setWindow() seeks to the closest indexed line,
+* decodes the text chunk by chunk and lays out the requested lines only, so
+* memory depends on the window and the longest line, not on the document.
+*
+* Lines are left aligned at x = 0, line k of the window is moved by
+* k * line height on y, the window starts at getWindowOffsetY() in the document.
+*/
+class StreamingLabel {
+public:
+    static const size_t LINE_INDEX_STRIDE = 64;
+
+    explicit StreamingLabel(size_t chunkSize = 64 * 1024);
+    virtual ~StreamingLabel();
+
+    bool init(const std::string& font, std::unique_ptr<utils::TextSource> source, float fontSize, float outline);
+
+    /**
+    * Lays out lines [firstLine, firstLine + lineCount), clamped to the
+    * document. Returns false if the source can not be read or the text is not
+    * valid UTF8.
+    */
+    bool setWindow(size_t firstLine, size_t lineCount);
+
+    size_t getLineCount() const { return _lineCount; }
+    int getLineHeight() const { return _lineHeight; }
+    size_t getFirstLine() const { return _firstLine; }
+    double getWindowOffsetY() const { return static_cast<double>(_firstLine) * _lineHeight; }
+    float getWindowWidth() const { return _scratch.spaces._maxWidth; }
+
+    const std::vector<C3F_T2F_C4B>& getVertices() const { return _vertices; }
+
+private:
+    bool indexLines();
+    void layoutLine(size_t windowLine);
+
+    std::unique_ptr<utils::TextSource> _source;
+    std::unique_ptr<FontFreeType> _ttfFont;
+    std::unique_ptr<FontAtlas> _fontAtlas;
+    int _lineHeight = 0;
+    int _spaceX = 0;
+    bool _enableKerning = true;
+
+    size_t _lineCount = 0;
+    std::vector<uint64_t> _lineOffsets; // of lines 0, LINE_INDEX_STRIDE, 2 * LINE_INDEX_STRIDE...
+    size_t _firstLine = 0;
+
+    std::vector<char> _chunk;
+    StringUtils::UTF8StreamDecoder _decoder;
+    std::u32string _line;
+    TextLayoutScratch _scratch;
+    std::vector<C3F_T2F_C4B> _vertices;
+};
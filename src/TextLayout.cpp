@@ -0,0 +1,283 @@
+#include "TextLayout.h"
+#include "Capture.h"
+#include "FontFallbackChain.h"
+#include "TextShaper.h"
+
+#include <cassert>
+
+void TextSpace::reset()
+{
+    _left = FLT_MAX;
+    _bottom = FLT_MAX;
+    _right = -FLT_MAX;
+    _top = -FLT_MAX;
+    _quads.clear();
+}
+
+void TextSpace::fillRect(float left, float bottom, float right, float top, const FontLetterDefinition& def)
+{
+    // blank glyphs still count for the bounds, leading spaces indent the line
+    _left = std::min(_left, left);
+    _right = std::max(_right, right);
+    _bottom = std::min(_bottom, bottom);
+    _top = std::max(_top, top);
+    if (!def.hasQuad())
+    {
+        return;
+    }
+    _quads.push(left, bottom, right, top, def.texX, def.texY, def.texX + def.texWidth, def.texY + def.texHeight,
+        def.color ? def.textureID | GlyphQuads::COLOR_PAGE : def.textureID);
+}
+
+void TextSpace::translate(float x, float y)
+{
+    const size_t n = _quads.size();
+    GlyphQuadKernels::scaleTranslate(_quads.x0.data(), n, 1.0f, x);
+    GlyphQuadKernels::scaleTranslate(_quads.x1.data(), n, 1.0f, x);
+    GlyphQuadKernels::scaleTranslate(_quads.y0.data(), n, 1.0f, y);
+    GlyphQuadKernels::scaleTranslate(_quads.y1.data(), n, 1.0f, y);
+    _left += x;
+    _right += x;
+    _bottom += y;
+    _top += y;
+}
+
+Vec2<float> TextSpace::center() const
+{
+    Vec2<float> ret((_left + _right) / 2.0f, (_bottom + _top) / 2.0f);
+    return ret;
+}
+
+int TextSpace::fillVertices(C3F_T2F_C4B* out, float scale) const
+{
+    const Vec4<uint8_t> white(255, 255, 255, 255);
+    GlyphQuadKernels::expand(_quads, 0.0f, 0.0f, scale, white, out);
+    return quadCount() * 4;
+}
+
+int TextSpaceArray::quadCount() const
+{
+    int count = 0;
+    for (auto& s : _data)
+    {
+        count += s.quadCount();
+    }
+    return count;
+}
+
+namespace {
+
+    template<typename GetLetter>
+    void layoutLinesWith(const std::u32string& text, const int* kerning,
+        const TextLayoutStyle& style, TextSpaceArray& spaces, GetLetter getLetter)
+    {
+        const FontLetterDefinition* letterDef;
+
+        int cursorX = 0;
+        int cursorY = style.lineHeight;
+
+        TextSpace* space = &spaces.openSpace();
+
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            auto ch = text[i];
+
+            if (ch == u'\r')
+            {
+                cursorX = 0;
+                continue;
+            }
+
+            if (ch == u'\n')
+            {
+                cursorX = 0;
+                spaces.closeSpace();
+                space = &spaces.openSpace();
+                continue;
+            }
+
+            letterDef = getLetter(ch);
+            if (!letterDef) continue;
+
+            if (kerning) {
+                cursorX += kerning[i];
+            }
+
+            const Rect& rect = letterDef->rect;
+            int left = cursorX + rect.getLeft();
+            int right = cursorX + rect.getRight();
+            int bottom = cursorY + rect.getBottom();
+            int top = cursorY + rect.getTop();
+
+            space->fillRect(left, bottom, right, top, *letterDef);
+
+            cursorX += style.spaceX + letterDef->xAdvance;
+        }
+
+        spaces.closeSpace();
+    }
+}
+
+namespace TextLayout {
+
+    void layoutLines(const std::u32string& text, const int* kerning,
+        FontAtlas* atlas, FontFreeType* font, const TextLayoutStyle& style, TextSpaceArray& spaces)
+    {
+        layoutLinesWith(text, kerning, style, spaces, [&](char32_t ch) { return atlas->getOrLoad(ch, font); });
+    }
+
+    void layoutFallbackLines(const std::u32string& text, const int* kerning,
+        FontAtlas* atlas, FontFallbackChain* fonts, const TextLayoutStyle& style, TextSpaceArray& spaces)
+    {
+        layoutLinesWith(text, kerning, style, spaces, [&](char32_t ch) { return fonts->getOrLoad(ch, atlas); });
+    }
+
+    void layoutSubpixelLines(const std::u32string& text, const int* kerning,
+        FontAtlas* atlas, FontFreeType* font, const TextLayoutStyle& style, TextSpaceArray& spaces)
+    {
+        const int bins = std::max(1, std::min(style.subpixelBins, 64));
+        const int cursorY = style.lineHeight;
+        int pen = 0; // 26.6
+
+        TextSpace* space = &spaces.openSpace();
+
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            auto ch = text[i];
+
+            if (ch == u'\r')
+            {
+                pen = 0;
+                continue;
+            }
+
+            if (ch == u'\n')
+            {
+                pen = 0;
+                spaces.closeSpace();
+                space = &spaces.openSpace();
+                continue;
+            }
+
+            if (kerning) {
+                pen += kerning[i];
+            }
+
+            int x = pen >> 6;
+            int bin = ((pen & 63) * bins + 32) >> 6;
+            if (bin == bins)
+            {
+                x++;
+                bin = 0;
+            }
+
+            auto* letterDef = atlas->getOrLoadSubpixel(ch, bin * 64 / bins, font);
+            if (!letterDef) continue;
+
+            const Rect& rect = letterDef->rect;
+            space->fillRect(x + rect.getLeft(), cursorY + rect.getBottom(), x + rect.getRight(), cursorY + rect.getTop(), *letterDef);
+
+            pen += style.spaceX * 64 + letterDef->xAdvance64;
+        }
+
+        spaces.closeSpace();
+    }
+
+    void layoutShapedLines(const std::u32string& text, TextShaper* shaper,
+        FontAtlas* atlas, FontFreeType* font, const TextLayoutStyle& style, TextSpaceArray& spaces)
+    {
+        const int cursorY = style.lineHeight;
+        size_t lineStart = 0;
+
+        while (lineStart <= text.size())
+        {
+            size_t lineEnd = text.find(u'\n', lineStart);
+            if (lineEnd == std::u32string::npos) lineEnd = text.size();
+            size_t length = lineEnd - lineStart;
+            if (length > 0 && text[lineEnd - 1] == u'\r') length--;
+
+            TextSpace& space = spaces.openSpace();
+            int cursorX = 0;
+            for (auto* run : shaper->shapeLine(font, text, lineStart, length))
+            {
+                for (auto& glyph : run->glyphs)
+                {
+                    auto* letterDef = atlas->getOrLoadGlyph(glyph.glyphIndex, font);
+                    if (letterDef)
+                    {
+                        const Rect& rect = letterDef->rect;
+                        const int x = cursorX + glyph.xOffset;
+                        const int y = cursorY - glyph.yOffset;
+                        space.fillRect(x + rect.getLeft(), y + rect.getBottom(), x + rect.getRight(), y + rect.getTop(), *letterDef);
+                    }
+                    cursorX += style.spaceX + glyph.xAdvance;
+                }
+            }
+            spaces.closeSpace();
+            lineStart = lineEnd + 1;
+        }
+    }
+
+    void alignLines(TextSpaceArray& spaces, const TextLayoutStyle& style)
+    {
+        const float lineHeight = style.lineHeight;
+        const float max_width = spaces._maxWidth;
+        const float max_height = spaces._data.size() * lineHeight;
+        auto& list = spaces._data;
+
+        Vec2<float> K;
+        Vec2<float> M;
+
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            auto& s = list[i];
+            const float y = -max_height / 2 + i * lineHeight + lineHeight / 2.0f;
+            if (style.alignH == LabelAlignmentH::CENTER)
+            {
+                K.set(0, y);
+            }
+            else if (style.alignH == LabelAlignmentH::LEFT)
+            {
+                K.set(-max_width / 2 + s.getWidth() / 2.0f, y);
+            }
+            else
+            {
+                K.set(max_width / 2 - s.getWidth() / 2.0f, y);
+            }
+            M = K - s.center();
+            s.translate(M.getX(), M.getY());
+        }
+    }
+
+    int fillVertices(const TextSpaceArray& spaces, C3F_T2F_C4B* out, float scale)
+    {
+        int count = 0;
+        for (auto& s : spaces._data)
+        {
+            count += s.fillVertices(out + count, scale);
+        }
+        return count;
+    }
+
+#ifdef ENABLE_INSPECT
+    bool captureQuads(const TextSpaceArray& spaces, const std::string& path)
+    {
+        std::vector<utils::capture::QuadRecord> records;
+        records.reserve(spaces.quadCount());
+        for (size_t line = 0; line < spaces._data.size(); line++)
+        {
+            const GlyphQuads& q = spaces._data[line].getQuads();
+            for (size_t i = 0; i < q.size(); i++)
+            {
+                utils::capture::QuadRecord r;
+                r.x0 = q.x0[i]; r.y0 = q.y0[i]; r.x1 = q.x1[i]; r.y1 = q.y1[i];
+                r.u0 = q.u0[i]; r.v0 = q.v0[i]; r.u1 = q.u1[i]; r.v1 = q.v1[i];
+                r.page = q.page[i];
+                r.line = static_cast<int32_t>(line);
+                records.push_back(r);
+            }
+        }
+        return utils::capture::writeQuads(path, records, static_cast<uint32_t>(spaces._data.size()));
+    }
+#endif
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "FontAtlas.h"
+#include "Arena.h"
+#include "GlyphQuads.h"
+
+#include <cfloat>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class FontFallbackChain;
+class TextShaper;
+
+enum class LabelAlignmentH
+{
+    LEFT, CENTER, RIGHT
+};
+enum class LabelAlignmentV {
+    TOP, CENTER, BOTTOM
+};
+
+struct C3F_T2F_C4B {
+    Vec3<float> vertex;
+    Vec2<float> texCoord;
+    Vec4<uint8_t> color;
+};
+
+class TextSpace {
+    /**
+    *   Y
+    *   ^
+    *   |
+    *   |
+    *   +------> X
+    */
+public:
+    explicit TextSpace(utils::MonotonicArena& arena) : _quads(arena) {}
+    explicit TextSpace(const utils::ArenaAllocator<TextSpace>& alloc) : _quads(alloc.arena()) {}
+
+    /**
+    * Adds the quad of a glyph, blank glyphs only extend the bounds.
+    */
+    void fillRect(float left, float bottom, float right, float top, const FontLetterDefinition& def);
+    void reset();
+
+    inline bool validate() const { return _left <= _right; }
+
+    /**
+    * Moves all quads by (x, y).
+    */
+    void translate(float x, float y);
+
+    Vec2<float> center() const;
+
+    float getWidth() const { return  validate() ? _right - _left : 0; }
+    float getHeight() const { return validate() ? _top - _bottom : 0; }
+
+    int quadCount() const { return static_cast<int>(_quads.size()); }
+
+    const GlyphQuads& getQuads() const { return _quads; }
+
+    /**
+    * Writes 4 vertices per glyph (left-bottom, right-bottom, left-top, right-top)
+    * with positions multiplied by `scale`, returns the number of vertices written.
+    */
+    int fillVertices(C3F_T2F_C4B* out, float scale = 1.0f) const;
+private:
+    float _left   = FLT_MAX;
+    float _bottom = FLT_MAX;
+    float _right  = -FLT_MAX;
+    float _top    = -FLT_MAX;
+    GlyphQuads _quads;
+};
+
+struct TextSpaceArray {
+
+    explicit TextSpaceArray(utils::MonotonicArena& arena) : _data(arena) {}
+
+    /**
+    * Starts a new line, the space is built in place and dropped again by
+    * closeSpace() if it stays empty.
+    */
+    TextSpace& openSpace()
+    {
+        _data.emplace_back(_data.get_allocator());
+        return _data.back();
+    }
+
+    void closeSpace()
+    {
+        if (_data.back().validate())
+        {
+            _maxWidth = std::max(_maxWidth, _data.back().getWidth());
+        }
+        else
+        {
+            _data.pop_back();
+        }
+    }
+
+    /**
+    * Drops all spaces and gives their storage back, must be called before the
+    * arena is reset.
+    */
+    void reset()
+    {
+        _maxWidth = 0;
+        utils::ArenaVector<TextSpace>(_data.get_allocator()).swap(_data);
+    }
+
+    int quadCount() const;
+
+    float _maxWidth = 0;
+    utils::ArenaVector<TextSpace> _data;
+};
+
+/**
+* Temporary containers of one layout, all backed by one arena which is
+* rewound by reset(). Keep one per thread and reuse it across layouts.
+*/
+struct TextLayoutScratch {
+    TextLayoutScratch() : spaces(arena), kerning(arena) {}
+
+    void reset()
+    {
+        spaces.reset();
+        utils::ArenaVector<int>(arena).swap(kerning);
+        arena.reset();
+    }
+
+    utils::MonotonicArena arena;
+    TextSpaceArray spaces;
+    utils::ArenaVector<int> kerning;
+};
+
+struct TextLayoutStyle {
+    int lineHeight = 0;
+    int spaceX = 0;
+    LabelAlignmentH alignH = LabelAlignmentH::LEFT;
+    // glyph positions per pixel used by layoutSubpixelLines
+    int subpixelBins = 4;
+};
+
+namespace TextLayout {
+
+    /**
+    * Breaks `text` into lines and places every glyph found in `atlas`.
+    * `kerning` holds one offset per character, or is null.
+    * Missing glyphs are rasterized through `font`; pass a null `font` to only
+    * read from the atlas, which is safe from several threads once the atlas
+    * has been filled.
+    */
+    void layoutLines(const std::u32string& text, const int* kerning,
+        FontAtlas* atlas, FontFreeType* font, const TextLayoutStyle& style, TextSpaceArray& out);
+
+    /**
+    * Same as layoutLines, but the pen advances in 26.6 fixed point and every
+    * glyph is drawn from the variant rasterized at its fractional position,
+    * rounded to one of style.subpixelBins offsets. `kerning` is in 26.6 too,
+    * see FontFreeType::getHorizontalKerningForUTF32Text64().
+    */
+    void layoutSubpixelLines(const std::u32string& text, const int* kerning,
+        FontAtlas* atlas, FontFreeType* font, const TextLayoutStyle& style, TextSpaceArray& out);
+
+    /**
+    * Same as layoutLines, every character is drawn with the first font of
+    * `fonts` which has it.
+    */
+    void layoutFallbackLines(const std::u32string& text, const int* kerning,
+        FontAtlas* atlas, FontFallbackChain* fonts, const TextLayoutStyle& style, TextSpaceArray& out);
+
+    /**
+    * Same as layoutLines, but every line goes through `shaper` first and the
+    * glyphs are looked up in the atlas by glyph index.
+    */
+    void layoutShapedLines(const std::u32string& text, TextShaper* shaper,
+        FontAtlas* atlas, FontFreeType* font, const TextLayoutStyle& style, TextSpaceArray& out);
+
+    /**
+    * Translates each line of `spaces` according to the horizontal alignment,
+    * the block is centered on the origin.
+    */
+    void alignLines(TextSpaceArray& spaces, const TextLayoutStyle& style);
+
+    /**
+    * Writes the vertices of all lines, `out` must hold 4 * spaces.quadCount() items.
+    */
+    int fillVertices(const TextSpaceArray& spaces, C3F_T2F_C4B* out, float scale = 1.0f);
+
+#ifdef ENABLE_INSPECT
+    /**
+    * Writes the quads of all lines as a utils::capture quad list.
+    */
+    bool captureQuads(const TextSpaceArray& spaces, const std::string& path);
+#endif
+}
@@ -0,0 +1,151 @@
+#include "TextRasterizer.h"
+
+#include "BitmapKernels.h"
+#include "FontAtlas.h"
+#include "Label.h"
+#include "Profiler.h"
+#include "TextLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+    inline int roundToInt(float v)
+    {
+        return static_cast<int>(std::floor(v + 0.5f));
+    }
+}
+
+TextRasterizer::TextRasterizer(int threads)
+{
+    if (threads <= 0)
+    {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    _threads = std::max(1, threads);
+}
+
+bool TextRasterizer::draw(const Label& label, const Vec4<uint8_t>& color, BGRAImage& image, float x, float y) const
+{
+    return draw(label.getTextSpaces(), label.getFontAtlas(), color, image, x, y);
+}
+
+bool TextRasterizer::draw(const TextSpaceArray& spaces, FontAtlas* atlas, const Vec4<uint8_t>& color, BGRAImage& image, float x, float y) const
+{
+    PROFILE_SCOPE("rasterizer.draw");
+    if (!atlas || !image.pixels || image.width <= 0 || image.height <= 0)
+    {
+        return false;
+    }
+
+    // glyph rectangles clipped to the image columns, rows are clipped per band
+    std::vector<Blit> blits;
+    for (auto& space : spaces._data)
+    {
+        const GlyphQuads& q = space.getQuads();
+        for (size_t i = 0; i < q.size(); i++)
+        {
+            const bool colorPage = (q.page[i] & GlyphQuads::COLOR_PAGE) != 0;
+            const int page = q.page[i] & ~GlyphQuads::COLOR_PAGE;
+            const FontAtlasFrame* resident = colorPage ? &atlas->colorFrameAt(page) : atlas->frameAt(page);
+            if (!resident)
+            {
+                return false;
+            }
+            const FontAtlasFrame& frame = *resident;
+            const PixelMode mode = frame.getPixelMode();
+            if (mode != PixelMode::A8 && mode != PixelMode::A4 && mode != PixelMode::BGRA8888)
+            {
+                return false;
+            }
+
+            const int srcX = roundToInt(q.u0[i] * frame.getWidth());
+            const int srcY = roundToInt(q.v0[i] * frame.getHeight());
+            Blit blit;
+            blit.srcStride = PixelModeRowBytes(mode, frame.getWidth());
+            blit.x = roundToInt(x + q.x0[i]);
+            blit.y = roundToInt(y + q.y0[i]);
+            blit.width = roundToInt(q.u1[i] * frame.getWidth()) - srcX;
+            blit.height = roundToInt(q.v1[i] * frame.getHeight()) - srcY;
+            blit.mode = mode;
+
+            const int left = std::max(0, blit.x);
+            const int right = std::min(image.width, blit.x + blit.width);
+            if (left >= right || blit.height <= 0 || blit.y >= image.height || blit.y + blit.height <= 0) continue;
+            const int first = srcX + left - blit.x;
+            blit.src = frame.getData() + srcY * blit.srcStride + (mode == PixelMode::A4 ? first / 2 : first * PixelModeSize(mode));
+            blit.shift = mode == PixelMode::A4 ? first % 2 : 0;
+            blit.width = right - left;
+            blit.x = left;
+            blits.push_back(blit);
+        }
+    }
+
+    const uint8_t bgra[4] = { color.getZ(), color.getY(), color.getX(), color.getK() };
+    const int bands = std::min(_threads, image.height);
+    const int rows = (image.height + bands - 1) / bands;
+
+    std::vector<std::thread> threads;
+    for (int b = 1; b < bands; b++)
+    {
+        threads.emplace_back([&, b]() {
+            drawBand(blits, bgra, image, b * rows, std::min(image.height, (b + 1) * rows));
+        });
+    }
+    drawBand(blits, bgra, image, 0, std::min(image.height, rows));
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    return true;
+}
+
+void TextRasterizer::drawBand(const std::vector<Blit>& blits, const uint8_t bgra[4], BGRAImage& image, int top, int bottom) const
+{
+    std::vector<uint8_t> coverage;  // A4 rows expanded to A8
+    for (auto& blit : blits)
+    {
+        const int first = std::max(top, blit.y);
+        const int last = std::min(bottom, blit.y + blit.height);
+        for (int row = first; row < last; row++)
+        {
+            uint8_t* dst = image.pixels + row * image.stride + blit.x * 4;
+            const uint8_t* src = blit.src + (row - blit.y) * blit.srcStride;
+            if (blit.mode == PixelMode::A4)
+            {
+                coverage.resize(blit.width + 1);
+                if (_simd)
+                {
+                    BitmapKernels::unpackA4(src, blit.width + blit.shift, coverage.data());
+                }
+                else
+                {
+                    BitmapKernels::unpackA4Scalar(src, blit.width + blit.shift, coverage.data());
+                }
+                src = coverage.data() + blit.shift;
+            }
+
+            if (blit.mode == PixelMode::BGRA8888)
+            {
+                if (_simd)
+                {
+                    BitmapKernels::blendBGRA(dst, src, blit.width, bgra[3]);
+                }
+                else
+                {
+                    BitmapKernels::blendBGRAScalar(dst, src, blit.width, bgra[3]);
+                }
+            }
+            else if (_simd)
+            {
+                BitmapKernels::blendMaskBGRA(dst, src, blit.width, bgra);
+            }
+            else
+            {
+                BitmapKernels::blendMaskBGRAScalar(dst, src, blit.width, bgra);
+            }
+        }
+    }
+}
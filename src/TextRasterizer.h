@@ -0,0 +1,72 @@
+#pragma once
+
+#include "defs.h"
+
+#include <cstdint>
+#include <vector>
+
+class FontAtlas;
+class Label;
+struct TextSpaceArray;
+
+/**
+* Premultiplied BGRA8888 pixels drawn by TextRasterizer, rows are `stride`
+* bytes apart. The memory is owned by the caller.
+*/
+struct BGRAImage
+{
+    uint8_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+};
+
+/**
+* Draws laid out text into an image on the CPU.
+*
+* Every glyph is copied 1:1 from its atlas page, coverage of A8 and A4
+* pages is tinted with the text color and composited row by row, color
+* pages keep their colors. The image is split into horizontal bands drawn on worker
+* threads, glyphs overlap in the same order in every band so the result
+* does not depend on the number of threads.
+*/
+class TextRasterizer {
+public:
+    /**
+    * @param threads number of bands drawn in parallel, 0 picks the hardware concurrency.
+    */
+    explicit TextRasterizer(int threads = 1);
+
+    /**
+    * Composites the glyphs of `spaces`, laid out against `atlas`, over
+    * `image` with the layout origin, the center of the text block, at
+    * (x, y). `color` is RGBA with straight alpha, color glyphs are only
+    * faded by its alpha. Returns false for RGB888 (LCD) atlases.
+    */
+    bool draw(const TextSpaceArray& spaces, FontAtlas* atlas, const Vec4<uint8_t>& color, BGRAImage& image, float x, float y) const;
+    bool draw(const Label& label, const Vec4<uint8_t>& color, BGRAImage& image, float x, float y) const;
+
+    /**
+    * Blends with the scalar reference kernels instead of SIMD when false.
+    */
+    void setSIMD(bool enable) { _simd = enable; }
+
+    int getThreads() const { return _threads; }
+
+private:
+    struct Blit {
+        const uint8_t* src;
+        int srcStride;
+        int x;
+        int y;
+        int width;
+        int height;
+        int shift;          // A4 pages: the first pixel is the high nibble of src[0]
+        PixelMode mode;
+    };
+
+    void drawBand(const std::vector<Blit>& blits, const uint8_t bgra[4], BGRAImage& image, int top, int bottom) const;
+
+    int _threads = 1;
+    bool _simd = true;
+};
@@ -0,0 +1,365 @@
+#include "TextShaper.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef USE_HARFBUZZ
+#include <hb.h>
+#include <hb-ft.h>
+#endif
+
+namespace {
+
+    inline bool inRange(char32_t ch, char32_t a, char32_t b)
+    {
+        return ch >= a && ch <= b;
+    }
+
+    // the bidi classes of UAX #9 the line resolution tells apart
+    enum BidiClass : uint8_t {
+        BIDI_L,
+        BIDI_R,
+        BIDI_EN,    // european number
+        BIDI_AN,    // arabic number
+        BIDI_ES,    // number separator, + -
+        BIDI_CS,    // common separator, , . : /
+        BIDI_ET,    // number terminator, # $ % and currency signs
+        BIDI_N,
+    };
+
+    BidiClass bidiClassOf(char32_t ch, TextScript script)
+    {
+        if (script != TextScript::COMMON)
+        {
+            return TextShaper::isRTLScript(script) ? BIDI_R : BIDI_L;
+        }
+        if (inRange(ch, '0', '9') || inRange(ch, 0x06F0, 0x06F9) || inRange(ch, 0xFF10, 0xFF19)) return BIDI_EN;
+        if (inRange(ch, 0x0660, 0x0669) || ch == 0x066B || ch == 0x066C) return BIDI_AN;
+        if (ch == '+' || ch == '-') return BIDI_ES;
+        if (ch == ',' || ch == '.' || ch == ':' || ch == '/' || ch == 0x00A0) return BIDI_CS;
+        if (ch == '#' || ch == '$' || ch == '%' || inRange(ch, 0x00A2, 0x00A5) || ch == 0x00B0 || ch == 0x066A
+            || inRange(ch, 0x20A0, 0x20CF)) return BIDI_ET;
+        return BIDI_N;
+    }
+
+    // numbers count as R when neutrals are resolved
+    inline bool isStrongOrNumber(uint8_t c)
+    {
+        return c == BIDI_L || c == BIDI_R || c == BIDI_EN || c == BIDI_AN;
+    }
+
+#ifdef USE_HARFBUZZ
+    hb_script_t toHBScript(TextScript script)
+    {
+        switch (script)
+        {
+        case TextScript::LATIN: return HB_SCRIPT_LATIN;
+        case TextScript::GREEK: return HB_SCRIPT_GREEK;
+        case TextScript::CYRILLIC: return HB_SCRIPT_CYRILLIC;
+        case TextScript::HEBREW: return HB_SCRIPT_HEBREW;
+        case TextScript::ARABIC: return HB_SCRIPT_ARABIC;
+        case TextScript::DEVANAGARI: return HB_SCRIPT_DEVANAGARI;
+        case TextScript::BENGALI: return HB_SCRIPT_BENGALI;
+        case TextScript::THAI: return HB_SCRIPT_THAI;
+        case TextScript::HANGUL: return HB_SCRIPT_HANGUL;
+        case TextScript::HAN: return HB_SCRIPT_HAN;
+        default: return HB_SCRIPT_COMMON;
+        }
+    }
+#endif
+}
+
+TextShaper::TextShaper(size_t cacheCapacity) : _capacity(cacheCapacity)
+{
+#ifdef USE_HARFBUZZ
+    _hbBuffer = hb_buffer_create();
+#endif
+}
+
+TextShaper::~TextShaper()
+{
+#ifdef USE_HARFBUZZ
+    for (auto& it : _hbFonts)
+    {
+        hb_font_destroy(static_cast<hb_font_t*>(it.second));
+    }
+    hb_buffer_destroy(static_cast<hb_buffer_t*>(_hbBuffer));
+#endif
+}
+
+TextScript TextShaper::scriptOf(char32_t ch)
+{
+    if (ch < 0x80)
+    {
+        return inRange(ch, 'A', 'Z') || inRange(ch, 'a', 'z') ? TextScript::LATIN : TextScript::COMMON;
+    }
+    if ((inRange(ch, 0x00C0, 0x024F) && ch != 0x00D7 && ch != 0x00F7) || inRange(ch, 0x1E00, 0x1EFF)) return TextScript::LATIN;
+    if (inRange(ch, 0x0370, 0x03FF) || inRange(ch, 0x1F00, 0x1FFF)) return TextScript::GREEK;
+    if (inRange(ch, 0x0400, 0x052F)) return TextScript::CYRILLIC;
+    if (inRange(ch, 0x0591, 0x05FF) || inRange(ch, 0xFB1D, 0xFB4F)) return TextScript::HEBREW;
+    if (inRange(ch, 0x0600, 0x06FF) || inRange(ch, 0x0750, 0x077F) || inRange(ch, 0x08A0, 0x08FF)
+        || inRange(ch, 0xFB50, 0xFDFF) || inRange(ch, 0xFE70, 0xFEFF)) return TextScript::ARABIC;
+    if (inRange(ch, 0x0900, 0x097F)) return TextScript::DEVANAGARI;
+    if (inRange(ch, 0x0980, 0x09FF)) return TextScript::BENGALI;
+    if (inRange(ch, 0x0E00, 0x0E7F)) return TextScript::THAI;
+    if (inRange(ch, 0x1100, 0x11FF) || inRange(ch, 0x3130, 0x318F) || inRange(ch, 0xAC00, 0xD7AF)) return TextScript::HANGUL;
+    if (inRange(ch, 0x2E80, 0x2FDF) || inRange(ch, 0x3040, 0x30FF) || inRange(ch, 0x3400, 0x4DBF)
+        || inRange(ch, 0x4E00, 0x9FFF) || inRange(ch, 0xF900, 0xFAFF) || inRange(ch, 0x20000, 0x2FFFF)) return TextScript::HAN;
+    // punctuation, digits, symbols and combining marks take the script of their neighbours
+    return TextScript::COMMON;
+}
+
+bool TextShaper::isRTLScript(TextScript script)
+{
+    return script == TextScript::HEBREW || script == TextScript::ARABIC;
+}
+
+size_t TextShaper::RunKeyHash::operator()(const RunKey& k) const
+{
+    size_t h = std::hash<std::u32string>()(k.text);
+    h ^= std::hash<std::string>()(k.font) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= (static_cast<size_t>(k.script) << 1 | static_cast<size_t>(k.direction)) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+}
+
+void TextShaper::clearCache()
+{
+    _cache.clear();
+    _lru.clear();
+    _line.clear();
+}
+
+const std::vector<const ShapedRun*>& TextShaper::shapeLine(FontFreeType* font, const std::u32string& text, size_t start, size_t length)
+{
+    // runs handed out by the previous call may be evicted now
+    while (_lru.size() > _capacity)
+    {
+        _cache.erase(_lru.back().key);
+        _lru.pop_back();
+    }
+
+    _line.clear();
+    _levels.clear();
+    if (length == 0) return _line;
+    _font = font->getIdentity();
+
+    const char32_t* p = text.data() + start;
+    _scripts.resize(length);
+    _classes.resize(length);
+    _charLevels.resize(length);
+
+    TextDirection paragraph = TextDirection::LTR;
+    bool foundStrong = false;
+    for (size_t i = 0; i < length; i++)
+    {
+        _scripts[i] = scriptOf(p[i]);
+        _classes[i] = bidiClassOf(p[i], _scripts[i]);
+        if (!foundStrong && _scripts[i] != TextScript::COMMON)
+        {
+            paragraph = isRTLScript(_scripts[i]) ? TextDirection::RTL : TextDirection::LTR;
+            foundStrong = true;
+        }
+    }
+    const uint8_t sos = paragraph == TextDirection::RTL ? BIDI_R : BIDI_L;
+
+    // weak types, a simplified pass of the W rules: a single separator
+    // between two numbers (W4) and terminators next to european numbers (W5)
+    // join the number, other separators are neutral (W6)
+    for (size_t i = 1; i + 1 < length; i++)
+    {
+        const uint8_t c = _classes[i];
+        if ((c == BIDI_ES || c == BIDI_CS) && _classes[i - 1] == BIDI_EN && _classes[i + 1] == BIDI_EN)
+            _classes[i] = BIDI_EN;
+        else if (c == BIDI_CS && _classes[i - 1] == BIDI_AN && _classes[i + 1] == BIDI_AN)
+            _classes[i] = BIDI_AN;
+    }
+    for (size_t i = 0; i < length;)
+    {
+        if (_classes[i] != BIDI_ET)
+        {
+            i++;
+            continue;
+        }
+        size_t j = i;
+        while (j < length && _classes[j] == BIDI_ET) j++;
+        const bool number = (i > 0 && _classes[i - 1] == BIDI_EN) || (j < length && _classes[j] == BIDI_EN);
+        for (; i < j; i++)
+        {
+            _classes[i] = number ? BIDI_EN : BIDI_N;
+        }
+    }
+    // european numbers after L are L (W7)
+    uint8_t prevStrong = sos;
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t& c = _classes[i];
+        if (c == BIDI_ES || c == BIDI_CS) c = BIDI_N;
+        if (c == BIDI_L || c == BIDI_R) prevStrong = c;
+        else if (c == BIDI_EN && prevStrong == BIDI_L) c = BIDI_L;
+    }
+
+    // neutrals between two strong characters of the same direction take that
+    // direction, otherwise the paragraph direction (N1, N2)
+    uint8_t prev = sos;
+    for (size_t i = 0; i < length;)
+    {
+        if (_classes[i] != BIDI_N)
+        {
+            prev = _classes[i] == BIDI_L ? BIDI_L : BIDI_R;
+            i++;
+            continue;
+        }
+        size_t j = i;
+        while (j < length && !isStrongOrNumber(_classes[j])) j++;
+        const uint8_t next = j < length ? static_cast<uint8_t>(_classes[j] == BIDI_L ? BIDI_L : BIDI_R) : sos;
+        const uint8_t resolved = prev == next ? prev : sos;
+        for (; i < j; i++)
+        {
+            _classes[i] = resolved;
+        }
+    }
+
+    // implicit levels (I1, I2): numbers always get an even level of their own
+    // inside right to left text, so they are never reversed
+    const int base = paragraph == TextDirection::RTL ? 1 : 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        const uint8_t c = _classes[i];
+        if (base == 0)
+            _charLevels[i] = c == BIDI_L ? 0 : c == BIDI_R ? 1 : 2;
+        else
+            _charLevels[i] = c == BIDI_R ? 1 : 2;
+    }
+
+    // common characters join the script of the preceding, then the following run
+    for (size_t i = 1; i < length; i++)
+    {
+        if (_scripts[i] == TextScript::COMMON && _charLevels[i] == _charLevels[i - 1])
+            _scripts[i] = _scripts[i - 1];
+    }
+    for (size_t i = length - 1; i > 0; i--)
+    {
+        if (_scripts[i - 1] == TextScript::COMMON && _charLevels[i - 1] == _charLevels[i])
+            _scripts[i - 1] = _scripts[i];
+    }
+
+    for (size_t i = 0; i < length;)
+    {
+        size_t j = i + 1;
+        while (j < length && _scripts[j] == _scripts[i] && _charLevels[j] == _charLevels[i]) j++;
+        const TextDirection dir = _charLevels[i] & 1 ? TextDirection::RTL : TextDirection::LTR;
+        _line.push_back(shapeRun(font, p + i, j - i, _scripts[i], dir));
+        _levels.push_back(_charLevels[i]);
+        i = j;
+    }
+
+    // reorder runs from logical to visual order
+    const int maxLevel = *std::max_element(_levels.begin(), _levels.end());
+    const size_t count = _line.size();
+    for (int level = maxLevel; level >= 1; level--)
+    {
+        for (size_t i = 0; i < count;)
+        {
+            if (_levels[i] < level)
+            {
+                i++;
+                continue;
+            }
+            size_t j = i;
+            while (j < count && _levels[j] >= level) j++;
+            std::reverse(_line.begin() + i, _line.begin() + j);
+            std::reverse(_levels.begin() + i, _levels.begin() + j);
+            i = j;
+        }
+    }
+    return _line;
+}
+
+const ShapedRun* TextShaper::shapeRun(FontFreeType* font, const char32_t* text, size_t length, TextScript script, TextDirection direction)
+{
+    RunKey key;
+    key.font = _font;
+    key.script = script;
+    key.direction = direction;
+    key.text.assign(text, length);
+
+    auto it = _cache.find(key);
+    if (it != _cache.end())
+    {
+        _hits++;
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return &it->second->run;
+    }
+
+    _misses++;
+    _lru.emplace_front();
+    CacheEntry& entry = _lru.front();
+    entry.run.script = script;
+    entry.run.direction = direction;
+#ifdef USE_HARFBUZZ
+    shapeHarfBuzz(font, text, length, entry.run);
+#else
+    shapeFallback(font, text, length, entry.run);
+#endif
+    entry.key = key;
+    _cache.emplace(std::move(key), _lru.begin());
+    return &entry.run;
+}
+
+void TextShaper::shapeFallback(FontFreeType* font, const char32_t* text, size_t length, ShapedRun& run)
+{
+    auto& glyphs = run.glyphs;
+    glyphs.resize(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        auto& g = glyphs[i];
+        g.glyphIndex = font->getGlyphIndex(text[i]);
+        g.cluster = static_cast<uint32_t>(i);
+        g.xAdvance = font->getGlyphAdvance(g.glyphIndex);
+    }
+    if (run.direction == TextDirection::RTL)
+    {
+        std::reverse(glyphs.begin(), glyphs.end());
+    }
+    // kerning pairs are in visual order, the left glyph moves its neighbour
+    for (size_t i = 1; i < length; i++)
+    {
+        glyphs[i - 1].xAdvance += font->getHorizontalKerningForGlyphs(glyphs[i - 1].glyphIndex, glyphs[i].glyphIndex);
+    }
+}
+
+#ifdef USE_HARFBUZZ
+void TextShaper::shapeHarfBuzz(FontFreeType* font, const char32_t* text, size_t length, ShapedRun& run)
+{
+    auto& hbFont = _hbFonts[_font];
+    if (!hbFont)
+    {
+        hbFont = hb_ft_font_create_referenced(font->getFTFace());
+    }
+
+    hb_buffer_t* buffer = static_cast<hb_buffer_t*>(_hbBuffer);
+    hb_buffer_clear_contents(buffer);
+    hb_buffer_add_utf32(buffer, reinterpret_cast<const uint32_t*>(text), static_cast<int>(length), 0, static_cast<int>(length));
+    hb_buffer_set_direction(buffer, run.direction == TextDirection::RTL ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
+    hb_buffer_set_script(buffer, toHBScript(run.script));
+    hb_buffer_guess_segment_properties(buffer);
+    hb_shape(static_cast<hb_font_t*>(hbFont), buffer, nullptr, 0);
+
+    unsigned int count = 0;
+    hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(buffer, &count);
+    hb_glyph_position_t* positions = hb_buffer_get_glyph_positions(buffer, &count);
+
+    // HarfBuzz output is already in visual order
+    auto& glyphs = run.glyphs;
+    glyphs.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        auto& g = glyphs[i];
+        g.glyphIndex = infos[i].codepoint;
+        g.cluster = infos[i].cluster;
+        g.xAdvance = positions[i].x_advance >> 6;
+        g.xOffset = positions[i].x_offset >> 6;
+        g.yOffset = positions[i].y_offset >> 6;
+    }
+}
+#endif
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "FontFreetype.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class TextDirection {
+    LTR,
+    RTL,
+};
+
+enum class TextScript {
+    COMMON,
+    LATIN,
+    GREEK,
+    CYRILLIC,
+    HEBREW,
+    ARABIC,
+    DEVANAGARI,
+    BENGALI,
+    THAI,
+    HANGUL,
+    HAN,
+};
+
+struct ShapedGlyph
+{
+    uint32_t glyphIndex = 0;
+    uint32_t cluster = 0;   // index of the first character in the run
+    int xAdvance = 0;
+    int xOffset = 0;
+    int yOffset = 0;
+};
+
+struct ShapedRun
+{
+    TextScript script = TextScript::COMMON;
+    TextDirection direction = TextDirection::LTR;
+    std::vector<ShapedGlyph> glyphs;    // in visual order
+};
+
+/**
+* Turns a line of UTF-32 text into positioned glyph indices.
+*
+* The line is split into runs of one script and one bidi level, resolved by a
+* simplified UAX #9 without explicit embeddings: numbers inside right to left
+* text are runs of their own and keep their digits left to right. Every run is
+* shaped with HarfBuzz when built with USE_HARFBUZZ, otherwise by a simple
+* cmap + pair kerning shaper which handles direction but no contextual forms.
+* Shaped runs are cached by (font, script, direction, text), so a string is
+* only shaped once while it stays in the cache.
+*/
+class TextShaper {
+public:
+    explicit TextShaper(size_t cacheCapacity = 1024);
+    virtual ~TextShaper();
+
+    /**
+    * Shapes text[start, start + length), which must not contain line breaks.
+    * Returns the runs in visual order, valid until the next call.
+    */
+    const std::vector<const ShapedRun*>& shapeLine(FontFreeType* font, const std::u32string& text, size_t start, size_t length);
+
+    size_t getCacheHits() const { return _hits; }
+    size_t getCacheMisses() const { return _misses; }
+    void clearCache();
+
+    static TextScript scriptOf(char32_t ch);
+    static bool isRTLScript(TextScript script);
+
+private:
+    struct RunKey {
+        std::string font;       // FontFreeType::getIdentity(), freed fonts leave their address to others
+        TextScript script;
+        TextDirection direction;
+        std::u32string text;
+        bool operator==(const RunKey& o) const
+        {
+            return font == o.font && script == o.script && direction == o.direction && text == o.text;
+        }
+    };
+    struct RunKeyHash {
+        size_t operator()(const RunKey& k) const;
+    };
+    struct CacheEntry {
+        RunKey key;
+        ShapedRun run;
+    };
+    typedef std::list<CacheEntry> CacheList;
+
+    const ShapedRun* shapeRun(FontFreeType* font, const char32_t* text, size_t length, TextScript script, TextDirection direction);
+    void shapeFallback(FontFreeType* font, const char32_t* text, size_t length, ShapedRun& run);
+#ifdef USE_HARFBUZZ
+    void shapeHarfBuzz(FontFreeType* font, const char32_t* text, size_t length, ShapedRun& run);
+    std::unordered_map<std::string, void*> _hbFonts; // hb_font_t by font identity
+    void* _hbBuffer = nullptr; // hb_buffer_t
+#endif
+
+    size_t _capacity = 0;
+    CacheList _lru;
+    std::unordered_map<RunKey, CacheList::iterator, RunKeyHash> _cache;
+    std::vector<const ShapedRun*> _line;
+    std::string _font;  // identity of the font shapeLine() was called with
+    // per character and per run scratch of shapeLine()
+    std::vector<TextScript> _scripts;
+    std::vector<uint8_t> _classes;
+    std::vector<int> _charLevels;
+    std::vector<int> _levels;
+    size_t _hits = 0;
+    size_t _misses = 0;
+};
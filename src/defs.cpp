@@ -1,6 +1,6 @@
 #include "defs.h"
 
-#include "Utils.h"
+#include "Capture.h"
 
 #include <cassert>
 #include <cstdarg>
@@ -39,7 +39,7 @@ void Rect::setSize(ScalarType w, ScalarType h)
 }
 
 GlyphBitmap::GlyphBitmap(std::vector<uint8_t>&& data, int width, int height, Rect rect, int adv, PixelMode mode)
-    : _data(data), _width(width), _height(height), _rect(rect), _xAdvance(adv), _pixelMode(mode)
+    : _data(data), _width(width), _height(height), _rect(rect), _xAdvance(adv), _xAdvance64(adv * 64), _pixelMode(mode)
 {
 }
 GlyphBitmap::GlyphBitmap(GlyphBitmap&& other) noexcept
@@ -49,23 +49,14 @@ GlyphBitmap::GlyphBitmap(GlyphBitmap&& other) noexcept
     _width = other._width;
     _height = other._height;
     _xAdvance = other._xAdvance;
+    _xAdvance64 = other._xAdvance64;
     _pixelMode = other._pixelMode;
 }
 
 #ifdef ENABLE_INSPECT
-void GlyphBitmap::inspect(std::ostream& out) const
+bool GlyphBitmap::capture(const std::string& path) const
 {
-    printf("width: %d\n", _width);
-    printf("height: %d\n", _height);
-    printf("pixelSize: %d\n", PixelModeSize(_pixelMode));
-    printf("rect{x: %d, y:%d, w:%d, h:%d}\n",
-        _rect.getOrigin().getX(),
-        _rect.getOrigin().getY(),
-        _rect.getSize().asWidth(),
-        _rect.getSize().asHeight()
-    );
-
-    utils::inspectData(out, _width, _height, PixelModeSize(_pixelMode), _data);
+    return utils::capture::writeImage(path, _width, _height, PixelModeSize(_pixelMode), _data.data());
 }
 #endif
 
@@ -87,3 +78,8 @@ int PixelModeSize(PixelMode mode)
     return 0;
 }
 
+int PixelModeRowBytes(PixelMode mode, int width)
+{
+    return mode == PixelMode::A4 ? (width + 1) / 2 : PixelModeSize(mode) * width;
+}
+
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <iosfwd>
@@ -154,10 +155,15 @@ enum class PixelMode {
     A8,
     RGB888,
     BGRA8888,
+    A4,         // 2 pixels per byte, the left one in the low nibble
     INVAL,
 };
 
+/**
+* Bytes per pixel, not defined for A4, see PixelModeRowBytes().
+*/
 int PixelModeSize(PixelMode mode);
+int PixelModeRowBytes(PixelMode mode, int width);
 
 class GlyphBitmap {
 public:
@@ -165,13 +171,21 @@ public:
 
     GlyphBitmap(GlyphBitmap&& other) noexcept;
 #ifdef ENABLE_INSPECT
-    void inspect(std::ostream &out) const;
+    /**
+    * See utils::capture::writeImage().
+    */
+    bool capture(const std::string& path) const;
 #endif
 
     int getWidth() const { return _width; }
     int getHeight() const { return _height; }
     Rect getRect() const { return _rect; }
     int getXAdvance() const { return _xAdvance; }
+    /**
+    * The advance in 26.6 fixed point, xAdvance * 64 unless set otherwise.
+    */
+    int getXAdvance64() const { return _xAdvance64; }
+    void setXAdvance64(int advance) { _xAdvance64 = advance; }
     PixelMode getPixelMode() const { return _pixelMode; }
     std::vector<uint8_t>& getData() { return _data; }
 
@@ -181,5 +195,6 @@ private:
     std::vector<uint8_t> _data;
     Rect _rect;
     int _xAdvance = 0;
+    int _xAdvance64 = 0;
     PixelMode _pixelMode;
 };
@@ -32,7 +32,6 @@ int main(int argc, char** argv)
 
 void test_get_glyphbitmap(std::string &dir, const char* data, int ch)
 {
-    std::fstream dataFile;
     FontFreeType font(data, 80.0, 0.0);
 
     assert(font.loadFont());
@@ -43,12 +42,10 @@ void test_get_glyphbitmap(std::string &dir, const char* data, int ch)
     auto glyph = font.getGlyphBitmap(output[0]);
     assert(glyph);
 
-    std::string filename = dir + "/output.txt";
-    dataFile.open(filename.c_str(), std::fstream::out);
+    std::string filename = dir + "/output.pgm";
 #ifdef ENABLE_INSPECT
-    glyph->inspect(dataFile);
+    glyph->capture(filename);
 #endif
-    dataFile.close();
     printf("write to file: %s\n", filename.c_str());
 }
 
@@ -0,0 +1,58 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<bool> _sCounting(false);
+    std::atomic<size_t> _sCount(0);
+}
+
+namespace alloc_counter
+{
+    void begin()
+    {
+        _sCount = 0;
+        _sCounting = true;
+    }
+
+    size_t end()
+    {
+        _sCounting = false;
+        return _sCount;
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    if (_sCounting) _sCount++;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
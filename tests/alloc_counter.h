@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+* Counts calls to the global operator new between begin() and end(),
+* the operators are replaced in alloc_counter.cpp.
+*/
+namespace alloc_counter
+{
+    void begin();
+    size_t end();
+}
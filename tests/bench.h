@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+
+namespace bench
+{
+    /**
+    * Runs `fn` `warmup` times, then returns the time of each of `reps` calls
+    * in nanoseconds.
+    */
+    template<typename F>
+    std::vector<double> sampleNs(int warmup, int reps, F fn)
+    {
+        for (int i = 0; i < warmup; i++)
+        {
+            fn();
+        }
+        std::vector<double> samples(reps);
+        for (int i = 0; i < reps; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            samples[i] = std::chrono::duration<double, std::nano>(end - start).count();
+        }
+        return samples;
+    }
+
+    /**
+    * Nearest rank percentile of sorted `values`, `p` in [0, 100].
+    */
+    inline double percentile(const std::vector<double>& values, double p)
+    {
+        if (values.empty()) return 0;
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+        return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+    }
+
+    /**
+    * `unit` repeated until the result has at least `bytes` bytes.
+    */
+    inline std::string repeatToSize(const std::string& unit, size_t bytes)
+    {
+        std::string ret;
+        while (ret.size() < bytes) ret += unit;
+        return ret;
+    }
+
+    struct Options
+    {
+        int warmup = 3;
+        int reps = 20;
+        std::string json;
+        std::string filter;
+        bool features = false;
+        std::string font = DEFAULT_FONTPATH;
+        std::string trace;
+    };
+
+    struct Result
+    {
+        std::string name;
+        std::string unit;
+        std::vector<double> values;     // sorted
+        std::vector<std::pair<std::string, double>> metrics;
+    };
+
+    /**
+    * Collects the results of text_bench, printed as a table and written as
+    * JSON by text_bench.cpp.
+    */
+    class Report {
+    public:
+        explicit Report(const Options& options) : _options(options) {}
+
+        bool enabled(const std::string& name) const
+        {
+            return _options.filter.empty() || name.find(_options.filter) != std::string::npos;
+        }
+
+        /**
+        * Times `fn` and converts every sample with `convert(ns)`.
+        */
+        template<typename F, typename Convert>
+        Result& run(const std::string& name, const char* unit, F fn, Convert convert)
+        {
+            flush();
+            auto values = sampleNs(_options.warmup, _options.reps, fn);
+            for (auto& v : values)
+            {
+                v = convert(v);
+            }
+            std::sort(values.begin(), values.end());
+            _results.push_back(Result{ name, unit, std::move(values), {} });
+            return _results.back();
+        }
+
+        /**
+        * Prints the results not printed yet, the metrics of a result may be
+        * set until the next run().
+        */
+        void flush();
+
+        bool writeJSON(const std::string& path) const;
+
+    private:
+        Options _options;
+        std::vector<Result> _results;
+        size_t _printed = 0;
+    };
+}
@@ -0,0 +1,404 @@
+#include <random>
+
+#include "FontCache.h"
+#include "FontCollection.h"
+#include "FontFallbackChain.h"
+#include "StreamingLabel.h"
+#include "TextLayout.h"
+#include "TextShaper.h"
+#include "ccUTF8.h"
+#include "ConvertUTF.h"
+
+#include "bench.h"
+#include "config.h"
+
+using bench::repeatToSize;
+
+void bench_shaping(bench::Report& report, const char* font)
+{
+    FontCache cache;
+    FontCacheEntry* entry = cache.get(font, 24, 0);
+    if (!entry) return;
+
+    std::u32string text;
+    StringUtils::UTF8ToUTF32("Player joined the game\nScore: 12345 / 67890\nThe quick brown fox jumps over the lazy dog", text);
+
+    TextLayoutStyle style;
+    style.lineHeight = entry->lineHeight;
+    TextLayoutScratch scratch;
+    TextShaper shaper;
+    const double chars = text.length();
+    auto perChar = [&](double ns) { return ns / chars; };
+
+    if (report.enabled("shaping/unshaped"))
+    {
+        report.run("shaping/unshaped", "ns/char", [&]() {
+            scratch.reset();
+            TextLayout::layoutLines(text, nullptr, entry->atlas.get(), entry->font.get(), style, scratch.spaces);
+        }, perChar);
+    }
+    if (report.enabled("shaping/cached"))
+    {
+        report.run("shaping/cached", "ns/char", [&]() {
+            scratch.reset();
+            TextLayout::layoutShapedLines(text, &shaper, entry->atlas.get(), entry->font.get(), style, scratch.spaces);
+        }, perChar);
+    }
+    if (report.enabled("shaping/cold"))
+    {
+        report.run("shaping/cold", "ns/char", [&]() {
+            shaper.clearCache();
+            scratch.reset();
+            TextLayout::layoutShapedLines(text, &shaper, entry->atlas.get(), entry->font.get(), style, scratch.spaces);
+        }, perChar);
+    }
+}
+
+namespace {
+    // the conversion path before the vectorized decoder
+    bool convertUTFReference(const std::string& from, std::u32string& to)
+    {
+        std::u32string working(from.length() * 4 / sizeof(char32_t), 0);
+        auto inbeg = reinterpret_cast<const UTF8*>(from.data());
+        auto outbeg = reinterpret_cast<UTF32*>(&working[0]);
+        if (ConvertUTF8toUTF32(&inbeg, inbeg + from.length(), &outbeg, outbeg + working.length(), strictConversion) != conversionOK)
+            return false;
+        working.resize(reinterpret_cast<char32_t*>(outbeg) - &working[0]);
+        to = std::move(working);
+        return true;
+    }
+}
+
+void bench_utf8(bench::Report& report)
+{
+    struct Corpus {
+        const char* name;
+        std::string text;
+    } corpora[] = {
+        { "ascii", repeatToSize("The quick brown fox jumps over the lazy dog. 0123456789\n", 1 << 20) },
+        { "cyrillic", repeatToSize("\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 \xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85, 2024.\n", 1 << 20) },
+        { "cjk", repeatToSize("\xe4\xbd\xa0\xe5\xa5\xbd\xe4\xb8\x96\xe7\x95\x8c\xef\xbc\x8c\xe6\x96\x87\xe5\xad\x97\xe6\xb8\xb2\xe6\x9f\x93 OK\n", 1 << 20) },
+    };
+
+    std::u32string out;
+    for (auto& c : corpora)
+    {
+        const std::string prefix = std::string("utf8_convert/") + c.name;
+        auto perByte = [&](double ns) { return c.text.size() / ns; };
+        if (report.enabled(prefix + "/reference"))
+        {
+            report.run(prefix + "/reference", "GB/s", [&]() { convertUTFReference(c.text, out); }, perByte);
+        }
+        if (report.enabled(prefix + "/string"))
+        {
+            report.run(prefix + "/string", "GB/s", [&]() { StringUtils::UTF8ToUTF32(c.text, out); }, perByte);
+        }
+        if (report.enabled(prefix + "/buffer"))
+        {
+            out.resize(c.text.size());
+            report.run(prefix + "/buffer", "GB/s", [&]() {
+                StringUtils::UTF8ToUTF32(c.text.data(), c.text.size(), &out[0], out.size());
+            }, perByte);
+        }
+    }
+}
+
+void bench_streaming(bench::Report& report, const char* font)
+{
+    const char* windows[] = { "streaming/window_top", "streaming/window_middle", "streaming/window_bottom" };
+    bool any = report.enabled("streaming/index");
+    for (auto name : windows)
+    {
+        any = any || report.enabled(name);
+    }
+    if (!any) return;
+
+    // 16 MB of log lines, only a screenful is laid out
+    const std::string text = repeatToSize("2024-05-01 12:00:00 INFO \xd0\xa1\xd0\xb5\xd1\x80\xd0\xb2\xd0\xb5\xd1\x80 started, listening on port 8080\n", 16 << 20);
+
+    StreamingLabel label;
+    auto index = [&]() {
+        std::unique_ptr<utils::TextSource> source(new utils::MemoryTextSource(text.data(), text.size()));
+        label.init(font, std::move(source), 24, 0);
+    };
+    auto toMs = [](double ns) { return ns / 1e6; };
+    if (report.enabled("streaming/index"))
+    {
+        auto& result = report.run("streaming/index", "ms", index, toMs);
+        const size_t lines = label.getLineCount();
+        result.metrics.emplace_back("lines", static_cast<double>(lines));
+        result.metrics.emplace_back("index_bytes", static_cast<double>((lines / StreamingLabel::LINE_INDEX_STRIDE + 1) * sizeof(uint64_t)));
+    }
+    else
+    {
+        index();
+    }
+
+    const size_t lines = label.getLineCount();
+    const size_t firsts[] = { 0, lines / 2, lines - 50 };
+    for (int i = 0; i < 3; i++)
+    {
+        if (!report.enabled(windows[i])) continue;
+        auto& result = report.run(windows[i], "ms", [&]() { label.setWindow(firsts[i], 50); }, toMs);
+        result.metrics.emplace_back("vertices", static_cast<double>(label.getVertices().size()));
+    }
+}
+
+namespace {
+    // the previous StringUTF8 layout, one std::string per character
+    struct CharVectorString {
+        std::vector<std::string> chars;
+
+        explicit CharVectorString(const std::string& utf8)
+        {
+            for (size_t i = 0; i < utf8.size();)
+            {
+                size_t n = getNumBytesForUTF8(static_cast<UTF8>(utf8[i]));
+                chars.emplace_back(utf8, i, n);
+                i += n;
+            }
+        }
+
+        size_t memoryUsage() const
+        {
+            size_t bytes = chars.capacity() * sizeof(std::string);
+            for (auto& c : chars)
+            {
+                if (c.capacity() > 15) bytes += c.capacity() + 1; // outside the small string buffer
+            }
+            return bytes;
+        }
+    };
+}
+
+void bench_string_utf8(bench::Report& report)
+{
+    const std::string text = repeatToSize("Hello, \xd0\xbc\xd0\xb8\xd1\x80! \xe4\xbd\xa0\xe5\xa5\xbd ", 1 << 20);
+    const size_t count = StringUtils::getUTF32LengthOfUTF8(text.data(), text.size());
+
+    StringUtils::StringUTF8 compact(text);
+    compact.getCharAt(count - 1);   // builds the index
+    CharVectorString perChar(text);
+
+    // a sample is a batch of edits, a single one is close to the clock
+    // resolution, one string per char moves megabytes on every edit
+    const int edits = 100;
+    const int slowEdits = 10;
+    auto perEdit = [&](double ns) { return ns / edits; };
+
+    // typing and deleting around a cursor which moves by a few characters
+    std::mt19937 rng(1);
+    size_t cursor = count / 2;
+    if (report.enabled("string_utf8/cursor_edit"))
+    {
+        auto& result = report.run("string_utf8/cursor_edit", "ns/edit", [&]() {
+            for (int i = 0; i < edits; i++)
+            {
+                cursor = std::min(compact.length(), cursor + rng() % 16);
+                compact.insert(cursor, "\xd0\xb6");
+                compact.deleteChar(cursor > 0 ? cursor - 1 : 0);
+            }
+        }, perEdit);
+        result.metrics.emplace_back("chars", static_cast<double>(count));
+        result.metrics.emplace_back("bytes", static_cast<double>(compact.getMemoryUsage()));
+    }
+    if (report.enabled("string_utf8/cursor_edit_per_char"))
+    {
+        auto& result = report.run("string_utf8/cursor_edit_per_char", "ns/edit", [&]() {
+            for (int i = 0; i < slowEdits; i++)
+            {
+                cursor = std::min(perChar.chars.size(), cursor + rng() % 16);
+                perChar.chars.insert(perChar.chars.begin() + cursor, "\xd0\xb6");
+                perChar.chars.erase(perChar.chars.begin() + (cursor > 0 ? cursor - 1 : 0));
+            }
+        }, [&](double ns) { return ns / slowEdits; });
+        result.metrics.emplace_back("bytes", static_cast<double>(perChar.memoryUsage()));
+    }
+    if (report.enabled("string_utf8/random_edit"))
+    {
+        report.run("string_utf8/random_edit", "ns/edit", [&]() {
+            for (int i = 0; i < edits; i++)
+            {
+                size_t pos = rng() % compact.length();
+                compact.insert(pos, "a");
+                compact.deleteChar(pos);
+            }
+        }, perEdit);
+    }
+    if (report.enabled("string_utf8/random_get"))
+    {
+        report.run("string_utf8/random_get", "ns/lookup", [&]() {
+            for (int i = 0; i < edits; i++)
+            {
+                compact.getCharAt(rng() % compact.length());
+            }
+        }, perEdit);
+    }
+}
+
+namespace {
+    // the range checks before the property table
+    bool chainIsSpace(char32_t ch)
+    {
+        return  (ch >= 0x0009 && ch <= 0x000D) || ch == 0x0020 || ch == 0x0085 || ch == 0x00A0 || ch == 0x1680
+        || (ch >= 0x2000 && ch <= 0x200A) || ch == 0x2028 || ch == 0x2029 || ch == 0x202F
+        ||  ch == 0x205F || ch == 0x3000;
+    }
+
+    bool chainIsCJK(char32_t ch)
+    {
+        return (ch >= 0x4E00 && ch <= 0x9FBF) || (ch >= 0x2E80 && ch <= 0x2FDF) || (ch >= 0x2FF0 && ch <= 0x30FF)
+            || (ch >= 0x3100 && ch <= 0x31BF) || (ch >= 0xAC00 && ch <= 0xD7AF) || (ch >= 0xF900 && ch <= 0xFAFF)
+            || (ch >= 0xFE30 && ch <= 0xFE4F) || (ch >= 0x31C0 && ch <= 0x4DFF) || (ch >= 0x1f004 && ch <= 0x1f682);
+    }
+
+    bool chainIsNonBreaking(char32_t ch)
+    {
+        return ch == 0x00A0 || ch == 0x202F || ch == 0x2007 || ch == 0x2060;
+    }
+}
+
+void bench_unicode_properties(bench::Report& report)
+{
+    std::u32string text;
+    StringUtils::UTF8ToUTF32(repeatToSize("Hello \xd0\xbc\xd0\xb8\xd1\x80, \xe4\xbd\xa0\xe5\xa5\xbd\xe4\xb8\x96\xe7\x95\x8c! \xf0\x9f\x98\x80 ok\n", 1 << 20), text);
+    std::vector<uint16_t> props(text.length());
+    volatile int sink = 0;
+
+    const double chars = text.length();
+    auto perChar = [&](double ns) { return ns / chars; };
+
+    if (report.enabled("unicode_properties/range_checks"))
+    {
+        report.run("unicode_properties/range_checks", "ns/char", [&]() {
+            int n = 0;
+            for (char32_t ch : text)
+            {
+                n += chainIsSpace(ch) + chainIsCJK(ch) * 2 + chainIsNonBreaking(ch) * 4;
+            }
+            sink = n;
+        }, perChar);
+    }
+    if (report.enabled("unicode_properties/table"))
+    {
+        report.run("unicode_properties/table", "ns/char", [&]() {
+            int n = 0;
+            for (char32_t ch : text)
+            {
+                n += StringUtils::getUnicodeProperties(ch) & 7;
+            }
+            sink = n;
+        }, perChar);
+    }
+    if (report.enabled("unicode_properties/batch"))
+    {
+        report.run("unicode_properties/batch", "ns/char", [&]() {
+            StringUtils::getUnicodeProperties(text.data(), text.length(), props.data());
+        }, perChar);
+    }
+}
+
+void bench_font_registration(bench::Report& report)
+{
+    // registering every size of a few fonts, only one of them is drawn
+    const char* files[] = { RESOURCES_DIR "/arial.ttf", RESOURCES_DIR "/Courier New.ttf", RESOURCES_DIR "/American Typewriter.ttf" };
+    const float sizes[] = { 12, 16, 20, 24, 32, 48 };
+    const double fonts = sizeof(files) / sizeof(files[0]) * sizeof(sizes) / sizeof(sizes[0]);
+    auto toMs = [](double ns) { return ns / 1e6; };
+
+    if (report.enabled("font_registration/eager"))
+    {
+        auto& result = report.run("font_registration/eager", "ms", [&]() {
+            std::vector<std::unique_ptr<FontFreeType>> registered;
+            for (auto file : files)
+            {
+                for (float size : sizes)
+                {
+                    registered.emplace_back(new FontFreeType(file, size, 0));
+                    registered.back()->loadFont();
+                }
+            }
+            registered[0]->getGlyphIndex('A');
+        }, toMs);
+        result.metrics.emplace_back("fonts", fonts);
+    }
+    if (report.enabled("font_registration/lazy"))
+    {
+        auto& result = report.run("font_registration/lazy", "ms", [&]() {
+            std::vector<std::unique_ptr<FontFreeType>> registered;
+            for (auto file : files)
+            {
+                auto collection = FontCollection::open(file);
+                for (float size : sizes)
+                {
+                    registered.push_back(collection->createFont(0, size, 0));
+                }
+            }
+            registered[0]->getGlyphIndex('A');
+        }, toMs);
+        result.metrics.emplace_back("fonts", fonts);
+    }
+}
+
+void bench_font_fallback(bench::Report& report)
+{
+    // Latin text with Cyrillic and Greek words, the first font has neither
+    FontFreeType primary(RESOURCES_DIR "/American Typewriter.ttf", 24, 0);
+    primary.loadFont();
+    FontFallbackChain chain(&primary);
+    chain.addFont(RESOURCES_DIR "/cyril.ttf", 24, 0);
+    chain.addFont(RESOURCES_DIR "/arial.ttf", 24, 0);
+
+    std::u32string text;
+    StringUtils::UTF8ToUTF32(repeatToSize("The \xd0\xbc\xd0\xb8\xd1\x80 and \xce\xba\xcf\x8c\xcf\x83\xce\xbc\xce\xbf\xcf\x82 of words, ", 64 << 10), text);
+
+    FontAtlas atlas(PixelMode::A8, 512, 512);
+    atlas.init();
+    TextLayoutStyle style;
+    style.lineHeight = primary.getFontAscender();
+    TextLayoutScratch scratch;
+    auto layout = [&]() {
+        scratch.reset();
+        TextLayout::layoutFallbackLines(text, nullptr, &atlas, &chain, style, scratch.spaces);
+    };
+    layout();
+    const double chars = text.size();
+    auto perChar = [&](double ns) { return ns / chars; };
+
+    if (report.enabled("font_fallback/layout"))
+    {
+        report.run("font_fallback/layout", "ns/char", layout, perChar);
+    }
+    volatile size_t found = 0;
+    if (report.enabled("font_fallback/resolve"))
+    {
+        auto& result = report.run("font_fallback/resolve", "ns/char", [&]() {
+            size_t n = 0;
+            for (char32_t ch : text)
+            {
+                n += chain.resolve(ch);
+            }
+            found = n;
+        }, perChar);
+        result.metrics.emplace_back("cache_bytes", static_cast<double>(chain.getCacheMemoryUsage()));
+    }
+    // what resolving by the charmaps costs without the cache
+    if (report.enabled("font_fallback/charmap_scan"))
+    {
+        report.run("font_fallback/charmap_scan", "ns/char", [&]() {
+            size_t n = 0;
+            for (char32_t ch : text)
+            {
+                for (size_t i = 0; i < chain.getFontCount(); i++)
+                {
+                    if (chain.getFont(i)->getGlyphIndex(ch))
+                    {
+                        n += i;
+                        break;
+                    }
+                }
+            }
+            found = n;
+        }, perChar);
+    }
+}
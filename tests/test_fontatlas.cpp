@@ -1,11 +1,13 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include <cstring>
 
 #include "FontFreeType.h"
 #include "FontAtlas.h"
 #include "ccUTF8.h"
 #include "Label.h"
+#include "LabelBatch.h"
 
 #include "config.h"
 
@@ -20,6 +22,56 @@ void test_font_atlas(const std::string& chars, const char* fontFile, std::string
 
 void test_label(const char* font, const char* text);
 
+void test_label_batch(const char* font, int labelCount);
+
+void test_layout_no_alloc(const char* font);
+
+void test_glyph_quads_simd();
+
+void test_rich_label(const char* font, const char* font2);
+
+void test_shaping(const char* font);
+
+void test_utf8_decode();
+
+void test_utf8_stream();
+
+void test_string_utf8();
+
+void test_unicode_properties();
+
+void test_utf_conversions_no_alloc();
+
+void test_async_font_loader();
+
+void test_streaming_label(const char* font);
+
+void test_font_collection();
+
+void test_font_fallback(const char* font, const char* fallback);
+
+void test_profiler(const char* font);
+
+void test_subpixel_positioning(const char* font);
+
+void test_lcd_rendering();
+
+void test_color_glyphs();
+
+void test_outline_cache();
+
+void test_text_rasterizer(const char* font);
+
+void test_capture(const char* font);
+
+void test_atlas_compression();
+
+void test_a4_atlas();
+
+void test_glyph_normalization();
+
+void test_concurrent_atlas();
+
 int main(int argc, char** argv)
 {
     const char* font_path = nullptr;
@@ -34,6 +86,56 @@ int main(int argc, char** argv)
     //test_font_atlas("abcdefghijklmnopqrst", font_path, output);
 
     test_label(font_path, "hello\nsdfafsdf\nABAVAVAVAV\n3456767454");
+
+    test_label_batch(font_path, 500);
+
+    test_layout_no_alloc(font_path);
+
+    test_glyph_quads_simd();
+
+    test_rich_label(font_path, RESOURCES_DIR "/cyrillic.ttf");
+
+    test_shaping(font_path);
+
+    test_utf8_decode();
+
+    test_utf8_stream();
+
+    test_string_utf8();
+
+    test_unicode_properties();
+
+    test_utf_conversions_no_alloc();
+
+    test_async_font_loader();
+
+    test_streaming_label(font_path);
+
+    test_font_collection();
+
+    test_font_fallback(RESOURCES_DIR "/American Typewriter.ttf", RESOURCES_DIR "/arial.ttf");
+
+    test_profiler(font_path);
+
+    test_subpixel_positioning(font_path);
+
+    test_lcd_rendering();
+
+    test_color_glyphs();
+
+    test_outline_cache();
+
+    test_text_rasterizer(font_path);
+
+    test_capture(font_path);
+
+    test_atlas_compression();
+
+    test_a4_atlas();
+
+    test_glyph_normalization();
+
+    test_concurrent_atlas();
     
     return 0;
 }
@@ -47,6 +149,32 @@ void test_label(const char* font, const char* text)
     delete label;
 }
 
+void test_label_batch(const char* font, int labelCount)
+{
+    std::vector<LabelDesc> descs(labelCount);
+    for (int i = 0; i < labelCount; i++)
+    {
+        descs[i].font = font;
+        descs[i].fontSize = i % 2 ? 20 : 32;
+        descs[i].text = StringUtils::format("HP %d/%d\nscore: %d", i, labelCount, i * 37);
+        descs[i].alignH = static_cast<LabelAlignmentH>(i % 3);
+    }
+
+    LabelBatch batch;
+    bool ok = batch.layout(descs);
+    assert(ok);
+    auto& ranges = batch.getRanges();
+    assert(ranges.size() == descs.size());
+    int vertexCount = 0;
+    for (auto& r : ranges)
+    {
+        assert(r.validate && r.vertexOffset == vertexCount && r.vertexCount > 0);
+        vertexCount += r.vertexCount;
+    }
+    assert(vertexCount == batch.getVertices().size());
+    printf("label batch: %d labels, %d vertices\n", labelCount, vertexCount);
+}
+
 std::shared_ptr<GlyphBitmap> test_get_glyphbitmap(FontFreeType &font, const char* ch)
 {
     std::u32string output;
@@ -72,13 +200,10 @@ void test_font_atlas(const std::string& chars, const char *fontFile,  std::strin
         atlas->addLetter(chars[c], bitmap);
     }
 
-    std::fstream dataFile;
-    std::string filename = dir + "/output2.txt";
-    dataFile.open(filename.c_str(), std::fstream::out);
+    std::string filename = dir + "/output2.pgm";
 #ifdef ENABLE_INSPECT
-    atlas->frameAt(0).inspect(dataFile);
+    atlas->frameAt(0)->capture(filename);
 #endif
-    dataFile.close();
     printf("write to file: %s\n", filename.c_str());
 
     delete atlas;
@@ -0,0 +1,866 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "AsyncFontLoader.h"
+#include "BitmapKernels.h"
+#include "FontCache.h"
+#include "FontCollection.h"
+#include "Label.h"
+#include "RichText.h"
+#include "TextRasterizer.h"
+#include "Utils.h"
+
+#include "config.h"
+
+void test_async_font_loader()
+{
+    std::vector<uint8_t> data;
+    bool read = utils::readFile(RESOURCES_DIR "/missing.ttf").empty() && !utils::readFile(RESOURCES_DIR "/missing.ttf", data);
+    assert(read);
+    read = utils::readFile(RESOURCES_DIR "/arial.ttf", data);
+    assert(read && !data.empty());
+
+    AsyncFontLoader loader(16 * 1024);
+
+    // queued while paused, served by priority
+    loader.pause();
+    auto low = loader.load(RESOURCES_DIR "/Courier New.ttf", 24, 0, 0);
+    auto high = loader.load(RESOURCES_DIR "/arial.ttf", 24, 0, 10);
+    auto middle = loader.load(RESOURCES_DIR "/cyrillic.ttf", 24, 1, 5);
+    auto missing = loader.load(RESOURCES_DIR "/missing.ttf", 24, 0, 5);
+    auto cancelled = loader.load(RESOURCES_DIR "/Abberancy.ttf", 24, 0, 20);
+    assert(loader.getPendingCount() == 5);
+    bool removed = cancelled->cancel();
+    assert(removed);
+    bool ready = high->waitFor(std::chrono::milliseconds(10));
+    assert(!ready);
+    loader.resume();
+
+    FontLoadStatus status = high->wait();
+    assert(status == FontLoadStatus::LOADED);
+    status = middle->wait();
+    assert(status == FontLoadStatus::LOADED);
+    status = low->wait();
+    assert(status == FontLoadStatus::LOADED);
+    status = missing->wait();
+    assert(status == FontLoadStatus::FAILED);
+    status = cancelled->wait();
+    assert(status == FontLoadStatus::CANCELLED);
+    assert(!cancelled->get() && !missing->get());
+    removed = high->cancel();
+    assert(!removed);
+
+    assert(high->getStats().queued < middle->getStats().queued);
+    assert(middle->getStats().queued < low->getStats().queued);
+
+    for (auto& handle : { high, middle, low })
+    {
+        auto& stats = handle->getStats();
+        printf("font load %-50s %8llu bytes, queued %6.2f ms, read %6.2f ms, face %6.2f ms\n", handle->getFontName().c_str(),
+            static_cast<unsigned long long>(stats.bytes), stats.queued, stats.read, stats.face);
+        assert(handle->get()->getGlyphIndex('A') != 0);
+    }
+
+    std::unique_ptr<FontFreeType> font = low->release();
+    assert(font && !low->get());
+    assert(font->getFontAscender() > 0);
+
+    // pending loads are cancelled by the destructor
+    std::shared_ptr<FontLoadHandle> orphan;
+    {
+        AsyncFontLoader other;
+        other.pause();
+        orphan = other.load(RESOURCES_DIR "/arial.ttf", 24, 0);
+    }
+    assert(orphan->getStatus() == FontLoadStatus::CANCELLED);
+    printf("async font loader: ok\n");
+}
+
+namespace {
+
+    uint32_t readU32(const uint8_t* p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+
+    void writeU32(uint8_t* p, uint32_t v)
+    {
+        p[0] = uint8_t(v >> 24);
+        p[1] = uint8_t(v >> 16);
+        p[2] = uint8_t(v >> 8);
+        p[3] = uint8_t(v);
+    }
+
+    // concatenates fonts into a TrueType collection, table offsets are rebased
+    std::vector<uint8_t> buildCollection(const std::vector<std::vector<uint8_t>>& fonts)
+    {
+        std::vector<uint8_t> ttc(12 + 4 * fonts.size());
+        memcpy(ttc.data(), "ttcf", 4);
+        writeU32(&ttc[4], 0x00010000);
+        writeU32(&ttc[8], static_cast<uint32_t>(fonts.size()));
+        for (size_t i = 0; i < fonts.size(); i++)
+        {
+            while (ttc.size() % 4) ttc.push_back(0);
+            const uint32_t start = static_cast<uint32_t>(ttc.size());
+            writeU32(&ttc[12 + 4 * i], start);
+            ttc.insert(ttc.end(), fonts[i].begin(), fonts[i].end());
+            const int numTables = (ttc[start + 4] << 8) | ttc[start + 5];
+            for (int t = 0; t < numTables; t++)
+            {
+                uint8_t* offset = &ttc[start + 12 + 16 * t + 8];
+                writeU32(offset, readU32(offset) + start);
+            }
+        }
+        return ttc;
+    }
+}
+
+void test_font_collection()
+{
+    const char* files[] = { RESOURCES_DIR "/arial.ttf", RESOURCES_DIR "/Courier New.ttf", RESOURCES_DIR "/cyrillic.ttf" };
+    std::vector<std::vector<uint8_t>> fonts;
+    for (auto file : files)
+    {
+        fonts.push_back(utils::readFile(file));
+    }
+    auto collection = FontCollection::open("test.ttc", utils::MappedFile::fromData(buildCollection(fonts)));
+    assert(collection && collection->getFaceCount() == 3);
+    assert(!FontCollection::open(RESOURCES_DIR "/missing.ttf"));
+
+    for (size_t i = 0; i < collection->getFaceCount(); i++)
+    {
+        auto& info = collection->getFaceInfo(i);
+        auto single = FontCollection::open(files[i]);
+        assert(single && single->getFile()->size() == fonts[i].size());
+        assert(single->getFaceInfo(0).family == info.family);
+
+        for (float size : { 9.f, 12.f, 17.5f, 24.f, 40.f })
+        {
+            FontFreeType eager(files[i], size, 0);
+            bool loaded = eager.loadFont();
+            assert(loaded);
+            auto lazy = collection->createFont(i, size, 0);
+            assert(!lazy->isFaceOpen());
+            assert(lazy->getFontAscender() == eager.getFontAscender());
+            assert(std::string(lazy->getFontFamily()) == eager.getFontFamily());
+            assert(!lazy->isFaceOpen());
+            assert(lazy->getGlyphIndex('A') == eager.getGlyphIndex('A'));
+            assert(lazy->isFaceOpen());
+            assert(lazy->getGlyphAdvance(lazy->getGlyphIndex(0x416)) == eager.getGlyphAdvance(eager.getGlyphIndex(0x416)));
+            assert(lazy->getFTFace()->face_index == static_cast<FT_Long>(i));
+        }
+        printf("face %d: %s %s\n", static_cast<int>(i), info.family.c_str(), info.style.c_str());
+        assert(collection->findFace(info.family, info.style) == static_cast<int>(i));
+    }
+    assert(collection->findFace("no such family") == -1);
+
+    // fractional sizes, Courier New has bitmap strikes up to 21 px that change the scale
+    for (size_t i = 0; i < collection->getFaceCount(); i++)
+    {
+        FontFreeType eager(files[i], 6, 0);
+        bool loaded = eager.loadFont();
+        assert(loaded);
+        FT_Face face = eager.getFTFace();
+        for (float size = 6; size <= 80; size += 0.25f)
+        {
+            FT_Set_Char_Size(face, static_cast<FT_F26Dot6>(64 * size), static_cast<FT_F26Dot6>(64 * size), 72, 72);
+            assert(collection->getFaceInfo(i).getAscender(size) == (face->size->metrics.ascender >> 6));
+        }
+    }
+    assert(!collection->getFaceInfo(1).strikes.empty());
+    assert(!collection->createFont(3, 24, 0));
+
+    // the cache opens every file once, faces on demand
+    FontCache cache;
+    auto entry = cache.get(RESOURCES_DIR "/arial.ttf", 24, 0);
+    auto entry2 = cache.get(RESOURCES_DIR "/arial.ttf", 0, 32, 1);
+    assert(entry && entry2 && entry != entry2);
+    assert(!cache.get(RESOURCES_DIR "/arial.ttf", 1, 24, 0));
+    assert(!cache.get(RESOURCES_DIR "/missing.ttf", 24, 0));
+    printf("font collection: ok\n");
+}
+
+void test_lcd_rendering()
+{
+    FontFreeType gray(RESOURCES_DIR "/arial.ttf", 12, 0);
+    FontFreeType lcd(RESOURCES_DIR "/arial.ttf", 12, 0);
+    bool loaded = gray.loadFont() && lcd.loadFont();
+    assert(loaded);
+    lcd.setLCDRendering(true);
+    assert(lcd.getPixelMode() == PixelMode::RGB888);
+
+    // one byte per subpixel, the padding of the pitch is dropped
+    bool colored = false;
+    for (char32_t ch = 'a'; ch <= 'z'; ch++)
+    {
+        auto a8 = gray.getGlyphBitmap(ch);
+        auto rgb = lcd.getGlyphBitmap(ch);
+        assert(a8 && rgb);
+        assert(rgb->getPixelMode() == PixelMode::RGB888);
+        assert(rgb->getData().size() == static_cast<size_t>(rgb->getWidth() * rgb->getHeight() * 3));
+        assert(rgb->getWidth() >= a8->getWidth() && rgb->getHeight() == a8->getHeight());
+        assert(rgb->getXAdvance() == a8->getXAdvance());
+        auto& data = rgb->getData();
+        for (size_t i = 0; i + 2 < data.size(); i += 3)
+        {
+            colored |= data[i] != data[i + 1] || data[i + 1] != data[i + 2];
+        }
+    }
+    assert(colored);
+
+    // LCD glyphs are packed with a blank texel between them
+    FontAtlas atlas(PixelMode::RGB888, 128, 128);
+    atlas.init();
+    auto* l = atlas.getOrLoad('l', &lcd);
+    auto* m = atlas.getOrLoad('m', &lcd);
+    assert(l && m && l->textureID == m->textureID);
+    assert(m->texX * 128 >= (l->texX + l->texWidth) * 128 + 1);
+
+    FontCache cache(PixelMode::RGB888);
+    auto entry = cache.get(RESOURCES_DIR "/arial.ttf", 12, 0);
+    assert(entry && entry->font->isLCDRendering());
+    auto* g = entry->atlas->getOrLoad('g', entry->font.get());
+    assert(g);
+
+    Label label;
+    label.init(RESOURCES_DIR "/arial.ttf", "Sharp small text", 12, 0);
+    const size_t vertices = label.getVertices().size();
+    label.setLCDRendering(true);
+    assert(label.getVertices().size() == vertices);
+    assert(label.getFontAtlas()->getLetterCount() > 0);
+    printf("lcd rendering: ok\n");
+}
+
+namespace {
+
+    void appendU16(std::vector<uint8_t>& v, uint16_t x)
+    {
+        v.push_back(uint8_t(x >> 8));
+        v.push_back(uint8_t(x));
+    }
+
+    void appendU16s(std::vector<uint8_t>& v, std::initializer_list<uint16_t> values)
+    {
+        for (auto x : values)
+        {
+            appendU16(v, x);
+        }
+    }
+
+    void appendU32(std::vector<uint8_t>& v, uint32_t x)
+    {
+        appendU16(v, uint16_t(x >> 16));
+        appendU16(v, uint16_t(x));
+    }
+
+    uint32_t crc32(const uint8_t* p, size_t n)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < n; i++)
+        {
+            crc ^= p[i];
+            for (int k = 0; k < 8; k++)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    // RGBA8 PNG with stored (uncompressed) deflate blocks
+    std::vector<uint8_t> encodePNG(const std::vector<uint8_t>& rgba, int width, int height)
+    {
+        std::vector<uint8_t> raw;
+        for (int y = 0; y < height; y++)
+        {
+            raw.push_back(0);
+            raw.insert(raw.end(), rgba.begin() + y * width * 4, rgba.begin() + (y + 1) * width * 4);
+        }
+        std::vector<uint8_t> z = { 0x78, 0x01 };
+        for (size_t pos = 0; pos < raw.size() || pos == 0; pos += 65535)
+        {
+            const size_t n = std::min<size_t>(65535, raw.size() - pos);
+            z.push_back(pos + n == raw.size() ? 1 : 0);
+            z.push_back(uint8_t(n)); z.push_back(uint8_t(n >> 8));
+            z.push_back(uint8_t(~n)); z.push_back(uint8_t(~n >> 8));
+            z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+        }
+        uint32_t a = 1, b = 0;
+        for (auto c : raw)
+        {
+            a = (a + c) % 65521;
+            b = (b + a) % 65521;
+        }
+        appendU32(z, (b << 16) | a);
+
+        std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        auto chunk = [&](const char* type, const std::vector<uint8_t>& data) {
+            appendU32(png, static_cast<uint32_t>(data.size()));
+            const size_t start = png.size();
+            png.insert(png.end(), type, type + 4);
+            png.insert(png.end(), data.begin(), data.end());
+            appendU32(png, crc32(png.data() + start, png.size() - start));
+        };
+        std::vector<uint8_t> ihdr;
+        appendU32(ihdr, width);
+        appendU32(ihdr, height);
+        ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 });
+        chunk("IHDR", ihdr);
+        chunk("IDAT", z);
+        chunk("IEND", {});
+        return png;
+    }
+
+    // bitmap-only font with one CBDT strike of `ppem` px, U+263A maps to a
+    // square image with a red top half and a blue bottom half
+    std::vector<uint8_t> buildColorFont(int ppem)
+    {
+        std::vector<uint8_t> rgba(ppem * ppem * 4);
+        for (int i = 0; i < ppem * ppem; i++)
+        {
+            const bool top = i < ppem * ppem / 2;
+            rgba[i * 4 + 0] = top ? 255 : 0;
+            rgba[i * 4 + 2] = top ? 0 : 255;
+            rgba[i * 4 + 3] = 255;
+        }
+        const auto png = encodePNG(rgba, ppem, ppem);
+        const int ascender = ppem * 13 / 16;
+
+        std::vector<uint8_t> cbdt;
+        appendU32(cbdt, 0x00030000);
+        cbdt.insert(cbdt.end(), { uint8_t(ppem), uint8_t(ppem), 0, uint8_t(ascender), uint8_t(ppem) });
+        appendU32(cbdt, static_cast<uint32_t>(png.size()));
+        cbdt.insert(cbdt.end(), png.begin(), png.end());
+
+        std::vector<uint8_t> cblc;
+        appendU32(cblc, 0x00030000);
+        appendU32(cblc, 1);
+        appendU32(cblc, 8 + 48);    // index subtable array
+        appendU32(cblc, 24);
+        appendU32(cblc, 1);
+        appendU32(cblc, 0);
+        for (int m = 0; m < 2; m++)
+        {
+            cblc.insert(cblc.end(), { uint8_t(ascender), uint8_t(ascender - ppem), uint8_t(ppem), 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+        }
+        appendU16(cblc, 1);
+        appendU16(cblc, 1);
+        cblc.insert(cblc.end(), { uint8_t(ppem), uint8_t(ppem), 32, 1 });
+        appendU16(cblc, 1);         // glyphs 1..1, subtable 8 bytes further
+        appendU16(cblc, 1);
+        appendU32(cblc, 8);
+        appendU16(cblc, 1);         // index format 1, image format 17 (PNG, small metrics)
+        appendU16(cblc, 17);
+        appendU32(cblc, 4);
+        appendU32(cblc, 0);
+        appendU32(cblc, static_cast<uint32_t>(cbdt.size() - 4));
+
+        std::vector<uint8_t> cmap;
+        appendU16s(cmap, { 0, 1, 3, 1 });
+        appendU32(cmap, 12);        // format 4, two segments
+        appendU16s(cmap, { 4, 32, 0, 4, 4, 1, 0, 0x263A, 0xFFFF, 0, 0x263A, 0xFFFF, uint16_t(1 - 0x263A), 1, 0, 0 });
+
+        std::vector<uint8_t> head;
+        appendU32(head, 0x00010000);
+        appendU32(head, 0x00010000);
+        appendU32(head, 0);
+        appendU32(head, 0x5F0F3CF5);
+        appendU16(head, 0x000B);
+        appendU16(head, 2048);
+        head.resize(head.size() + 16);
+        appendU16s(head, { 0, 0, 2048, 2048, 0, 8, 2, 0, 0 });
+
+        std::vector<uint8_t> hhea;
+        appendU32(hhea, 0x00010000);
+        appendU16s(hhea, { 1664, uint16_t(-384), 0, 2048, 0, 0, 2048, 1, 0, 0, 0, 0, 0, 0, 0, 2 });
+        std::vector<uint8_t> hmtx;
+        appendU16s(hmtx, { 2048, 0, 2048, 0 });
+        std::vector<uint8_t> maxp;
+        appendU32(maxp, 0x00005000);
+        appendU16(maxp, 2);
+
+        const std::pair<const char*, std::vector<uint8_t>*> tables[] = {
+            { "CBDT", &cbdt }, { "CBLC", &cblc }, { "cmap", &cmap }, { "head", &head },
+            { "hhea", &hhea }, { "hmtx", &hmtx }, { "maxp", &maxp },
+        };
+        std::vector<uint8_t> font;
+        appendU32(font, 0x00010000);
+        appendU16s(font, { 7, 64, 2, 48 });
+        uint32_t offset = 12 + 16 * 7;
+        for (auto& t : tables)
+        {
+            font.insert(font.end(), t.first, t.first + 4);
+            appendU32(font, 0);
+            appendU32(font, offset);
+            appendU32(font, static_cast<uint32_t>(t.second->size()));
+            offset += (t.second->size() + 3) & ~3u;
+        }
+        for (auto& t : tables)
+        {
+            font.insert(font.end(), t.second->begin(), t.second->end());
+            while (font.size() % 4) font.push_back(0);
+        }
+        return font;
+    }
+}
+
+void test_color_glyphs()
+{
+    // the SIMD box filter matches the scalar one
+    const int sizes[][4] = { { 109, 109, 24, 24 }, { 64, 64, 16, 16 }, { 7, 5, 3, 2 }, { 5, 5, 5, 5 }, { 136, 128, 17, 16 } };
+    for (auto& s : sizes)
+    {
+        std::vector<uint8_t> src(s[0] * s[1] * 4);
+        for (size_t i = 0; i < src.size(); i++)
+        {
+            src[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+        }
+        std::vector<uint8_t> a(s[2] * s[3] * 4), b(a.size());
+        BitmapKernels::downscaleBGRA(src.data(), s[0], s[1], a.data(), s[2], s[3]);
+        BitmapKernels::downscaleBGRAScalar(src.data(), s[0], s[1], b.data(), s[2], s[3]);
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            assert(std::abs(a[i] - b[i]) <= 1);
+        }
+        if (s[0] == s[2] && s[1] == s[3]) assert(a == src);
+    }
+
+    FontFreeType emoji("color.ttf", 16, 0);
+    bool loaded = emoji.loadFont(buildColorFont(64));
+    assert(loaded);
+    assert(FT_HAS_COLOR(emoji.getFTFace()));
+    assert(emoji.getFontAscender() == 13);
+    auto bitmap = emoji.getGlyphBitmap(0x263A);
+    if (!bitmap)
+    {
+        // FreeType built without PNG support
+        printf("color glyphs: skipped\n");
+        return;
+    }
+
+    // the 64 px strike is scaled down once to 16 px, premultiplied BGRA
+    assert(bitmap->getPixelMode() == PixelMode::BGRA8888);
+    assert(bitmap->getWidth() == 16 && bitmap->getHeight() == 16);
+    assert(bitmap->getXAdvance() == 16);
+    auto& data = bitmap->getData();
+    const uint8_t red[] = { 0, 0, 255, 255 }, blue[] = { 255, 0, 0, 255 };
+    assert(memcmp(&data[0], red, 4) == 0 && memcmp(&data[(16 * 16 - 1) * 4], blue, 4) == 0);
+
+    // color glyphs go to BGRA pages next to the A8 frames
+    FontFreeType arial(RESOURCES_DIR "/arial.ttf", 16, 0);
+    loaded = arial.loadFont();
+    assert(loaded);
+    FontAtlas atlas(PixelMode::A8, 128, 128);
+    atlas.init();
+    auto* a = atlas.getOrLoad('a', &arial);
+    auto* smile = atlas.getOrLoad(0x263A, &emoji);
+    assert(a && !a->color && smile && smile->color);
+    assert(atlas.getFrameCount() == 1 && atlas.getColorFrameCount() == 1);
+    assert(smile->textureID == 0 && smile->xAdvance == 16);
+
+    // rich text interleaves mono and color batches in text order
+    const char* path = "color_test.ttf";
+    auto font = buildColorFont(64);
+    FILE* fp = fopen(path, "wb");
+    assert(fp);
+    fwrite(font.data(), 1, font.size(), fp);
+    fclose(fp);
+    {
+        FontCache cache;
+        AttributedString text;
+        TextRunStyle style;
+        style.font = RESOURCES_DIR "/arial.ttf";
+        style.fontSize = 16;
+        style.color = Vec4<uint8_t>(255, 0, 0, 128);
+        TextRunStyle emojiStyle = style;
+        emojiStyle.font = path;
+        text.append("hi ", style);
+        text.append("\xe2\x98\xba\xe2\x98\xba", emojiStyle);
+        text.append(" there", style);
+        RichLabel label(cache);
+        bool ok = label.init(text);
+        assert(ok);
+        auto& batches = label.getBatches();
+        assert(batches.size() == 2 && !batches[0].color && batches[1].color);
+        assert(batches[1].vertexCount == 8);
+        auto& colored = label.getVertices()[batches[1].vertexOffset];
+        assert(colored.color.getX() == 255 && colored.color.getY() == 255 && colored.color.getK() == 128);
+    }
+    remove(path);
+    printf("color glyphs: ok\n");
+}
+
+void test_outline_cache()
+{
+    FontFreeType ttf(RESOURCES_DIR "/arial.ttf", 24, 2);
+    bool loaded = ttf.loadFont();
+    assert(loaded);
+    auto& cache = ttf.getOutlineCache();
+
+    // rendering from the cached outline matches FT_LOAD_RENDER
+    auto fill = ttf.getGlyphBitmap('A');
+    assert(fill && cache.getMisses() == 1 && cache.getHits() == 0);
+    FT_Face face = ttf.getFTFace();
+    assert(!FT_Load_Char(face, 'A', FT_LOAD_RENDER | FT_LOAD_NO_AUTOHINT));
+    assert(fill->getWidth() == static_cast<int>(face->glyph->bitmap.width) && fill->getHeight() == static_cast<int>(face->glyph->bitmap.rows));
+    assert(memcmp(fill->getData().data(), face->glyph->bitmap.buffer, fill->getData().size()) == 0);
+    assert(fill->getXAdvance() == face->glyph->metrics.horiAdvance >> 6);
+
+    // fill, stroke and the glyph index path share one load
+    assert(ttf.getGlyphBitmap('A') && ttf.getGlyphBitmapByIndex(ttf.getGlyphIndex('A')));
+    auto border = ttf.getGlyphOutlineBitmap('A');
+    assert(border && cache.getMisses() == 1 && cache.getHits() == 3);
+    assert(border->getWidth() >= fill->getWidth() + 3 && border->getHeight() >= fill->getHeight() + 3);
+    assert(border->getXAdvance() == fill->getXAdvance());
+
+    // subpixel renderings are hinted differently and cached apart
+    assert(ttf.getGlyphBitmapSubpixel('A', 16) && ttf.getGlyphBitmapSubpixel('A', 32));
+    assert(cache.getMisses() == 2 && cache.getCount() == 2);
+
+    // bounded by bytes, a budget of 0 keeps nothing
+    for (char32_t ch = 'a'; ch <= 'z'; ch++)
+    {
+        ttf.getGlyphBitmap(ch);
+    }
+    assert(cache.getCount() == 28);
+    cache.setMaxBytes(4096);
+    assert(cache.getBytes() <= 4096 && cache.getCount() > 0 && cache.getCount() < 28);
+    cache.setMaxBytes(0);
+    const size_t misses = cache.getMisses();
+    ttf.getGlyphBitmap('z');
+    ttf.getGlyphBitmap('z');
+    assert(cache.getMisses() == misses + 2);
+
+    FontFreeType plain(RESOURCES_DIR "/arial.ttf", 24, 0);
+    loaded = plain.loadFont();
+    assert(loaded && !plain.getGlyphOutlineBitmap('A'));
+    printf("outline cache: ok\n");
+}
+
+void test_atlas_compression()
+{
+    FontFreeType ttf(RESOURCES_DIR "/arial.ttf", 32, 0);
+    bool loaded = ttf.loadFont();
+    assert(loaded);
+    FontAtlas atlas(PixelMode::A8, 128, 128);
+    atlas.init();
+    for (char32_t ch = '!'; ch <= '~'; ch++)
+    {
+        atlas.getOrLoad(ch, &ttf);
+    }
+    assert(atlas.getFrameCount() >= 3);
+
+    // off by default
+    atlas.endLayout();
+    atlas.endLayout();
+    assert(atlas.getCompressedFrameCount() == 0);
+
+#ifdef USE_ZLIB
+    const int full = atlas.getFrameCount() - 1;
+    const size_t resident = atlas.getResidentBytes();
+    std::vector<uint8_t> first(atlas.frameAt(0)->getData(), atlas.frameAt(0)->getData() + atlas.frameAt(0)->getRawBytes());
+
+    // glyphs looked up during the last 2 layouts keep their frame resident
+    atlas.setColdFrameAge(2);
+    auto* letter = atlas.getOrLoad('!', nullptr);
+    assert(letter && letter->textureID == 0);
+    for (int i = 0; i < 3; i++)
+    {
+        atlas.getOrLoad('!', nullptr);
+        atlas.endLayout();
+    }
+    // frame 0 was still resident, looking it up restores nothing
+    auto* hot = atlas.frameAt(0);
+    assert(hot && atlas.getCompressedFrameCount() == full - 1);
+    atlas.endLayout();
+    atlas.endLayout();
+    atlas.endLayout();
+    assert(atlas.getCompressedFrameCount() == full);
+    const size_t compressed = atlas.getResidentBytes();
+    assert(compressed < resident);
+
+    // restored on access, byte for byte
+    auto* frame = atlas.frameAt(0);
+    assert(frame && !frame->isCompressed() && memcmp(frame->getData(), first.data(), first.size()) == 0);
+    assert(atlas.getCompressedFrameCount() == full - 1);
+    printf("atlas compression: %d frames, %zu -> %zu bytes\n", full, resident, compressed);
+#else
+    printf("atlas compression: zlib not available\n");
+#endif
+}
+
+void test_a4_atlas()
+{
+    // every level rounds to the nearest of 16, SIMD and tails match the scalar code
+    std::vector<uint8_t> a8(256), packed(128), simd(128), unpacked(256);
+    for (int v = 0; v < 256; v++) a8[v] = static_cast<uint8_t>(v);
+    BitmapKernels::packA4Scalar(a8.data(), 256, packed.data());
+    BitmapKernels::unpackA4Scalar(packed.data(), 256, unpacked.data());
+    for (int v = 0; v < 256; v++)
+    {
+        assert(unpacked[v] % 17 == 0 && std::abs(unpacked[v] - v) <= 8);
+    }
+    for (int count = 1; count <= 40; count++)
+    {
+        std::fill(simd.begin(), simd.end(), 0);
+        std::fill(packed.begin(), packed.end(), 0);
+        BitmapKernels::packA4(a8.data() + 200 - count, count, simd.data());
+        BitmapKernels::packA4Scalar(a8.data() + 200 - count, count, packed.data());
+        assert(simd == packed);
+        std::vector<uint8_t> fast(count), slow(count);
+        BitmapKernels::unpackA4(packed.data(), count, fast.data());
+        BitmapKernels::unpackA4Scalar(packed.data(), count, slow.data());
+        assert(fast == slow);
+    }
+
+    // half the bytes, the same glyphs within a level
+    FontFreeType ttf(RESOURCES_DIR "/arial.ttf", 15, 0);
+    bool ok = ttf.loadFont();
+    assert(ok);
+    FontAtlas full(PixelMode::A8, 256, 256);
+    FontAtlas nibbles(PixelMode::A4, 256, 256);
+    full.init();
+    nibbles.init();
+    const std::u32string text = U"The quick brown fox\njumps over the lazy dog 0123456789";
+    TextLayoutStyle style;
+    style.lineHeight = ttf.getFontAscender();
+    TextLayoutScratch scratchA8, scratchA4;
+    TextLayout::layoutLines(text, nullptr, &full, &ttf, style, scratchA8.spaces);
+    TextLayout::layoutLines(text, nullptr, &nibbles, &ttf, style, scratchA4.spaces);
+    auto* fullFrame = full.frameAt(0);
+    auto* nibbleFrame = nibbles.frameAt(0);
+    assert(fullFrame && nibbleFrame && nibbleFrame->getRawBytes() * 2 == fullFrame->getRawBytes());
+
+    std::vector<uint8_t> expanded(256 * 256);
+    ok = nibbleFrame->unpackA8(expanded.data());
+    assert(ok);
+    for (char32_t ch : std::u32string(U"Tqgx09"))
+    {
+        auto* a = full.getOrLoad(ch, nullptr);
+        auto* b = nibbles.getOrLoad(ch, nullptr);
+        assert(a && b && a->rect.getWidth() == b->rect.getWidth());
+        const int ax = static_cast<int>(a->texX * 256 + 0.5f), ay = static_cast<int>(a->texY * 256 + 0.5f);
+        const int bx = static_cast<int>(b->texX * 256 + 0.5f), by = static_cast<int>(b->texY * 256 + 0.5f);
+        assert(bx % 2 == 0);
+        for (int y = 0; y < a->rect.getHeight(); y++)
+        {
+            for (int x = 0; x < a->rect.getWidth(); x++)
+            {
+                const int v = fullFrame->getData()[(ay + y) * 256 + ax + x];
+                assert(std::abs(expanded[(by + y) * 256 + bx + x] - v) <= 8);
+            }
+        }
+    }
+
+    // the rasterizer reads A4 pages directly, also glyphs clipped on an odd column
+    TextLayout::alignLines(scratchA8.spaces, style);
+    TextLayout::alignLines(scratchA4.spaces, style);
+    std::vector<uint8_t> imageA8(200 * 60 * 4), imageA4(200 * 60 * 4);
+    BGRAImage image;
+    image.width = 200;
+    image.height = 60;
+    image.stride = 200 * 4;
+    TextRasterizer rasterizer(2);
+    int differ = 0;
+    for (float x : { 100.0f, 37.0f, 38.0f })
+    {
+        std::fill(imageA8.begin(), imageA8.end(), 0);
+        std::fill(imageA4.begin(), imageA4.end(), 0);
+        image.pixels = imageA8.data();
+        ok = rasterizer.draw(scratchA8.spaces, &full, Vec4<uint8_t>(255, 255, 255, 255), image, x, 30);
+        image.pixels = imageA4.data();
+        ok = rasterizer.draw(scratchA4.spaces, &nibbles, Vec4<uint8_t>(255, 255, 255, 255), image, x, 30) && ok;
+        assert(ok);
+        for (size_t i = 0; i < imageA8.size(); i++)
+        {
+            assert(std::abs(imageA8[i] - imageA4[i]) <= 8);
+            if (imageA8[i] != imageA4[i]) differ++;
+        }
+    }
+    printf("a4 atlas: %zu bytes per frame, %d drawn bytes off by a level\n", nibbleFrame->getRawBytes(), differ);
+}
+
+void test_glyph_normalization()
+{
+    FontAtlas atlas(PixelMode::A8, 64, 64);
+    atlas.init();
+
+    // blank borders are cut off, the glyph rect follows the pixels
+    std::vector<uint8_t> pixels(6 * 5, 0);
+    pixels[1 * 6 + 2] = 255;
+    pixels[3 * 6 + 3] = 128;
+    std::vector<uint8_t> copy = pixels;
+    bool ok = atlas.addLetter('x', std::make_shared<GlyphBitmap>(std::move(pixels), 6, 5, Rect(1, -4, 6, 5), 7, PixelMode::A8));
+    assert(ok);
+    auto* x = atlas.getOrLoad('x', nullptr);
+    assert(x && x->rect.getLeft() == 3 && x->rect.getBottom() == -3);
+    assert(x->rect.getWidth() == 2 && x->rect.getHeight() == 3 && x->xAdvance == 7);
+    assert(x->texWidth * 64 == 2 && x->texHeight * 64 == 3);
+    const float occupancy = atlas.getOccupancy();
+
+    // the same pixels share the rect, blank glyphs keep only their metrics
+    ok = atlas.addLetter('y', std::make_shared<GlyphBitmap>(std::move(copy), 6, 5, Rect(0, -5, 6, 5), 8, PixelMode::A8));
+    ok = atlas.addLetter(' ', std::make_shared<GlyphBitmap>(std::vector<uint8_t>(16, 0), 4, 4, Rect(0, -4, 4, 4), 5, PixelMode::A8)) && ok;
+    assert(ok);
+    auto* y = atlas.getOrLoad('y', nullptr);
+    auto* space = atlas.getOrLoad(' ', nullptr);
+    assert(y && y->texX == x->texX && y->texY == x->texY && y->xAdvance == 8 && y->rect.getLeft() == 2);
+    assert(space && space->validate && space->xAdvance == 5 && space->rect.getWidth() == 0 && space->texWidth == 0);
+    assert(atlas.getOccupancy() == occupancy);
+    auto& stats = atlas.getNormalizationStats();
+    assert(stats.trimmedGlyphs == 2 && stats.sharedGlyphs == 1 && stats.emptyGlyphs == 1);
+    assert(stats.savedPixels == 2 * (30 - 6) + 6 + 16);
+
+    // the space advances the cursor without a quad
+    TextLayoutScratch scratch;
+    TextLayoutStyle style;
+    TextLayout::layoutLines(U"x  x", nullptr, &atlas, nullptr, style, scratch.spaces);
+    auto& quads = scratch.spaces._data[0].getQuads();
+    assert(scratch.spaces.quadCount() == 2 && quads.x0[1] - quads.x0[0] == 7 + 2 * 5);
+
+    // Latin and Cyrillic look-alikes are separate glyphs of arial.ttf
+    FontFreeType ttf(RESOURCES_DIR "/arial.ttf", 24, 0);
+    ok = ttf.loadFont();
+    assert(ok);
+    FontAtlas plain(PixelMode::A8, 256, 256);
+    FontAtlas normalized(PixelMode::A8, 256, 256);
+    plain.setNormalization(false);
+    plain.init();
+    normalized.init();
+    const std::u32string latin = U"aceopxyABCEHKMOPTX ";
+    const std::u32string cyrillic = U"асеорхуАВСЕНКМОРТХ ";
+    for (size_t i = 0; i < latin.size(); i++)
+    {
+        for (char32_t ch : { latin[i], cyrillic[i] })
+        {
+            auto* a = plain.getOrLoad(ch, &ttf);
+            auto* b = normalized.getOrLoad(ch, &ttf);
+            assert(a && b && a->xAdvance == b->xAdvance);
+        }
+    }
+    auto& saved = normalized.getNormalizationStats();
+    assert(saved.emptyGlyphs == 1 && saved.sharedGlyphs > 0);
+    assert(normalized.getOccupancy() < plain.getOccupancy());
+    printf("glyph normalization: %zu shared, %zu empty, %zu trimmed, %zu pixels saved\n",
+        saved.sharedGlyphs, saved.emptyGlyphs, saved.trimmedGlyphs, saved.savedPixels);
+}
+
+void test_concurrent_atlas()
+{
+    // readers only ever see published entries, also while the table grows
+    FontLetterMap map;
+    const int count = 5000;
+    std::atomic<int> published(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++)
+    {
+        readers.emplace_back([&, t]() {
+            std::mt19937 rng(t);
+            for (int n = 0; n < count; n = published.load(std::memory_order_acquire))
+            {
+                if (n == 0) continue;
+                const uint64_t key = (rng() % n) | (1ULL << 63);
+                auto* entry = map.find(key);
+                assert(entry && entry->def.xAdvance == static_cast<int>(key & 0xFFFF));
+                assert(!map.find(count + rng() % 100));
+            }
+        });
+    }
+    for (int i = 0; i < count; i++)
+    {
+        FontLetterMap::Entry entry;
+        entry.def.xAdvance = i;
+        map.insert(i | (1ULL << 63), entry);
+        published.store(i + 1, std::memory_order_release);
+    }
+    for (auto& t : readers)
+    {
+        t.join();
+    }
+    assert(map.size() == count);
+
+    // threads laying out in different orders share every glyph
+    FontFreeType ttf(RESOURCES_DIR "/arial.ttf", 20, 0);
+    bool loaded = ttf.loadFont();
+    assert(loaded);
+    FontAtlas atlas(PixelMode::A8, 128, 128);
+    atlas.init();
+    const int threads = 4;
+    std::vector<std::vector<const FontLetterDefinition*>> defs(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]() {
+            std::u32string text;
+            for (char32_t ch = '!'; ch <= '~'; ch++) text += ch;
+            std::shuffle(text.begin(), text.end(), std::mt19937(t));
+            for (int rep = 0; rep < 20; rep++)
+            {
+                for (char32_t ch : text)
+                {
+                    auto* def = atlas.getOrLoad(ch, &ttf);
+                    assert(def && def->validate);
+                }
+            }
+            for (char32_t ch = '!'; ch <= '~'; ch++)
+            {
+                defs[t].push_back(atlas.getOrLoad(ch, nullptr));
+            }
+        });
+    }
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+    assert(atlas.getLetterCount() == '~' - '!' + 1 && atlas.getFrameCount() > 1);
+    FontAtlas serial(PixelMode::A8, 128, 128);
+    serial.init();
+    for (int i = 0; i < static_cast<int>(defs[0].size()); i++)
+    {
+        for (int t = 1; t < threads; t++)
+        {
+            assert(defs[t][i] == defs[0][i]);
+        }
+        auto* expected = serial.getOrLoad(static_cast<char32_t>('!' + i), &ttf);
+        assert(defs[0][i]->xAdvance64 == expected->xAdvance64 && defs[0][i]->rect.getWidth() == expected->rect.getWidth());
+    }
+
+    // frames are restored and compressed under one lock, one layout may end
+    // while another thread reads a frame
+    const int full = atlas.getFrameCount() - 1;
+    std::vector<std::vector<uint8_t>> pixels;
+    for (int i = 0; i < full; i++)
+    {
+        auto* frame = atlas.frameAt(i);
+        pixels.emplace_back(frame->getData(), frame->getData() + frame->getRawBytes());
+    }
+    atlas.setColdFrameAge(1);
+    const int steps = 400;
+    std::atomic<int> reads(0), ended(0);
+    std::thread layouts([&]() {
+        for (int k = 0; k < steps; k++)
+        {
+            while (reads.load(std::memory_order_acquire) < k) std::this_thread::yield();
+            atlas.endLayout();
+            ended.store(k + 1, std::memory_order_release);
+        }
+    });
+    for (int j = 0; j < steps; j++)
+    {
+        while (ended.load(std::memory_order_acquire) < j) std::this_thread::yield();
+        if (j % 4 == 0)
+        {
+            const int idx = (j / 4) % full;
+            auto* frame = atlas.frameAt(idx);
+            assert(frame && memcmp(frame->getData(), pixels[idx].data(), pixels[idx].size()) == 0);
+        }
+        reads.store(j + 1, std::memory_order_release);
+    }
+    layouts.join();
+    printf("concurrent atlas: %zu glyphs in %d frames from %d threads\n", atlas.getLetterCount(), atlas.getFrameCount(), threads);
+}
@@ -0,0 +1,586 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include "BitmapKernels.h"
+#include "Capture.h"
+#include "FontCache.h"
+#include "FontFallbackChain.h"
+#include "Label.h"
+#include "Profiler.h"
+#include "RichText.h"
+#include "StreamingLabel.h"
+#include "TextRasterizer.h"
+#include "TextShaper.h"
+#include "TextLayout.h"
+#include "Utils.h"
+#include "ccUTF8.h"
+
+#include "alloc_counter.h"
+#include "config.h"
+
+void test_layout_no_alloc(const char* font)
+{
+    FontCache cache;
+    FontCacheEntry* entry = cache.get(font, 24, 0);
+    assert(entry);
+
+    std::u32string text;
+    StringUtils::UTF8ToUTF32("The quick brown fox\njumps over\nthe lazy dog. AVAVAV\n0123456789", text);
+
+    TextLayoutStyle style;
+    style.lineHeight = entry->lineHeight;
+    style.alignH = LabelAlignmentH::CENTER;
+
+    TextLayoutScratch scratch;
+    std::vector<C3F_T2F_C4B> vertices;
+
+    auto layout = [&]() {
+        scratch.reset();
+        scratch.kerning.resize(text.length());
+        const int* kerning = entry->font->getHorizontalKerningForUTF32Text(text, scratch.kerning.data()) ? scratch.kerning.data() : nullptr;
+        TextLayout::layoutLines(text, kerning, entry->atlas.get(), entry->font.get(), style, scratch.spaces);
+        TextLayout::alignLines(scratch.spaces, style);
+        vertices.resize(scratch.spaces.quadCount() * 4);
+        return TextLayout::fillVertices(scratch.spaces, vertices.data());
+    };
+
+    // the first rounds fill the atlas and size the arena
+    int expected = layout();
+    layout();
+
+    alloc_counter::begin();
+    for (int i = 0; i < 10; i++)
+    {
+        int count = layout();
+        assert(count == expected);
+    }
+    size_t allocs = alloc_counter::end();
+    printf("layout steady state allocations: %zu, arena: %zu bytes\n", allocs, scratch.arena.capacity());
+    assert(allocs == 0);
+    assert(scratch.arena.blockCount() == 1);
+}
+
+void test_glyph_quads_simd()
+{
+    utils::MonotonicArena arena;
+    GlyphQuads quads(arena);
+    const int count = 10003; // not a multiple of the vector width
+    for (int i = 0; i < count; i++)
+    {
+        float x = (i % 200) * 11.5f;
+        float y = (i / 200) * -24.0f;
+        quads.push(x, y, x + 9.0f, y + 17.0f, i * 0.001f, 0.25f, i * 0.001f + 0.01f, 0.5f);
+    }
+    GlyphQuadKernels::scaleTranslate(quads.x0.data(), quads.size(), 1.0f, -3.25f);
+
+    const Vec4<uint8_t> color(10, 20, 30, 40);
+    std::vector<C3F_T2F_C4B> simd(count * 4), scalar(count * 4);
+    GlyphQuadKernels::expand(quads, 7.0f, -2.5f, 0.5f, color, simd.data());
+    GlyphQuadKernels::expandScalar(quads, 7.0f, -2.5f, 0.5f, color, scalar.data());
+    for (int i = 0; i < count * 4; i++)
+    {
+        assert(simd[i].vertex.getX() == scalar[i].vertex.getX());
+        assert(simd[i].vertex.getY() == scalar[i].vertex.getY());
+        assert(simd[i].texCoord.getX() == scalar[i].texCoord.getX());
+        assert(simd[i].color.getK() == 40);
+    }
+    printf("glyph quads: %d quads expanded\n", count);
+}
+
+void test_rich_label(const char* font, const char* font2)
+{
+    FontCache cache;
+    AttributedString text;
+    TextRunStyle normal;
+    normal.font = font;
+    normal.fontSize = 20;
+    TextRunStyle title = normal;
+    title.fontSize = 36;
+    title.color.set(255, 200, 0, 255);
+    TextRunStyle other = normal;
+    other.font = font2;
+    other.color.set(0, 255, 0, 255);
+
+    text.append("[Guild] ", title);
+    text.append("Alice: ", normal);
+    text.append("\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82\n", other);
+    text.append("second line", normal);
+
+    RichLabel label(cache);
+    bool ok = label.init(text, LabelAlignmentH::CENTER);
+    assert(ok);
+
+    auto& batches = label.getBatches();
+    auto& vertices = label.getVertices();
+    assert(batches.size() == 3);
+    int total = 0;
+    for (auto& b : batches)
+    {
+        assert(b.vertexOffset == total);
+        total += b.vertexCount;
+    }
+    assert(total == vertices.size());
+    assert(vertices.front().color.getY() == 200);
+
+    // no kerning across a carriage return: the pairs are placed as without it
+    float offsets[2];
+    const char* overstrikes[] = { "A\rV", "V\rA" };
+    for (int k = 0; k < 2; k++)
+    {
+        AttributedString overstrike;
+        overstrike.append(overstrikes[k], normal);
+        RichLabel pair(cache);
+        bool ok = pair.init(overstrike, LabelAlignmentH::LEFT);
+        assert(ok && pair.getVertices().size() == 8);
+        offsets[k] = pair.getVertices()[4].vertex.getX() - pair.getVertices()[0].vertex.getX();
+    }
+    assert(offsets[0] + offsets[1] == 0);
+    printf("rich label: %zu batches, %zu vertices, %gx%g\n", batches.size(), vertices.size(), label.getWidth(), label.getHeight());
+}
+
+void test_shaping(const char* font)
+{
+    FontFreeType ft(font, 24, 0);
+    bool ok = ft.loadFont();
+    assert(ok);
+
+    // "abc <hebrew shalom> 123": the hebrew run is drawn right to left, the
+    // number after it is part of the right to left text and comes first
+    std::u32string text;
+    StringUtils::UTF8ToUTF32("abc \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d 123", text);
+
+    TextShaper shaper;
+    auto& runs = shaper.shapeLine(&ft, text, 0, text.length());
+    assert(runs.size() == 3);
+    assert(runs[0]->direction == TextDirection::LTR && runs[0]->script == TextScript::LATIN);
+    assert(runs[1]->direction == TextDirection::LTR && runs[1]->glyphs.size() == 3);
+    assert(runs[2]->direction == TextDirection::RTL && runs[2]->script == TextScript::HEBREW);
+    assert(runs[2]->glyphs.front().cluster == runs[2]->glyphs.size() - 1);
+    assert(shaper.getCacheMisses() == 3);
+
+    // arabic paragraph: runs come in right to left order
+    StringUtils::UTF8ToUTF32("\xd9\x85\xd8\xb1\xd8\xad\xd8\xa8\xd8\xa7 abc", text);
+    auto& rtl = shaper.shapeLine(&ft, text, 0, text.length());
+    assert(rtl.size() == 2);
+    assert(rtl[0]->script == TextScript::LATIN && rtl[1]->script == TextScript::ARABIC);
+
+    shaper.shapeLine(&ft, text, 0, text.length());
+    assert(shaper.getCacheHits() == 2);
+
+    // "<shalom> 12.5% <shalom>": the number keeps its digits left to right
+    // between the two reversed words
+    StringUtils::UTF8ToUTF32("\xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d 12.5% \xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d", text);
+    auto& mixed = shaper.shapeLine(&ft, text, 0, text.length());
+    assert(mixed.size() == 3);
+    assert(mixed[0]->direction == TextDirection::RTL && mixed[2]->direction == TextDirection::RTL);
+    assert(mixed[1]->direction == TextDirection::LTR && mixed[1]->glyphs.size() == 5);
+    const char32_t digits[] = U"12.5%";
+    for (size_t i = 0; i < 5; i++)
+    {
+        assert(mixed[1]->glyphs[i].cluster == i && mixed[1]->glyphs[i].glyphIndex == ft.getGlyphIndex(digits[i]));
+    }
+    // the space after the number belongs to the second word, which is drawn first
+    assert(mixed[0]->glyphs.size() == 5 && mixed[2]->glyphs.size() == 5);
+    assert(mixed[0]->glyphs.back().glyphIndex == ft.getGlyphIndex(' '));
+
+    // shaped latin is spaced like the unshaped layout: hinted advances plus kerning
+    StringUtils::UTF8ToUTF32("AVATAR To", text);
+    auto& latin = shaper.shapeLine(&ft, text, 0, text.length());
+    assert(latin.size() == 1);
+    for (size_t i = 0; i < text.length(); i++)
+    {
+        int expected = ft.getGlyphBitmap(text[i])->getXAdvance();
+        if (i + 1 < text.length()) expected += ft.getHorizontalKerningForChars(text[i], text[i + 1]);
+        assert(latin[0]->glyphs[i].xAdvance == expected);
+    }
+
+    // runs are cached by the identity of the font, not by its address
+    const int advance = latin[0]->glyphs[0].xAdvance;
+    const size_t misses = shaper.getCacheMisses();
+    for (float size : { 48.f, 24.f })
+    {
+        std::unique_ptr<FontFreeType> other(new FontFreeType(font, size, 0));
+        const bool loaded = other->loadFont();
+        assert(loaded);
+        auto& runs = shaper.shapeLine(other.get(), text, 0, text.length());
+        assert((runs[0]->glyphs[0].xAdvance == advance) == (size == 24.f));
+    }
+    assert(shaper.getCacheMisses() == misses + 1);
+    printf("shaping: %zu hits, %zu misses\n", shaper.getCacheHits(), shaper.getCacheMisses());
+}
+
+void test_streaming_label(const char* font)
+{
+    // non-ASCII lines and a small chunk size put sequences across chunk boundaries
+    const int lineCount = 1000;
+    std::string text;
+    for (int i = 0; i < lineCount; i++)
+    {
+        text += "line " + std::to_string(i) + " \xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 AVAV";
+        if (i % 7 == 0) text += "\r";
+        if (i != lineCount - 1) text += "\n";
+    }
+
+    StreamingLabel label(61);
+    std::unique_ptr<utils::TextSource> source(new utils::MemoryTextSource(text.data(), text.length()));
+    bool ok = label.init(font, std::move(source), 24, 0);
+    assert(ok);
+    assert(label.getLineCount() == lineCount);
+
+    FontCache cache;
+    FontCacheEntry* entry = cache.get(font, 24, 0);
+    TextLayoutStyle style;
+    style.lineHeight = entry->lineHeight;
+
+    const size_t windows[][2] = { { 0, 5 }, { 63, 3 }, { 500, 20 }, { 995, 10 }, { 2000, 5 } };
+    for (auto& w : windows)
+    {
+        bool shown = label.setWindow(w[0], w[1]);
+        assert(shown);
+        const size_t first = std::min<size_t>(w[0], lineCount);
+        const size_t last = std::min<size_t>(first + w[1], lineCount);
+
+        // same glyphs as laying out just those lines in memory
+        std::string window;
+        for (size_t i = first; i < last; i++)
+        {
+            window += "line " + std::to_string(i) + " \xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 AVAV\n";
+        }
+        std::u32string u32;
+        bool converted = StringUtils::UTF8ToUTF32(window, u32);
+        assert(converted);
+        TextLayoutScratch scratch;
+        TextLayout::layoutLines(u32, nullptr, entry->atlas.get(), entry->font.get(), style, scratch.spaces);
+        assert(label.getVertices().size() == (size_t)scratch.spaces.quadCount() * 4);
+        assert(label.getFirstLine() == first);
+    }
+
+    // the window does not depend on the position in the document
+    ok = label.setWindow(100, 3);
+    assert(ok);
+    auto a = label.getVertices();
+    ok = label.setWindow(300, 3);
+    assert(ok);
+    auto b = label.getVertices();
+    assert(a.size() == b.size());
+    assert(a[0].vertex.getY() == b[0].vertex.getY());
+
+    std::string invalid = "ok\n\xc0\xaf\n";
+    std::unique_ptr<utils::TextSource> bad(new utils::MemoryTextSource(invalid.data(), invalid.length()));
+    StreamingLabel badLabel;
+    ok = badLabel.init(font, std::move(bad), 24, 0);
+    assert(ok);
+    ok = badLabel.setWindow(0, 1);
+    assert(ok);
+    ok = badLabel.setWindow(0, 2);
+    assert(!ok);
+    printf("streaming label: ok\n");
+}
+
+void test_font_fallback(const char* font, const char* fallback)
+{
+    FontFreeType primary(font, 24, 0);
+    bool ok = primary.loadFont();
+    assert(ok);
+    FontFallbackChain chain(&primary);
+    ok = chain.addFont(fallback, 24, 0);
+    assert(ok);
+    ok = chain.addFont(RESOURCES_DIR "/missing.ttf", 24, 0);
+    assert(!ok);
+    assert(chain.getFontCount() == 2);
+
+    // the fallback face is opened by the first character it has to look up
+    size_t slot = chain.resolve('A');
+    assert(slot == 0 && !chain.getFont(1)->isFaceOpen());
+    slot = chain.resolve(0x41C);                // Cyrillic
+    assert(slot == 1 && chain.getFont(1)->isFaceOpen());
+    slot = chain.resolve(0x3B1);                // Greek
+    assert(slot == 1);
+    slot = chain.resolve(0x4E2D);               // in neither font, the first one draws the box
+    assert(slot == 0);
+    slot = chain.resolve(0x110000);
+    assert(slot == 0);
+    assert(chain.getCacheMemoryUsage() < 4096);
+
+    std::u32string text;
+    ok = StringUtils::UTF8ToUTF32("Hello \xd0\x9c\xd0\xb8\xd1\x80\n\xce\xa9\xce\xbc\xce\xad\xce\xb3\xce\xb1 \xe4\xb8\xad", text);
+    assert(ok);
+
+    FontAtlas atlas(PixelMode::A8, 512, 512);
+    atlas.init();
+    TextLayoutStyle style;
+    style.lineHeight = primary.getFontAscender();
+    TextLayoutScratch scratch;
+    TextLayout::layoutFallbackLines(text, nullptr, &atlas, &chain, style, scratch.spaces);
+    assert(scratch.spaces._data.size() == 2);
+
+    // fallback glyphs are kept apart from the glyphs of the first font
+    FontFreeType other(fallback, 24, 0);
+    ok = other.loadFont();
+    assert(ok);
+    auto* m = chain.getOrLoad(0x41C, &atlas);
+    auto* box = atlas.getOrLoad(0x41C, &primary);
+    assert(m && box && m != box);
+    assert(m->xAdvance == other.getGlyphAdvance(other.getGlyphIndex(0x41C)));
+    auto* h = chain.getOrLoad('H', &atlas);
+    assert(h && h == atlas.getOrLoad('H', nullptr));
+
+    Label label;
+    label.init(font, "Hello \xd0\x9c\xd0\xb8\xd1\x80", 24, 0);
+    auto before = label.getVertices();
+    ok = label.addFallbackFont(fallback);
+    assert(ok);
+    ok = label.addFallbackFont(RESOURCES_DIR "/missing.ttf");
+    assert(!ok);
+    auto after = label.getVertices();
+    assert(before.size() == after.size());
+    assert(before.back().vertex.getX() != after.back().vertex.getX());
+    printf("font fallback: ok\n");
+}
+
+void test_profiler(const char* font)
+{
+    utils::profiler::reset();
+    utils::profiler::startTrace();
+    Label label;
+    label.init(font, "hello hello", 24, 0);
+    utils::profiler::stopTrace();
+    label.setString("hello");
+
+    auto snapshot = utils::profiler::snapshot();
+#ifdef ENABLE_TEXT_PROFILER
+    assert(snapshot.getCounter("atlas.miss") == 5);
+    assert(snapshot.getCounter("atlas.hit") == 6 + 5);
+    assert(snapshot.getCounter("atlas.frame_rollover") == 0);
+    auto* update = snapshot.getTimer("label.update");
+    assert(update && update->count == 2);
+    assert(update->percentileNs(50) <= update->maxNs && update->meanNs() <= update->maxNs);
+    assert(snapshot.getTimer("font.load")->count == 1);
+    assert(snapshot.getTimer("font.glyph_bitmap")->count == 5);
+    // the space has no pixels to append
+    assert(snapshot.getTimer("atlas.append")->count == 4);
+    assert(snapshot.getCounter("atlas.empty") == 1);
+
+    // only the scopes between startTrace() and stopTrace() are traced
+    const char* path = "profiler_trace.json";
+    bool written = utils::profiler::writeChromeTrace(path);
+    assert(written);
+    auto bytes = utils::readFile(path);
+    remove(path);
+    const std::string trace(bytes.begin(), bytes.end());
+    size_t updates = 0;
+    for (size_t p = trace.find("\"label.update\""); p != std::string::npos; p = trace.find("\"label.update\"", p + 1))
+    {
+        updates++;
+    }
+    assert(updates == 1);
+    assert(trace.find("\"atlas.miss\":5") != std::string::npos);
+
+    utils::profiler::reset();
+    assert(utils::profiler::snapshot().getCounter("atlas.miss") == 0);
+    printf("profiler: ok\n");
+#else
+    assert(!snapshot.getTimer("label.update") && snapshot.getCounter("atlas.miss") == 0);
+    printf("profiler: compiled out\n");
+#endif
+}
+
+void test_subpixel_positioning(const char* font)
+{
+    FontFreeType ttf(font, 17, 0);
+    bool loaded = ttf.loadFont();
+    assert(loaded);
+
+    const std::u32string text = U"iiiiiiiiiiiiiiii";
+    std::vector<int> kerning(text.size());
+    ttf.getHorizontalKerningForUTF32Text64(text, kerning.data());
+
+    FontAtlas atlas(PixelMode::A8, 512, 512);
+    atlas.init();
+    TextLayoutStyle style;
+    style.lineHeight = ttf.getFontAscender();
+    style.subpixelBins = 4;
+    TextLayoutScratch scratch;
+    TextLayout::layoutSubpixelLines(text, kerning.data(), &atlas, &ttf, style, scratch.spaces);
+    assert(scratch.spaces._data.size() == 1);
+
+    // one variant per offset the text lands on, rasterized on first use
+    const size_t variants = atlas.getLetterCount();
+    assert(variants > 1 && variants <= 4);
+    for (int bin = 0; bin < 4; bin++)
+    {
+        auto* def = atlas.getOrLoadSubpixel('i', bin * 16, &ttf);
+        assert(def && def->validate);
+    }
+    assert(atlas.getLetterCount() == 4);
+    auto* shifted = atlas.getOrLoadSubpixel('i', 16, &ttf);
+    auto* unshifted = atlas.getOrLoad('i', &ttf);
+    assert(shifted && unshifted && shifted != unshifted);
+
+    // the pen keeps the fractional advances, the run ends within a pixel of
+    // the sum of the 26.6 advances instead of drifting by a rounding per glyph
+    auto* i0 = atlas.getOrLoadSubpixel('i', 0, &ttf);
+    assert(i0->xAdvance64 % 64 != 0);
+    int pen = 0;
+    for (size_t c = 0; c + 1 < text.size(); c++)
+    {
+        pen += kerning[c] + i0->xAdvance64;
+    }
+    pen += kerning.back();
+    const float expected = pen / 64.0f + i0->rect.getWidth();
+    assert(std::abs(scratch.spaces._data[0].getWidth() - expected) <= 1.5f);
+
+    Label label;
+    label.init(font, "iiiiiiiiiiiiiiii\nminimum", 17, 0);
+    auto whole = label.getVertices();
+    label.setSubpixelBins(4);
+    auto sub = label.getVertices();
+    assert(whole.size() == sub.size());
+    printf("subpixel positioning: ok\n");
+}
+
+void test_text_rasterizer(const char* font)
+{
+    // the SIMD kernels round exactly like the scalar ones, including tails
+    uint32_t seed = 7;
+    auto next = [&seed]() { seed = seed * 1103515245 + 12345; return static_cast<uint8_t>(seed >> 16); };
+    const int count = 37;
+    std::vector<uint8_t> mask(count), src(count * 4), simd(count * 4), scalar(count * 4);
+    for (int i = 0; i < count; i++)
+    {
+        mask[i] = i % 5 == 0 ? 0 : (i % 7 == 0 ? 255 : next());
+        const uint8_t a = i % 6 == 0 ? 0 : next();
+        for (int c = 0; c < 3; c++) src[i * 4 + c] = a ? next() % (a + 1) : 0;
+        src[i * 4 + 3] = a;
+        const uint8_t d = next();
+        for (int c = 0; c < 3; c++) simd[i * 4 + c] = next() % (d + 1);
+        simd[i * 4 + 3] = d;
+    }
+    const uint8_t colors[][4] = { { 10, 200, 30, 255 }, { 255, 255, 255, 128 }, { 0, 0, 0, 0 } };
+    for (auto& bgra : colors)
+    {
+        scalar = simd;
+        BitmapKernels::blendMaskBGRA(simd.data(), mask.data(), count, bgra);
+        BitmapKernels::blendMaskBGRAScalar(scalar.data(), mask.data(), count, bgra);
+        assert(simd == scalar);
+        BitmapKernels::blendBGRA(simd.data(), src.data(), count, bgra[3]);
+        BitmapKernels::blendBGRAScalar(scalar.data(), src.data(), count, bgra[3]);
+        assert(simd == scalar);
+        for (int i = 0; i < count; i++) assert(simd[i * 4 + 2] <= simd[i * 4 + 3]);
+    }
+
+    Label label;
+    label.init(font, "Hello World\nAVAVAV 0123456789\nthumbnail text", 24, 0);
+    const int width = 320;
+    const int height = 120;
+    auto render = [&](int threads, bool simdKernels, std::vector<uint8_t>& pixels) {
+        pixels.assign(width * height * 4, 0);
+        BGRAImage image;
+        image.pixels = pixels.data();
+        image.width = width;
+        image.height = height;
+        image.stride = width * 4;
+        TextRasterizer rasterizer(threads);
+        rasterizer.setSIMD(simdKernels);
+        return rasterizer.draw(label, Vec4<uint8_t>(255, 128, 0, 255), image, width / 2.0f, height / 2.0f);
+    };
+
+    std::vector<uint8_t> one, banded, reference;
+    bool ok = render(1, true, one);
+    ok = render(4, true, banded) && ok;
+    ok = render(1, false, reference) && ok;
+    assert(ok);
+    assert(one == banded);
+    assert(one == reference);
+
+    // fully covered pixels carry the text color, everything drawn is premultiplied
+    int covered = 0;
+    int solid = 0;
+    for (int i = 0; i < width * height; i++)
+    {
+        const uint8_t* p = one.data() + i * 4;
+        if (p[3] == 0) continue;
+        covered++;
+        assert(p[0] == 0 && p[1] <= p[3] && p[2] == p[3]);
+        if (p[3] == 255 && p[1] == 128) solid++;
+    }
+    assert(covered > 500 && solid > 100);
+
+    // glyphs partly outside of the image are clipped, the part inside is unchanged
+    std::vector<uint8_t> shifted(width * height * 4, 0);
+    BGRAImage image;
+    image.pixels = shifted.data();
+    image.width = width;
+    image.height = height;
+    image.stride = width * 4;
+    ok = TextRasterizer(3).draw(label, Vec4<uint8_t>(255, 128, 0, 255), image, 0, 0);
+    assert(ok);
+    for (int y = 0; y < height / 2; y++)
+    {
+        assert(memcmp(shifted.data() + y * width * 4, one.data() + ((y + height / 2) * width + width / 2) * 4, width * 2) == 0);
+    }
+    printf("text rasterizer: %d pixels covered, %d solid\n", covered, solid);
+}
+
+void test_capture(const char* font)
+{
+#ifdef ENABLE_INSPECT
+    // nothing is written until a capture is requested or sampled
+    utils::capture::setSampleInterval(0);
+    uint64_t next = utils::capture::sample();
+    assert(next == 0);
+
+    Label label;
+    label.init(font, "capture\nme", 20, 0);
+
+    // ids count up, the label gets the one after this
+    utils::capture::request();
+    const uint64_t id = utils::capture::sample() + 1;
+    assert(id > 1);
+    utils::capture::request();
+    label.setString("captured\ntext");
+    next = utils::capture::sample();
+    assert(next == 0);
+
+    const std::string quadsPath = utils::capture::filePath("label", id, ".quads");
+    const std::string framePath = utils::capture::filePath("label", id, "_frame0.pgm");
+    std::vector<utils::capture::QuadRecord> quads;
+    uint32_t lines = 0;
+    const bool quadsRead = utils::capture::readQuads(quadsPath, quads, lines);
+    assert(quadsRead);
+    assert(lines == 2 && quads.size() * 4 == label.getVertices().size());
+    assert(quads.back().line == 1);
+
+    int width = 0, height = 0, pixelBytes = 0;
+    std::vector<uint8_t> pixels;
+    const bool frameRead = utils::capture::readImage(framePath, width, height, pixelBytes, pixels);
+    assert(frameRead);
+    auto* frame = label.getFontAtlas()->frameAt(0);
+    assert(frame && width == frame->getWidth() && height == frame->getHeight() && pixelBytes == 1);
+    assert(memcmp(pixels.data(), frame->getData(), pixels.size()) == 0);
+
+    // TGA keeps the channel order it was given and the top row first
+    const uint8_t rgb[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+    const bool written = utils::capture::writeTGA("capture_rgb.tga", 2, 2, 3, rgb);
+    const bool read = utils::capture::readImage("capture_rgb.tga", width, height, pixelBytes, pixels);
+    assert(written && read);
+    assert(width == 2 && height == 2 && pixelBytes == 3 && memcmp(pixels.data(), rgb, sizeof(rgb)) == 0);
+    remove(quadsPath.c_str());
+    for (int i = 0; i < label.getFontAtlas()->getFrameCount(); i++)
+    {
+        remove(utils::capture::filePath("label", id, "_frame" + std::to_string(i) + ".pgm").c_str());
+    }
+    remove("capture_rgb.tga");
+
+    utils::capture::setSampleInterval(2);
+    int sampled = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        if (utils::capture::sample()) sampled++;
+    }
+    utils::capture::setSampleInterval(0);
+    assert(sampled == 5);
+    printf("capture: %zu quads, %dx%d frame\n", quads.size(), frame->getWidth(), frame->getHeight());
+#endif
+}
@@ -0,0 +1,300 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "ccUTF8.h"
+#include "ConvertUTF.h"
+
+#include "alloc_counter.h"
+
+namespace {
+    // reference result of the Unicode, Inc. converter
+    bool referenceUTF8ToUTF32(const std::string& in, std::u32string& out)
+    {
+        std::u32string working(in.length(), 0);
+        auto inbeg = reinterpret_cast<const UTF8*>(in.data());
+        auto outbeg = reinterpret_cast<UTF32*>(&working[0]);
+        if (ConvertUTF8toUTF32(&inbeg, inbeg + in.length(), &outbeg, outbeg + working.length(), strictConversion) != conversionOK)
+            return false;
+        working.resize(reinterpret_cast<char32_t*>(outbeg) - &working[0]);
+        out = working;
+        return true;
+    }
+
+    // the range checks the property table replaced
+    bool referenceIsSpace(char32_t ch)
+    {
+        return  (ch >= 0x0009 && ch <= 0x000D) || ch == 0x0020 || ch == 0x0085 || ch == 0x00A0 || ch == 0x1680
+        || (ch >= 0x2000 && ch <= 0x200A) || ch == 0x2028 || ch == 0x2029 || ch == 0x202F
+        ||  ch == 0x205F || ch == 0x3000;
+    }
+
+    bool referenceIsCJK(char32_t ch)
+    {
+        return (ch >= 0x4E00 && ch <= 0x9FBF) || (ch >= 0x2E80 && ch <= 0x2FDF) || (ch >= 0x2FF0 && ch <= 0x30FF)
+            || (ch >= 0x3100 && ch <= 0x31BF) || (ch >= 0xAC00 && ch <= 0xD7AF) || (ch >= 0xF900 && ch <= 0xFAFF)
+            || (ch >= 0xFE30 && ch <= 0xFE4F) || (ch >= 0x31C0 && ch <= 0x4DFF) || (ch >= 0x1f004 && ch <= 0x1f682);
+    }
+
+    bool referenceIsNonBreaking(char32_t ch)
+    {
+        return ch == 0x00A0 || ch == 0x202F || ch == 0x2007 || ch == 0x2060;
+    }
+}
+
+void test_utf8_decode()
+{
+    const char* samples[] = {
+        "hello world, this line is long enough to take the vector path twice over",
+        "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80! mixed with ASCII text of some length",
+        "\xe4\xbd\xa0\xe5\xa5\xbd\xe4\xb8\x96\xe7\x95\x8c 0123456789abcdef \xf0\x9f\x98\x80",
+        "0123456789abcdef0123456789abcdef0123456789abcdef\xc3\xa9",
+        "",
+        // invalid: overlong, surrogate, above U+10FFFF, truncated, stray continuation
+        "abc\xc0\xaf",
+        "0123456789abcdef\xed\xa0\x80",
+        "\xf4\x90\x80\x80",
+        "0123456789abcdef0123456789abcdef\xe4\xbd",
+        "\x80" "abc",
+    };
+
+    for (auto* sample : samples)
+    {
+        std::string in(sample);
+        std::u32string expected, got;
+        bool ok = referenceUTF8ToUTF32(in, expected);
+        bool ret = StringUtils::UTF8ToUTF32(in, got);
+        assert(ret == ok);
+        if (!ok) continue;
+        assert(got == expected);
+        assert(StringUtils::getUTF32LengthOfUTF8(in.data(), in.length()) == (long)expected.length());
+
+        // too small buffer is reported, not overrun
+        if (!expected.empty())
+        {
+            std::u32string small(expected.length() - 1, 0);
+            assert(StringUtils::UTF8ToUTF32(in.data(), in.length(), &small[0], small.length()) == -1);
+        }
+    }
+    printf("utf8 decode: ok\n");
+}
+
+void test_utf8_stream()
+{
+    const std::string text = "ab\xd0\x9f\xd1\x80\xe4\xbd\xa0\xe5\xa5\xbd\xf0\x9f\x98\x80z\n\xc3\xa9";
+    std::u32string expected;
+    bool ok = StringUtils::UTF8ToUTF32(text, expected);
+    assert(ok);
+
+    // every split point, including the middle of each sequence
+    for (size_t cut = 0; cut <= text.length(); cut++)
+    {
+        StringUtils::UTF8StreamDecoder decoder;
+        std::u32string got;
+        assert(decoder.decode(text.data(), cut, got));
+        assert(decoder.decode(text.data() + cut, text.length() - cut, got));
+        assert(decoder.finish());
+        assert(got == expected);
+    }
+
+    // one byte at a time
+    StringUtils::UTF8StreamDecoder decoder;
+    std::u32string got;
+    for (char c : text)
+    {
+        assert(decoder.decode(&c, 1, got));
+    }
+    assert(decoder.finish());
+    assert(got == expected);
+
+    // truncated at the end of the stream, invalid across a boundary
+    got.clear();
+    decoder.reset();
+    assert(decoder.decode("ab\xe4\xbd", 4, got));
+    assert(!decoder.finish());
+    decoder.reset();
+    assert(decoder.decode("\xe4", 1, got));
+    assert(!decoder.decode("a", 1, got));
+    printf("utf8 stream: ok\n");
+}
+
+void test_string_utf8()
+{
+    // the edits are mirrored on a UTF-32 copy
+    const char* pieces[] = { "a", "xyz", "\xd0\x9f", "\xe4\xbd\xa0\xe5\xa5\xbd", "\xf0\x9f\x98\x80", "line\n" };
+    std::string initial;
+    for (int i = 0; i < 300; i++) initial += pieces[i % 6];
+
+    StringUtils::StringUTF8 str(initial);
+    std::u32string model;
+    bool ok = StringUtils::UTF8ToUTF32(initial, model);
+    assert(ok);
+    assert(str.length() == model.length());
+
+    std::mt19937 rng(7);
+    size_t cursor = model.length() / 2;
+    for (int step = 0; step < 5000; step++)
+    {
+        // mostly edits around a cursor, sometimes a jump
+        if (rng() % 16 == 0) cursor = rng() % (model.length() + 1);
+        const int op = rng() % 4;
+        if (op == 0 && cursor > 0)
+        {
+            cursor--;
+            ok = str.deleteChar(cursor);
+            assert(ok);
+            model.erase(cursor, 1);
+        }
+        else if (op == 1 && cursor < model.length())
+        {
+            ok = str.deleteChar(cursor);
+            assert(ok);
+            model.erase(cursor, 1);
+        }
+        else
+        {
+            const char* piece = pieces[rng() % 6];
+            std::u32string u32;
+            StringUtils::UTF8ToUTF32(piece, u32);
+            ok = str.insert(cursor, piece);
+            assert(ok);
+            model.insert(cursor, u32);
+            cursor += u32.length();
+        }
+        assert(str.length() == model.length());
+
+        if (step % 97 == 0)
+        {
+            std::string expected;
+            StringUtils::UTF32ToUTF8(model, expected);
+            assert(str.getAsCharSequence() == expected);
+            const size_t pos = rng() % (model.length() + 1);
+            std::string part;
+            StringUtils::UTF32ToUTF8(model.substr(pos, 100), part);
+            assert(str.getAsCharSequence(pos, 100) == part);
+        }
+        const size_t probe = rng() % (model.length() + 1);
+        assert(str.getCharAt(probe) == (probe < model.length() ? model[probe] : 0));
+    }
+
+    ok = str.deleteChar(str.length());
+    assert(!ok);
+    ok = str.insert(str.length() + 1, "a");
+    assert(!ok);
+    ok = str.insert(0, "\xc0\xaf");
+    assert(!ok);
+
+    StringUtils::StringUTF8 other("\xd0\x9f-");
+    ok = str.insert(3, other);
+    assert(ok);
+    model.insert(3, U"\u041f-");
+    ok = str.insert(0, str);
+    assert(ok);
+    model = model + model;
+    std::string expected;
+    StringUtils::UTF32ToUTF8(model, expected);
+    assert(str.getAsCharSequence() == expected);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    auto chars = other.getString();
+#pragma GCC diagnostic pop
+    assert(chars.size() == 2 && chars[0]._char == "\xd0\x9f" && !chars[0].isASCII() && chars[1].isASCII());
+    printf("string utf8: ok\n");
+}
+
+void test_unicode_properties()
+{
+    using StringUtils::LineBreakClass;
+
+    for (char32_t ch = 0; ch <= 0x110010; ch++)
+    {
+        assert(StringUtils::isUnicodeSpace(ch) == referenceIsSpace(ch));
+        assert(StringUtils::isCJKUnicode(ch) == referenceIsCJK(ch));
+        assert(StringUtils::isUnicodeNonBreaking(ch) == referenceIsNonBreaking(ch));
+    }
+    assert(StringUtils::getUnicodeProperties(0xFFFFFFFF) == 0);
+
+    std::u32string text = U"a b\n\u4e2d(x)-\u00a0\u0301\u3002";
+    const LineBreakClass expected[] = {
+        LineBreakClass::OTHER, LineBreakClass::SPACE, LineBreakClass::OTHER, LineBreakClass::MANDATORY,
+        LineBreakClass::IDEOGRAPHIC, LineBreakClass::OPEN, LineBreakClass::OTHER, LineBreakClass::CLOSE,
+        LineBreakClass::BREAK_AFTER, LineBreakClass::GLUE, LineBreakClass::COMBINING, LineBreakClass::CLOSE,
+    };
+    std::vector<uint16_t> props;
+    StringUtils::getUnicodeProperties(text, props);
+    assert(props.size() == text.length());
+    for (size_t i = 0; i < text.length(); i++)
+    {
+        assert(props[i] == StringUtils::getUnicodeProperties(text[i]));
+        assert(StringUtils::getLineBreakClass(props[i]) == expected[i]);
+    }
+    assert(props[10] & StringUtils::UnicodeProperty::Combining);
+    assert(props[11] & StringUtils::UnicodeProperty::CJK);
+    printf("unicode properties: ok\n");
+}
+
+void test_utf_conversions_no_alloc()
+{
+    const std::string utf8 = "Score: 12345 \xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \xe4\xbd\xa0\xe5\xa5\xbd \xf0\x9f\x98\x80";
+    std::u16string utf16;
+    std::u32string utf32;
+    bool ok = StringUtils::UTF8ToUTF16(utf8, utf16) && StringUtils::UTF8ToUTF32(utf8, utf32);
+    assert(ok);
+
+    // exact lengths
+    assert(StringUtils::getUTF16LengthOfUTF8(utf8.data(), utf8.length()) == (long)utf16.length());
+    assert(StringUtils::getUTF8LengthOfUTF16(utf16.data(), utf16.length()) == (long)utf8.length());
+    assert(StringUtils::getUTF32LengthOfUTF16(utf16.data(), utf16.length()) == (long)utf32.length());
+    assert(StringUtils::getUTF8LengthOfUTF32(utf32.data(), utf32.length()) == (long)utf8.length());
+    assert(StringUtils::getUTF16LengthOfUTF32(utf32.data(), utf32.length()) == (long)utf16.length());
+
+    // invalid input: lone surrogate, out of range code point
+    const char16_t lone[] = { u'a', 0xD800 };
+    const char32_t big[] = { U'a', 0x110000 };
+    assert(StringUtils::getUTF8LengthOfUTF16(lone, 2) == -1);
+    assert(StringUtils::getUTF32LengthOfUTF16(lone, 2) == -1);
+    assert(StringUtils::getUTF8LengthOfUTF32(big, 2) == -1);
+    assert(StringUtils::getUTF16LengthOfUTF32(big, 2) == -1);
+
+    // a too small buffer is reported, not overrun
+    char16_t small16[4];
+    assert(StringUtils::UTF8ToUTF16(utf8.data(), utf8.length(), small16, 4) == -1);
+
+    char buffer8[256];
+    char16_t buffer16[256];
+    char32_t buffer32[256];
+    std::string out8;
+    std::u16string out16;
+    std::u32string out32;
+    out8.reserve(256);
+    out16.reserve(256);
+    out32.reserve(256);
+
+    alloc_counter::begin();
+    for (int i = 0; i < 100; i++)
+    {
+        long n16 = StringUtils::UTF8ToUTF16(utf8.data(), utf8.length(), buffer16, 256);
+        long n32 = StringUtils::UTF16ToUTF32(buffer16, n16, buffer32, 256);
+        long n8 = StringUtils::UTF32ToUTF8(buffer32, n32, buffer8, 256);
+        assert(n8 == (long)utf8.length() && memcmp(buffer8, utf8.data(), n8) == 0);
+        assert(StringUtils::UTF32ToUTF16(buffer32, n32, buffer16, 256) == n16);
+        assert(StringUtils::UTF16ToUTF8(buffer16, n16, buffer8, 256) == n8);
+        assert(StringUtils::UTF8ToUTF32(utf8.data(), utf8.length(), buffer32, 256) == n32);
+
+        // reused strings keep their capacity
+        ok = StringUtils::UTF8ToUTF16(utf8, out16)
+            && StringUtils::UTF16ToUTF32(out16, out32)
+            && StringUtils::UTF32ToUTF8(out32, out8)
+            && StringUtils::UTF8ToUTF32(out8, out32)
+            && StringUtils::UTF32ToUTF16(out32, out16)
+            && StringUtils::UTF16ToUTF8(out16, out8);
+        assert(ok);
+    }
+    size_t allocs = alloc_counter::end();
+    assert(out8 == utf8 && out16 == utf16 && out32 == utf32);
+    printf("utf conversions allocations: %zu\n", allocs);
+    assert(allocs == 0);
+}
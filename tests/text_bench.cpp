@@ -0,0 +1,680 @@
+/*
+ * text_bench: benchmarks of the text pipeline over the bundled fonts.
+ *
+ * usage: text_bench [--json file] [--warmup n] [--reps n] [--filter text]
+ *                   [--features] [--font file] [--trace file]
+ *
+ * Every benchmark is run `warmup` times, then timed `reps` times. The table
+ * and the JSON report give the mean, min, max and the 50th, 90th and 99th
+ * percentile of the per repetition values. --features also runs the
+ * benchmarks of the individual optimizations in bench_text.cpp. --trace
+ * writes the profiler scopes as a Chrome trace and prints the profiler
+ * counters, it needs a build with ENABLE_TEXT_PROFILER.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BitmapKernels.h"
+#include "FontAtlas.h"
+#include "FontFreetype.h"
+#include "Label.h"
+#include "Profiler.h"
+#include "TextRasterizer.h"
+#include "ccUTF8.h"
+
+#include "bench.h"
+#include "config.h"
+
+void bench_shaping(bench::Report& report, const char* font);
+void bench_utf8(bench::Report& report);
+void bench_streaming(bench::Report& report, const char* font);
+void bench_string_utf8(bench::Report& report);
+void bench_unicode_properties(bench::Report& report);
+void bench_font_registration(bench::Report& report);
+void bench_font_fallback(bench::Report& report);
+
+using bench::Options;
+using bench::Report;
+using bench::repeatToSize;
+
+namespace {
+
+    const char* FONTS[] = {
+        "arial.ttf",
+        "Courier New.ttf",
+        "American Typewriter.ttf",
+        "A Damn Mess.ttf",
+        "Abberancy.ttf",
+        "Fingerpop.ttf",
+        "cyril.ttf",
+        "cyrillic.ttf",
+    };
+    const float SIZES[] = { 12, 24, 48 };
+
+    double mean(const std::vector<double>& values)
+    {
+        double sum = 0;
+        for (double v : values) sum += v;
+        return values.empty() ? 0 : sum / values.size();
+    }
+
+    std::string quote(const std::string& s)
+    {
+        std::string ret = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\') ret += '\\';
+            ret += c;
+        }
+        return ret + "\"";
+    }
+}
+
+namespace bench
+{
+    void Report::flush()
+    {
+        for (; _printed < _results.size(); _printed++)
+        {
+            auto& r = _results[_printed];
+            printf("%-32s %12.3f %-12s mean %12.3f  min %12.3f  p90 %12.3f  p99 %12.3f  max %12.3f",
+                r.name.c_str(), bench::percentile(r.values, 50), r.unit.c_str(), mean(r.values),
+                r.values.front(), bench::percentile(r.values, 90), bench::percentile(r.values, 99), r.values.back());
+            for (auto& m : r.metrics)
+            {
+                printf("  %s %g", m.first.c_str(), m.second);
+            }
+            printf("\n");
+        }
+    }
+
+    bool Report::writeJSON(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out) return false;
+        out.precision(9);
+
+#if defined(__AVX2__)
+        const char* simd = "avx2";
+#elif defined(__SSE2__) || defined(_M_X64)
+        const char* simd = "sse2";
+#elif defined(__ARM_NEON)
+        const char* simd = "neon";
+#else
+        const char* simd = "none";
+#endif
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && defined(NDEBUG))
+        const bool optimized = true;
+#else
+        const bool optimized = false;
+#endif
+        out << "{\n  \"suite\": \"text_bench\",\n  \"config\": {";
+        out << "\"warmup\": " << _options.warmup << ", \"repetitions\": " << _options.reps;
+        out << ", \"freetype\": \"" << FREETYPE_MAJOR << "." << FREETYPE_MINOR << "." << FREETYPE_PATCH << "\"";
+        out << ", \"simd\": \"" << simd << "\", \"optimized\": " << (optimized ? "true" : "false") << "},\n";
+        out << "  \"results\": [";
+        for (size_t i = 0; i < _results.size(); i++)
+        {
+            auto& r = _results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": " << quote(r.name) << ", \"unit\": " << quote(r.unit);
+            out << ", \"mean\": " << mean(r.values) << ", \"min\": " << r.values.front();
+            out << ", \"p50\": " << bench::percentile(r.values, 50) << ", \"p90\": " << bench::percentile(r.values, 90);
+            out << ", \"p99\": " << bench::percentile(r.values, 99) << ", \"max\": " << r.values.back();
+            for (auto& m : r.metrics)
+            {
+                out << ", " << quote(m.first) << ": " << m.second;
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+}
+
+namespace {
+
+    std::string fontPath(const char* font)
+    {
+        return std::string(RESOURCES_DIR "/") + font;
+    }
+
+    std::string fontStem(const char* font)
+    {
+        std::string stem = font;
+        return stem.substr(0, stem.rfind('.'));
+    }
+
+    void benchRaster(Report& report)
+    {
+        for (auto font : FONTS)
+        {
+            for (float size : SIZES)
+            {
+                const std::string name = "raster/" + fontStem(font) + "/" + std::to_string(static_cast<int>(size));
+                if (!report.enabled(name)) continue;
+
+                FontFreeType ttf(fontPath(font), size, 0);
+                if (!ttf.loadFont()) continue;
+                const int glyphs = '~' - '!' + 1;
+                report.run(name, "ns/glyph", [&]() {
+                    for (char32_t ch = '!'; ch <= '~'; ch++)
+                    {
+                        ttf.getGlyphBitmap(ch);
+                    }
+                }, [&](double ns) { return ns / glyphs; });
+            }
+        }
+    }
+
+    void benchLCD(Report& report)
+    {
+        // small UI sizes, LCD rendering against gray levels of the same size
+        const float sizes[] = { 10, 12, 14 };
+        for (float size : sizes)
+        {
+            for (bool lcd : { false, true })
+            {
+                const std::string name = std::string(lcd ? "lcd" : "gray") + "/arial/" + std::to_string(static_cast<int>(size));
+                if (!report.enabled(name)) continue;
+
+                FontFreeType ttf(fontPath("arial.ttf"), size, 0);
+                if (!ttf.loadFont()) continue;
+                ttf.setLCDRendering(lcd);
+                const int glyphs = '~' - '!' + 1;
+                int frames = 0;
+                float occupancy = 0;
+                auto& result = report.run(name, "ns/glyph", [&]() {
+                    FontAtlas atlas(ttf.getPixelMode(), 256, 256);
+                    atlas.init();
+                    for (char32_t ch = '!'; ch <= '~'; ch++)
+                    {
+                        atlas.getOrLoad(ch, &ttf);
+                    }
+                    frames = atlas.getFrameCount();
+                    occupancy = atlas.getOccupancy();
+                }, [&](double ns) { return ns / glyphs; });
+                result.metrics.emplace_back("atlas_bytes", frames * 256.0 * 256 * PixelModeSize(ttf.getPixelMode()));
+                result.metrics.emplace_back("occupancy", occupancy);
+            }
+        }
+    }
+
+    void benchAtlas(Report& report)
+    {
+        for (auto font : FONTS)
+        {
+            const std::string name = "atlas/" + fontStem(font);
+            if (!report.enabled(name)) continue;
+
+            // ASCII, Latin-1 and Cyrillic as far as the font has them
+            FontFreeType ttf(fontPath(font), 24, 0);
+            if (!ttf.loadFont()) continue;
+            std::vector<std::pair<char32_t, std::shared_ptr<GlyphBitmap>>> bitmaps;
+            auto addRange = [&](char32_t first, char32_t last) {
+                for (char32_t ch = first; ch <= last; ch++)
+                {
+                    if (!ttf.getGlyphIndex(ch)) continue;
+                    auto bitmap = ttf.getGlyphBitmap(ch);
+                    if (bitmap) bitmaps.emplace_back(ch, bitmap);
+                }
+            };
+            addRange('!', '~');
+            addRange(0xA1, 0xFF);
+            addRange(0x410, 0x44F);
+
+            const int width = 256, height = 256;
+            int frames = 0;
+            GlyphNormalizationStats normalization;
+            auto& result = report.run(name, "ns/glyph", [&]() {
+                FontAtlas atlas(PixelMode::A8, width, height);
+                atlas.init();
+                for (auto& it : bitmaps)
+                {
+                    atlas.addLetter(it.first, it.second);
+                }
+                frames = atlas.getFrameCount();
+                normalization = atlas.getNormalizationStats();
+            }, [&](double ns) { return ns / bitmaps.size(); });
+
+            double area = 0;
+            for (auto& it : bitmaps)
+            {
+                area += it.second->getWidth() * it.second->getHeight();
+            }
+            area -= normalization.savedPixels;
+            result.metrics.emplace_back("glyphs", static_cast<double>(bitmaps.size()));
+            result.metrics.emplace_back("frames", frames);
+            result.metrics.emplace_back("occupancy", area / (static_cast<double>(frames) * width * height));
+            result.metrics.emplace_back("shared", static_cast<double>(normalization.sharedGlyphs));
+            result.metrics.emplace_back("empty", static_cast<double>(normalization.emptyGlyphs));
+            result.metrics.emplace_back("saved_pixels", static_cast<double>(normalization.savedPixels));
+        }
+    }
+
+    void benchColdFrames(Report& report)
+    {
+#ifdef USE_ZLIB
+        for (auto font : FONTS)
+        {
+            const std::string name = "atlas_cold/" + fontStem(font);
+            if (!report.enabled(name)) continue;
+
+            // the full 256 x 256 frames of ASCII, Latin-1 and Cyrillic at 24 px
+            FontFreeType ttf(fontPath(font), 24, 0);
+            if (!ttf.loadFont()) continue;
+            FontAtlas atlas(PixelMode::A8, 256, 256);
+            atlas.init();
+            for (char32_t ch = '!'; ch <= 0x44F; ch++)
+            {
+                if (ch == 0x100) ch = 0x410;
+                if (ttf.getGlyphIndex(ch)) atlas.getOrLoad(ch, &ttf);
+            }
+            const int frames = atlas.getFrameCount() - 1;
+            if (frames < 1) continue;
+
+            uint64_t deflateNs = 0, inflateNs = 0, roundtrips = 0;
+            auto& result = report.run(name, "us/frame", [&]() {
+                for (int i = 0; i < frames; i++)
+                {
+                    auto* frame = atlas.frameAt(i);
+                    const uint64_t start = utils::profiler::nowNs();
+                    frame->compress();
+                    const uint64_t mid = utils::profiler::nowNs();
+                    frame->decompress();
+                    deflateNs += mid - start;
+                    inflateNs += utils::profiler::nowNs() - mid;
+                    roundtrips++;
+                }
+            }, [&](double ns) { return ns / 1e3 / frames; });
+
+            size_t raw = 0, compressed = 0;
+            for (int i = 0; i < frames; i++)
+            {
+                auto* frame = atlas.frameAt(i);
+                raw += frame->getRawBytes();
+                frame->compress();
+                compressed += frame->getResidentBytes();
+            }
+            result.metrics.emplace_back("frames", frames);
+            result.metrics.emplace_back("ratio", static_cast<double>(raw) / compressed);
+            result.metrics.emplace_back("deflate_us", deflateNs / 1e3 / roundtrips);
+            result.metrics.emplace_back("inflate_us", inflateNs / 1e3 / roundtrips);
+        }
+#endif
+    }
+
+    void benchA4(Report& report)
+    {
+        // one 512 x 512 frame of glyph-like coverage, quantized on insert and
+        // expanded again on upload
+        const int width = 512, height = 512;
+        std::vector<uint8_t> a8(width * height), a4(width * height / 2), out(width * height);
+        for (size_t i = 0; i < a8.size(); i++)
+        {
+            a8[i] = (i % 13) < 5 ? 0 : static_cast<uint8_t>((i * 2654435761u) >> 24);
+        }
+        for (bool pack : { true, false })
+        {
+            for (bool simd : { true, false })
+            {
+                const std::string name = std::string("a4/") + (pack ? "pack" : "unpack") + "/" + (simd ? "simd" : "scalar");
+                if (!report.enabled(name)) continue;
+
+                report.run(name, "GB/s", [&]() {
+                    if (pack && simd) BitmapKernels::packA4(a8.data(), width * height, a4.data());
+                    else if (pack) BitmapKernels::packA4Scalar(a8.data(), width * height, a4.data());
+                    else if (simd) BitmapKernels::unpackA4(a4.data(), width * height, out.data());
+                    else BitmapKernels::unpackA4Scalar(a4.data(), width * height, out.data());
+                }, [&](double ns) { return width * height / ns; });
+            }
+        }
+    }
+
+    void benchAtlasLookup(Report& report)
+    {
+        // hits on a warm atlas shared by all threads, the text pattern of a
+        // parallel layout
+        FontFreeType ttf(fontPath("arial.ttf"), 24, 0);
+        if (!ttf.loadFont()) return;
+        FontAtlas atlas(PixelMode::A8, 512, 512);
+        atlas.init();
+        std::u32string text;
+        while (text.size() < 4096)
+        {
+            text += U"Player 42 joined the game, score 12345 / 67890! \u0421\u0447\u0451\u0442 ";
+        }
+        for (char32_t ch : text)
+        {
+            atlas.getOrLoad(ch, &ttf);
+        }
+
+        const int lookups = 1 << 20;
+        for (int threads : { 1, 2, 4, 8 })
+        {
+            const std::string name = "atlas_lookup/threads=" + std::to_string(threads);
+            if (!report.enabled(name)) continue;
+
+            auto lookup = [&](int t) {
+                for (int i = 0; i < lookups; i++)
+                {
+                    atlas.getOrLoad(text[(i + t * 997) & 4095], &ttf);
+                }
+            };
+            auto& result = report.run(name, "Mlookups/s", [&]() {
+                std::vector<std::thread> workers;
+                for (int t = 1; t < threads; t++)
+                {
+                    workers.emplace_back(lookup, t);
+                }
+                lookup(0);
+                for (auto& w : workers)
+                {
+                    w.join();
+                }
+            }, [&](double ns) { return static_cast<double>(lookups) * threads / ns * 1e3; });
+
+            result.metrics.emplace_back("threads", threads);
+            result.metrics.emplace_back("hardware_threads", std::thread::hardware_concurrency());
+            result.metrics.emplace_back("glyphs", static_cast<double>(atlas.getLetterCount()));
+        }
+    }
+
+    void benchSubpixel(Report& report)
+    {
+        // the cost of every bin count is a cold atlas, later layouts are lookups
+        std::u32string text;
+        while (text.size() < 1000)
+        {
+            text += U"Player 42 joined the game, score 12345 / 67890!\n";
+        }
+        text.resize(1000);
+
+        for (float size : SIZES)
+        {
+            for (int bins = 1; bins <= 4; bins++)
+            {
+                const std::string name = "subpixel/arial/" + std::to_string(static_cast<int>(size)) + "/bins=" + std::to_string(bins);
+                if (!report.enabled(name)) continue;
+
+                FontFreeType ttf(fontPath("arial.ttf"), size, 0);
+                if (!ttf.loadFont()) continue;
+                std::vector<int> kerning(text.size());
+                ttf.getHorizontalKerningForUTF32Text64(text, kerning.data());
+                TextLayoutStyle style;
+                style.lineHeight = ttf.getFontAscender();
+                style.subpixelBins = bins;
+
+                const int width = 256, height = 256;
+                size_t glyphs = 0;
+                int frames = 0;
+                float occupancy = 0;
+                auto& result = report.run(name, "us/1k chars", [&]() {
+                    FontAtlas atlas(PixelMode::A8, width, height);
+                    atlas.init();
+                    TextLayoutScratch scratch;
+                    TextLayout::layoutSubpixelLines(text, kerning.data(), &atlas, &ttf, style, scratch.spaces);
+                    glyphs = atlas.getLetterCount();
+                    frames = atlas.getFrameCount();
+                    occupancy = atlas.getOccupancy();
+                }, [&](double ns) { return ns / 1000.0 / (text.size() / 1000.0); });
+
+                result.metrics.emplace_back("glyphs", static_cast<double>(glyphs));
+                result.metrics.emplace_back("frames", frames);
+                result.metrics.emplace_back("occupancy", occupancy);
+            }
+        }
+    }
+
+    void benchDownscale(Report& report)
+    {
+        // a 136 x 128 emoji strike scaled down once per glyph insert
+        const int sizes[] = { 16, 24, 48 };
+        std::vector<uint8_t> src(136 * 128 * 4);
+        for (size_t i = 0; i < src.size(); i++)
+        {
+            src[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+        }
+        for (int size : sizes)
+        {
+            for (bool simd : { true, false })
+            {
+                const std::string name = std::string("downscale/") + (simd ? "simd" : "scalar") + "/" + std::to_string(size);
+                if (!report.enabled(name)) continue;
+
+                const int width = size * 136 / 128;
+                std::vector<uint8_t> dst(width * size * 4);
+                report.run(name, "ns/glyph", [&]() {
+                    if (simd) BitmapKernels::downscaleBGRA(src.data(), 136, 128, dst.data(), width, size);
+                    else BitmapKernels::downscaleBGRAScalar(src.data(), 136, 128, dst.data(), width, size);
+                }, [](double ns) { return ns; });
+            }
+        }
+    }
+
+    void benchOutlineCache(Report& report)
+    {
+        // three styles of every glyph: fill, 2 px stroke and a subpixel variant
+        for (float size : SIZES)
+        {
+            for (bool cached : { false, true })
+            {
+                const std::string name = std::string("outline_cache/") + (cached ? "cached" : "uncached") + "/arial/" + std::to_string(static_cast<int>(size));
+                if (!report.enabled(name)) continue;
+
+                FontFreeType ttf(fontPath("arial.ttf"), size, 2);
+                if (!ttf.loadFont()) continue;
+                auto& cache = ttf.getOutlineCache();
+                cache.setMaxBytes(cached ? 1 << 20 : 0);
+                const int glyphs = '~' - '!' + 1;
+                auto& result = report.run(name, "ns/glyph", [&]() {
+                    for (char32_t ch = '!'; ch <= '~'; ch++)
+                    {
+                        ttf.getGlyphBitmap(ch);
+                        ttf.getGlyphOutlineBitmap(ch);
+                        ttf.getGlyphBitmapSubpixel(ch, 32);
+                    }
+                }, [&](double ns) { return ns / glyphs; });
+                result.metrics.emplace_back("cache_bytes", static_cast<double>(cache.getBytes()));
+            }
+        }
+    }
+
+    void benchRasterizer(Report& report)
+    {
+        // a 1000 character thumbnail, 21 lines of 24 px text
+        std::string text;
+        while (text.size() < 1000)
+        {
+            text += "Player 42 joined the game, score 12345 / 67890!\n";
+        }
+        text.resize(1000);
+
+        Label label;
+        if (!label.init(fontPath("arial.ttf"), text, 24, 0)) return;
+        const int width = 1024;
+        const int height = 640;
+        std::vector<uint8_t> pixels(width * height * 4);
+        BGRAImage image;
+        image.pixels = pixels.data();
+        image.width = width;
+        image.height = height;
+        image.stride = width * 4;
+
+        const std::pair<bool, int> variants[] = { { false, 1 }, { true, 1 }, { true, 2 }, { true, 4 } };
+        for (auto& v : variants)
+        {
+            const std::string name = std::string("rasterizer/") + (v.first ? "simd" : "scalar") + "/threads=" + std::to_string(v.second);
+            if (!report.enabled(name)) continue;
+
+            TextRasterizer rasterizer(v.second);
+            rasterizer.setSIMD(v.first);
+            // drawn over the previous repetition, blending costs the same
+            report.run(name, "us/image", [&]() {
+                rasterizer.draw(label, Vec4<uint8_t>(255, 255, 255, 255), image, width / 2.0f, height / 2.0f);
+            }, [](double ns) { return ns / 1e3; });
+        }
+    }
+
+    void benchKerning(Report& report)
+    {
+        const std::string text = "AVAWATAYToVaWaYoLTPAFAyLVvWwYyTeTaFo The quick brown fox jumps over the lazy dog 0123456789";
+        for (auto font : FONTS)
+        {
+            const std::string name = "kerning/" + fontStem(font);
+            if (!report.enabled(name)) continue;
+
+            FontFreeType ttf(fontPath(font), 24, 0);
+            if (!ttf.loadFont()) continue;
+            const int pairs = static_cast<int>(text.size()) - 1;
+            int sum = 0;
+            report.run(name, "lookups/s", [&]() {
+                for (int i = 0; i < pairs; i++)
+                {
+                    sum += ttf.getHorizontalKerningForChars(text[i], text[i + 1]);
+                }
+            }, [&](double ns) { return pairs / ns * 1e9; });
+        }
+    }
+
+    void benchUTF8(Report& report)
+    {
+        const std::pair<const char*, std::string> texts[] = {
+            { "utf8/ascii", repeatToSize("The quick brown fox jumps over the lazy dog. 0123456789\n", 1 << 20) },
+            { "utf8/cyrillic", repeatToSize("\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 \xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85 \xd0\xb1\xd1\x83\xd0\xbb\xd0\xbe\xd0\xba\n", 1 << 20) },
+            { "utf8/cjk", repeatToSize("\xe6\x95\x8f\xe6\x8d\xb7\xe7\x9a\x84\xe6\xa3\x95\xe8\x89\xb2\xe7\x8b\x90\xe7\x8b\xb8\xe8\xb7\xb3\xe8\xbf\x87\xe4\xba\x86\xe6\x87\x92\xe7\x8b\x97\n", 1 << 20) },
+            { "utf8/mixed", repeatToSize("Score: 120 \xd0\xbe\xd1\x87\xd0\xba\xd0\xbe\xd0\xb2 \xe5\xbe\x97\xe5\x88\x86 \xf0\x9f\x8f\x86\n", 1 << 20) },
+        };
+        std::vector<char32_t> out(1 << 20);
+        for (auto& t : texts)
+        {
+            if (!report.enabled(t.first)) continue;
+            const std::string& text = t.second;
+            report.run(t.first, "GB/s", [&]() {
+                StringUtils::UTF8ToUTF32(text.data(), text.size(), out.data(), out.size());
+            }, [&](double ns) { return text.size() / ns; });
+        }
+    }
+
+    void benchLabel(Report& report)
+    {
+        // 1000 characters on 21 lines
+        std::string text;
+        while (text.size() < 1000)
+        {
+            text += "Player 42 joined the game, score 12345 / 67890!\n";
+        }
+        text.resize(1000);
+
+        const char* fonts[] = { "arial.ttf", "Courier New.ttf" };
+        for (auto font : fonts)
+        {
+            for (float size : SIZES)
+            {
+                const std::string name = "label/" + fontStem(font) + "/" + std::to_string(static_cast<int>(size));
+                if (!report.enabled(name)) continue;
+
+                Label label;
+                label.init(fontPath(font), text, size, 0);
+                report.run(name, "us/1k chars", [&]() {
+                    label.setString(text);
+                }, [&](double ns) { return ns / 1000.0 / (text.size() / 1000.0); });
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--json") == 0 && hasValue) options.json = argv[++i];
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue) options.warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && hasValue) options.reps = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--filter") == 0 && hasValue) options.filter = argv[++i];
+        else if (strcmp(argv[i], "--font") == 0 && hasValue) options.font = argv[++i];
+        else if (strcmp(argv[i], "--trace") == 0 && hasValue) options.trace = argv[++i];
+        else if (strcmp(argv[i], "--features") == 0) options.features = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [--json file] [--warmup n] [--reps n] [--filter text] [--features] [--font file] [--trace file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+#ifndef ENABLE_TEXT_PROFILER
+    if (!options.trace.empty())
+    {
+        fprintf(stderr, "--trace needs a build with ENABLE_TEXT_PROFILER\n");
+        return 1;
+    }
+#endif
+    utils::profiler::reset();
+    if (!options.trace.empty())
+    {
+        utils::profiler::startTrace();
+    }
+
+    Report report(options);
+    benchRaster(report);
+    benchAtlas(report);
+    benchAtlasLookup(report);
+    benchSubpixel(report);
+    benchColdFrames(report);
+    benchA4(report);
+    benchLCD(report);
+    benchDownscale(report);
+    benchOutlineCache(report);
+    benchRasterizer(report);
+    benchKerning(report);
+    benchUTF8(report);
+    benchLabel(report);
+    if (options.features)
+    {
+        const char* font = options.font.c_str();
+        bench_shaping(report, font);
+        bench_utf8(report);
+        bench_streaming(report, font);
+        bench_string_utf8(report);
+        bench_unicode_properties(report);
+        bench_font_registration(report);
+        bench_font_fallback(report);
+    }
+    report.flush();
+
+    if (!options.trace.empty())
+    {
+        utils::profiler::stopTrace();
+        auto snapshot = utils::profiler::snapshot();
+        for (auto& c : snapshot.counters)
+        {
+            printf("%-32s %12llu\n", c.name.c_str(), static_cast<unsigned long long>(c.value));
+        }
+        for (auto& t : snapshot.timers)
+        {
+            printf("%-32s %12llu calls  mean %10.0f ns  p50 <= %10llu ns  p99 <= %10llu ns  max %10llu ns\n", t.name.c_str(),
+                static_cast<unsigned long long>(t.count), t.meanNs(), static_cast<unsigned long long>(t.percentileNs(50)),
+                static_cast<unsigned long long>(t.percentileNs(99)), static_cast<unsigned long long>(t.maxNs));
+        }
+        if (!utils::profiler::writeChromeTrace(options.trace))
+        {
+            fprintf(stderr, "can not write %s\n", options.trace.c_str());
+            return 1;
+        }
+    }
+
+    if (!options.json.empty() && !report.writeJSON(options.json))
+    {
+        fprintf(stderr, "can not write %s\n", options.json.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * capture_convert: turns the binary captures written with utils/Capture.h
+ * back into the Mathematica expressions of the old ENABLE_INSPECT dumps.
+ *
+ * usage: capture_convert <file.pgm|file.tga|file.quads> [output]
+ *
+ * Images become a matrix of pixels, quad lists a Graphics[] of textured
+ * triangles drawn over `img`. The output goes to stdout unless a file is given.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Capture.h"
+#include "Utils.h"
+
+namespace {
+
+    void writeTriangles(std::ostream& out, const utils::capture::QuadRecord& q)
+    {
+        out << "Triangle[{";
+        out << "{" << q.x0 << "," << q.y0 << "}, ";
+        out << "{" << q.x1 << "," << q.y0 << "}, ";
+        out << "{" << q.x0 << "," << q.y1 << "}";
+        out << "},";
+        out << "VertexTextureCoordinates -> {";
+        out << "{" << q.u0 << ", " << q.v0 << "},";
+        out << "{" << q.u1 << ", " << q.v0 << "},";
+        out << "{" << q.u0 << ", " << q.v1 << "}";
+        out << "}],";
+
+        out << "Triangle[{";
+        out << "{" << q.x1 << "," << q.y0 << "}, ";
+        out << "{" << q.x1 << "," << q.y1 << "}, ";
+        out << "{" << q.x0 << "," << q.y1 << "}";
+        out << "},";
+        out << "VertexTextureCoordinates -> {";
+        out << "{" << q.u1 << ", " << q.v0 << "},";
+        out << "{" << q.u1 << ", " << q.v1 << "},";
+        out << "{" << q.u0 << ", " << q.v1 << "}";
+        out << "}]";
+    }
+
+    bool convertQuads(const std::string& path, std::ostream& out)
+    {
+        std::vector<utils::capture::QuadRecord> quads;
+        uint32_t lines = 0;
+        if (!utils::capture::readQuads(path, quads, lines))
+        {
+            return false;
+        }
+        out << "Graphics[{Texture[img], ";
+        for (size_t i = 0; i < quads.size(); i++)
+        {
+            writeTriangles(out, quads[i]);
+            if (i != quads.size() - 1)
+            {
+                out << ",";
+            }
+        }
+        out << "}, Background -> LightBlue, Axes -> True, GridLines -> Automatic, ImageSize -> Large]";
+        return true;
+    }
+
+    bool convertImage(const std::string& path, std::ostream& out)
+    {
+        int width = 0;
+        int height = 0;
+        int pixelBytes = 0;
+        std::vector<uint8_t> data;
+        if (!utils::capture::readImage(path, width, height, pixelBytes, data))
+        {
+            return false;
+        }
+        utils::inspectData(out, width, height, pixelBytes, data);
+        return true;
+    }
+
+    bool endsWith(const std::string& s, const char* suffix)
+    {
+        const size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <file.pgm|file.tga|file.quads> [output]\n", argv[0]);
+        return 2;
+    }
+
+    const std::string input = argv[1];
+    std::ofstream file;
+    if (argc > 2)
+    {
+        file.open(argv[2], std::ios::out);
+        if (!file)
+        {
+            fprintf(stderr, "can not write %s\n", argv[2]);
+            return 1;
+        }
+    }
+    std::ostream& out = argc > 2 ? file : std::cout;
+
+    const bool ok = endsWith(input, ".quads") ? convertQuads(input, out) : convertImage(input, out);
+    if (!ok)
+    {
+        fprintf(stderr, "can not read %s\n", input.c_str());
+        return 1;
+    }
+    out << "\n";
+    return 0;
+}
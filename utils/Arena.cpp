@@ -0,0 +1,74 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace utils
+{
+    MonotonicArena::MonotonicArena(size_t blockSize)
+        : _blockSize(blockSize)
+    {
+    }
+
+    MonotonicArena::~MonotonicArena()
+    {
+        releaseBlocks();
+    }
+
+    void* MonotonicArena::allocateSlow(size_t bytes, size_t align)
+    {
+        // blocks are aligned for any fundamental type
+        const size_t need = bytes + align;
+        while (_blockIndex + 1 < _blocks.size())
+        {
+            _blockIndex += 1;
+            _offset = 0;
+            if (need <= _blocks[_blockIndex].size)
+            {
+                return allocate(bytes, align);
+            }
+        }
+
+        Block block;
+        block.size = std::max(_blockSize, need);
+        block.data = static_cast<uint8_t*>(::operator new(block.size));
+        _blocks.push_back(block);
+        _blockIndex = _blocks.size() - 1;
+        _offset = 0;
+        return allocate(bytes, align);
+    }
+
+    void MonotonicArena::reset()
+    {
+        if (_blocks.size() > 1)
+        {
+            size_t total = capacity();
+            releaseBlocks();
+            Block block;
+            block.size = total;
+            block.data = static_cast<uint8_t*>(::operator new(block.size));
+            _blocks.push_back(block);
+        }
+        _blockIndex = 0;
+        _offset = 0;
+    }
+
+    size_t MonotonicArena::capacity() const
+    {
+        size_t total = 0;
+        for (auto& b : _blocks)
+        {
+            total += b.size;
+        }
+        return total;
+    }
+
+    void MonotonicArena::releaseBlocks()
+    {
+        for (auto& b : _blocks)
+        {
+            ::operator delete(b.data);
+        }
+        _blocks.clear();
+    }
+}
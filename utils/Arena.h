@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+    /**
+    * Monotonic bump allocator for per-layout scratch data.
+    *
+    * Memory is only released by reset(), which rewinds to the first block.
+    * If the previous round needed several blocks they are merged into one,
+    * so after a few rounds of similar size no more system allocation happens.
+    */
+    class MonotonicArena
+    {
+    public:
+        explicit MonotonicArena(size_t blockSize = 16 * 1024);
+        ~MonotonicArena();
+
+        MonotonicArena(const MonotonicArena&) = delete;
+        MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+        inline void* allocate(size_t bytes, size_t align)
+        {
+            size_t p = (_offset + align - 1) & ~(align - 1);
+            if (_blockIndex < _blocks.size() && p + bytes <= _blocks[_blockIndex].size)
+            {
+                _offset = p + bytes;
+                return _blocks[_blockIndex].data + p;
+            }
+            return allocateSlow(bytes, align);
+        }
+
+        void reset();
+
+        size_t capacity() const;
+        int blockCount() const { return static_cast<int>(_blocks.size()); }
+
+    private:
+        struct Block {
+            uint8_t* data;
+            size_t size;
+        };
+
+        void* allocateSlow(size_t bytes, size_t align);
+        void releaseBlocks();
+
+        std::vector<Block> _blocks;
+        size_t _blockIndex  = 0;
+        size_t _offset      = 0;
+        size_t _blockSize   = 0;
+    };
+
+    template<typename T>
+    class ArenaAllocator
+    {
+    public:
+        typedef T value_type;
+
+        ArenaAllocator(MonotonicArena& arena) : _arena(&arena) {}
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& o) : _arena(o._arena) {}
+
+        T* allocate(size_t n)
+        {
+            return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, size_t) {}
+
+        MonotonicArena& arena() const { return *_arena; }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& o) const { return _arena == o._arena; }
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& o) const { return _arena != o._arena; }
+
+    private:
+        MonotonicArena* _arena;
+        template<typename U> friend class ArenaAllocator;
+    };
+
+    template<typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
@@ -0,0 +1,241 @@
+#include "Capture.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+    std::atomic<uint32_t> sampleInterval{ 0 };
+    std::atomic<uint32_t> requested{ 0 };
+    std::atomic<uint64_t> samples{ 0 };
+    std::atomic<uint64_t> captures{ 0 };
+
+    std::mutex directoryMutex;
+    std::string directory;
+
+    bool readHeaderLine(std::istream& in, int& value)
+    {
+        // skips whitespace and # comments between the PGM header fields
+        in >> std::ws;
+        while (in.peek() == '#')
+        {
+            std::string comment;
+            std::getline(in, comment);
+            in >> std::ws;
+        }
+        return static_cast<bool>(in >> value);
+    }
+}
+
+namespace utils
+{
+namespace capture
+{
+    bool writeTGA(const std::string& path, int width, int height, int pixelBytes, const uint8_t* data)
+    {
+        if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF
+            || (pixelBytes != 1 && pixelBytes != 3 && pixelBytes != 4))
+        {
+            return false;
+        }
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        TGAHeader header;
+        memset(&header, 0, sizeof(TGAHeader));
+        header.imageType = pixelBytes == 1 ? 3 : 2;
+        header.width = static_cast<uint16_t>(width);
+        header.height = static_cast<uint16_t>(height);
+        header.depth = static_cast<uint8_t>(pixelBytes * 8);
+        header.descriptor = 0x20 | (pixelBytes == 4 ? 8 : 0);   // top row first, alpha bits
+        file.write(reinterpret_cast<const char*>(&header), sizeof(TGAHeader));
+
+        const size_t rowBytes = static_cast<size_t>(width) * pixelBytes;
+        if (pixelBytes != 3)
+        {
+            file.write(reinterpret_cast<const char*>(data), rowBytes * height);
+            return static_cast<bool>(file);
+        }
+
+        // TGA stores BGR
+        std::vector<uint8_t> row(rowBytes);
+        for (int y = 0; y < height; y++)
+        {
+            const uint8_t* src = data + y * rowBytes;
+            for (size_t x = 0; x < rowBytes; x += 3)
+            {
+                row[x] = src[x + 2];
+                row[x + 1] = src[x + 1];
+                row[x + 2] = src[x];
+            }
+            file.write(reinterpret_cast<const char*>(row.data()), rowBytes);
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool writePGM(const std::string& path, int width, int height, const uint8_t* data)
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file || width <= 0 || height <= 0)
+        {
+            return false;
+        }
+        file << "P5\n" << width << " " << height << "\n255\n";
+        file.write(reinterpret_cast<const char*>(data), static_cast<size_t>(width) * height);
+        return static_cast<bool>(file);
+    }
+
+    bool writeImage(const std::string& path, int width, int height, int pixelBytes, const uint8_t* data)
+    {
+        if (pixelBytes == 1 && path.size() >= 4 && path.compare(path.size() - 4, 4, ".pgm") == 0)
+        {
+            return writePGM(path, width, height, data);
+        }
+        return writeTGA(path, width, height, pixelBytes, data);
+    }
+
+    bool readImage(const std::string& path, int& width, int& height, int& pixelBytes, std::vector<uint8_t>& data)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        char magic[2] = { 0, 0 };
+        file.read(magic, 2);
+        if (magic[0] == 'P' && magic[1] == '5')
+        {
+            int maxValue = 0;
+            if (!readHeaderLine(file, width) || !readHeaderLine(file, height) || !readHeaderLine(file, maxValue) || maxValue != 255)
+            {
+                return false;
+            }
+            file.get();     // the single whitespace before the pixels
+            pixelBytes = 1;
+            data.resize(static_cast<size_t>(width) * height);
+            file.read(reinterpret_cast<char*>(data.data()), data.size());
+            return static_cast<bool>(file);
+        }
+
+        TGAHeader header;
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(TGAHeader))
+            || (header.imageType != 2 && header.imageType != 3) || header.paletteType != 0)
+        {
+            return false;
+        }
+        file.seekg(header.idLength, std::ios::cur);
+        width = header.width;
+        height = header.height;
+        pixelBytes = header.depth / 8;
+        if (pixelBytes != 1 && pixelBytes != 3 && pixelBytes != 4)
+        {
+            return false;
+        }
+
+        const size_t rowBytes = static_cast<size_t>(width) * pixelBytes;
+        data.resize(rowBytes * height);
+        for (int i = 0; i < height; i++)
+        {
+            // bottom row first unless the descriptor says otherwise
+            const int y = (header.descriptor & 0x20) ? i : height - 1 - i;
+            uint8_t* row = data.data() + y * rowBytes;
+            if (!file.read(reinterpret_cast<char*>(row), rowBytes))
+            {
+                return false;
+            }
+            if (pixelBytes == 3)
+            {
+                for (size_t x = 0; x < rowBytes; x += 3)
+                {
+                    std::swap(row[x], row[x + 2]);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool writeQuads(const std::string& path, const std::vector<QuadRecord>& quads, uint32_t lines)
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+        QuadFileHeader header;
+        header.count = static_cast<uint32_t>(quads.size());
+        header.lines = lines;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(quads.data()), quads.size() * sizeof(QuadRecord));
+        return static_cast<bool>(file);
+    }
+
+    bool readQuads(const std::string& path, std::vector<QuadRecord>& quads, uint32_t& lines)
+    {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        QuadFileHeader header;
+        if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || header.magic != QUAD_FILE_MAGIC || header.version != QUAD_FILE_VERSION)
+        {
+            return false;
+        }
+        lines = header.lines;
+        quads.resize(header.count);
+        file.read(reinterpret_cast<char*>(quads.data()), quads.size() * sizeof(QuadRecord));
+        return static_cast<bool>(file);
+    }
+
+    void setSampleInterval(uint32_t interval)
+    {
+        sampleInterval.store(interval, std::memory_order_relaxed);
+    }
+
+    void request()
+    {
+        requested.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t sample()
+    {
+        const uint32_t interval = sampleInterval.load(std::memory_order_relaxed);
+        const bool due = interval > 0 && samples.fetch_add(1, std::memory_order_relaxed) % interval == 0;
+        if (!due)
+        {
+            uint32_t pending = requested.load(std::memory_order_relaxed);
+            do
+            {
+                if (pending == 0) return 0;
+            } while (!requested.compare_exchange_weak(pending, pending - 1, std::memory_order_relaxed));
+        }
+        return captures.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    void setDirectory(const std::string& dir)
+    {
+        std::lock_guard<std::mutex> lock(directoryMutex);
+        directory = dir;
+    }
+
+    std::string filePath(const char* name, uint64_t id, const std::string& suffix)
+    {
+        std::string ret;
+        {
+            std::lock_guard<std::mutex> lock(directoryMutex);
+            ret = directory;
+        }
+        if (!ret.empty() && ret.back() != '/' && ret.back() != '\\')
+        {
+            ret += '/';
+        }
+        return ret + name + "_" + std::to_string(id) + suffix;
+    }
+}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+* Binary snapshots of atlas frames, glyph bitmaps and quad lists for
+* debugging, written in builds with ENABLE_INSPECT.
+*
+* Images are written as PGM (1 byte per pixel) or TGA, quad lists as a
+* QuadFileHeader followed by packed QuadRecords. Nothing is written unless a
+* sample interval is set or a capture is requested, so that debug builds can
+* run under production load. tools/capture_convert.cpp turns the files back
+* into the Mathematica text the old dumps produced.
+*/
+namespace utils
+{
+namespace capture
+{
+#if defined(_MSC_VER) || defined(__GNUC__)
+#pragma pack(push, 1)
+#endif
+
+    struct TGAHeader
+    {
+        uint8_t idLength;           // Length of optional identification sequence.
+        uint8_t paletteType;        // Is a palette present? (1=yes)
+        uint8_t imageType;          // Image data type (0=none, 1=indexed, 2=rgb, 3=grey, +8=rle packed).
+        uint16_t firstPaletteEntry; // First palette index, if present.
+        uint16_t numPaletteEntries; // Number of palette entries, if present.
+        uint8_t paletteBits;        // Number of bits per palette entry.
+        uint16_t x;                 // Horiz. pixel coord. of lower left of image.
+        uint16_t y;                 // Vert. pixel coord. of lower left of image.
+        uint16_t width;             // Image width in pixels.
+        uint16_t height;            // Image height in pixels.
+        uint8_t depth;              // Image color depth (bits per pixel).
+        uint8_t descriptor;         // Image attribute flags.
+    };
+
+#if defined(_MSC_VER) || defined(__GNUC__)
+#pragma pack(pop)
+#endif
+
+    const uint32_t QUAD_FILE_MAGIC = 0x44415551;   // "QUAD"
+    const uint32_t QUAD_FILE_VERSION = 1;
+
+    struct QuadFileHeader
+    {
+        uint32_t magic = QUAD_FILE_MAGIC;
+        uint32_t version = QUAD_FILE_VERSION;
+        uint32_t count = 0;
+        uint32_t lines = 0;
+    };
+
+    struct QuadRecord
+    {
+        float x0, y0, x1, y1;   // position, y grows downwards
+        float u0, v0, u1, v1;   // texture coordinates
+        int32_t page;           // atlas frame, see GlyphQuads::page
+        int32_t line;
+    };
+
+    /**
+    * Writes `data`, width x height pixels of `pixelBytes` bytes from the top
+    * row down, as TGA. 1 byte is grey, 3 bytes RGB and 4 bytes BGRA.
+    */
+    bool writeTGA(const std::string& path, int width, int height, int pixelBytes, const uint8_t* data);
+
+    /**
+    * Writes 1 byte per pixel `data` as binary PGM (P5).
+    */
+    bool writePGM(const std::string& path, int width, int height, const uint8_t* data);
+
+    /**
+    * writePGM() if `path` ends in .pgm and the pixels are 1 byte, writeTGA()
+    * otherwise.
+    */
+    bool writeImage(const std::string& path, int width, int height, int pixelBytes, const uint8_t* data);
+
+    /**
+    * Reads a file written by writeTGA() or writePGM(), pixels are returned
+    * as they were passed in.
+    */
+    bool readImage(const std::string& path, int& width, int& height, int& pixelBytes, std::vector<uint8_t>& data);
+
+    bool writeQuads(const std::string& path, const std::vector<QuadRecord>& quads, uint32_t lines);
+    bool readQuads(const std::string& path, std::vector<QuadRecord>& quads, uint32_t& lines);
+
+    /**
+    * Captures every `interval`th sample, 0 turns sampling off (the default).
+    */
+    void setSampleInterval(uint32_t interval);
+
+    /**
+    * Captures the next sample regardless of the interval.
+    */
+    void request();
+
+    /**
+    * Called where a capture may be taken, returns the id of the capture to
+    * write or 0 if this sample is skipped. Costs a few relaxed atomic
+    * operations.
+    */
+    uint64_t sample();
+
+    /**
+    * Directory the captures are written to, the working directory by default.
+    */
+    void setDirectory(const std::string& dir);
+
+    /**
+    * Returns "<directory>/<name>_<id><suffix>".
+    */
+    std::string filePath(const char* name, uint64_t id, const std::string& suffix);
+}
+}
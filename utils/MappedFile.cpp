@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+#include "Utils.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils
+{
+    std::shared_ptr<MappedFile> MappedFile::open(const std::string& path)
+    {
+        std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle != INVALID_HANDLE_VALUE)
+        {
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(handle, &size) && size.QuadPart > 0 && static_cast<uint64_t>(size.QuadPart) <= SIZE_MAX)
+            {
+                HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping)
+                {
+                    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    if (view)
+                    {
+                        file->_data = static_cast<const uint8_t*>(view);
+                        file->_size = static_cast<size_t>(size.QuadPart);
+                        file->_mapping = mapping;
+                        file->_mapped = true;
+                    }
+                    else
+                    {
+                        CloseHandle(mapping);
+                    }
+                }
+            }
+            CloseHandle(handle);
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0 && static_cast<uint64_t>(st.st_size) <= SIZE_MAX)
+            {
+                void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (view != MAP_FAILED)
+                {
+                    file->_data = static_cast<const uint8_t*>(view);
+                    file->_size = static_cast<size_t>(st.st_size);
+                    file->_mapped = true;
+                }
+            }
+            close(fd);
+        }
+#endif
+        if (!file->_mapped)
+        {
+            if (!readFile(path, file->_buffer))
+            {
+                return nullptr;
+            }
+            file->_data = file->_buffer.data();
+            file->_size = file->_buffer.size();
+        }
+        return file;
+    }
+
+    std::shared_ptr<MappedFile> MappedFile::fromData(std::vector<uint8_t>&& data)
+    {
+        std::shared_ptr<MappedFile> file(new MappedFile());
+        file->_buffer = std::move(data);
+        file->_data = file->_buffer.data();
+        file->_size = file->_buffer.size();
+        return file;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (!_mapped) return;
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+        CloseHandle(_mapping);
+#else
+        munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace utils
+{
+    /**
+    * Read-only view of a whole file, memory mapped when the platform allows it,
+    * otherwise read into memory. Shared by everything reading the same file.
+    */
+    class MappedFile {
+    public:
+        /**
+        * Returns nullptr if the file can not be opened.
+        */
+        static std::shared_ptr<MappedFile> open(const std::string& path);
+
+        /**
+        * Wraps data already in memory, e.g. a downloaded font.
+        */
+        static std::shared_ptr<MappedFile> fromData(std::vector<uint8_t>&& data);
+
+        ~MappedFile();
+
+        const uint8_t* data() const { return _data; }
+        size_t size() const { return _size; }
+        bool isMapped() const { return _mapped; }
+
+    private:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* _data = nullptr;
+        size_t _size = 0;
+        bool _mapped = false;
+        std::vector<uint8_t> _buffer;
+#ifdef _WIN32
+        void* _mapping = nullptr;
+#endif
+    };
+}
@@ -0,0 +1,288 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    struct ThreadTrace
+    {
+        uint32_t tid = 0;
+        std::mutex mutex;   // only contended while the trace is written
+        std::vector<TraceEvent> events;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        // never shrinks, call sites keep pointers to the items
+        std::vector<std::unique_ptr<utils::profiler::Counter>> counters;
+        std::vector<std::unique_ptr<utils::profiler::Timer>> timers;
+        std::vector<std::shared_ptr<ThreadTrace>> traces;
+        std::atomic<bool> tracing{ false };
+        uint64_t traceStart = 0;
+    };
+
+    Registry& registry()
+    {
+        static Registry* instance = new Registry();
+        return *instance;
+    }
+
+    ThreadTrace& threadTrace()
+    {
+        thread_local std::shared_ptr<ThreadTrace> trace;
+        if (!trace)
+        {
+            auto& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            trace = std::make_shared<ThreadTrace>();
+            trace->tid = static_cast<uint32_t>(r.traces.size() + 1);
+            r.traces.push_back(trace);
+        }
+        return *trace;
+    }
+
+    inline int bucketOf(uint64_t ns)
+    {
+        int bucket = 0;
+#if defined(__GNUC__) || defined(__clang__)
+        bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+#else
+        while (ns >>= 1) bucket++;
+#endif
+        return std::min(bucket, utils::profiler::HISTOGRAM_BUCKETS - 1);
+    }
+
+    void writeJSONString(FILE* fp, const std::string& s)
+    {
+        fputc('"', fp);
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\') fputc('\\', fp);
+            fputc(c, fp);
+        }
+        fputc('"', fp);
+    }
+}
+
+namespace utils
+{
+namespace profiler
+{
+    Timer::Timer(const char* name) : name(name)
+    {
+        for (auto& b : buckets)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Timer::record(uint64_t ns)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+        totalNs.fetch_add(ns, std::memory_order_relaxed);
+        buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = maxNs.load(std::memory_order_relaxed);
+        while (ns > max && !maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Counter* getCounter(const char* name)
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& c : r.counters)
+        {
+            if (strcmp(c->name, name) == 0) return c.get();
+        }
+        r.counters.emplace_back(new Counter(name));
+        return r.counters.back().get();
+    }
+
+    Timer* getTimer(const char* name)
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& t : r.timers)
+        {
+            if (strcmp(t->name, name) == 0) return t.get();
+        }
+        r.timers.emplace_back(new Timer(name));
+        return r.timers.back().get();
+    }
+
+    uint64_t TimerSnapshot::percentileNs(double p) const
+    {
+        const uint64_t rank = static_cast<uint64_t>(p / 100.0 * count + 0.5);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank && seen > 0)
+            {
+                return std::min<uint64_t>(maxNs, (2ULL << i) - 1);
+            }
+        }
+        return maxNs;
+    }
+
+    uint64_t Snapshot::getCounter(const std::string& name) const
+    {
+        for (auto& c : counters)
+        {
+            if (c.name == name) return c.value;
+        }
+        return 0;
+    }
+
+    const TimerSnapshot* Snapshot::getTimer(const std::string& name) const
+    {
+        for (auto& t : timers)
+        {
+            if (t.name == name) return &t;
+        }
+        return nullptr;
+    }
+
+    Snapshot snapshot()
+    {
+        Snapshot ret;
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& c : r.counters)
+        {
+            CounterSnapshot s;
+            s.name = c->name;
+            s.value = c->value.load(std::memory_order_relaxed);
+            ret.counters.push_back(std::move(s));
+        }
+        for (auto& t : r.timers)
+        {
+            TimerSnapshot s;
+            s.name = t->name;
+            s.count = t->count.load(std::memory_order_relaxed);
+            s.totalNs = t->totalNs.load(std::memory_order_relaxed);
+            s.maxNs = t->maxNs.load(std::memory_order_relaxed);
+            for (auto& b : t->buckets)
+            {
+                s.buckets.push_back(b.load(std::memory_order_relaxed));
+            }
+            ret.timers.push_back(std::move(s));
+        }
+        std::sort(ret.counters.begin(), ret.counters.end(), [](const CounterSnapshot& a, const CounterSnapshot& b) { return a.name < b.name; });
+        std::sort(ret.timers.begin(), ret.timers.end(), [](const TimerSnapshot& a, const TimerSnapshot& b) { return a.name < b.name; });
+        return ret;
+    }
+
+    void reset()
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& c : r.counters)
+        {
+            c->value.store(0, std::memory_order_relaxed);
+        }
+        for (auto& t : r.timers)
+        {
+            t->count.store(0, std::memory_order_relaxed);
+            t->totalNs.store(0, std::memory_order_relaxed);
+            t->maxNs.store(0, std::memory_order_relaxed);
+            for (auto& b : t->buckets)
+            {
+                b.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& trace : r.traces)
+        {
+            std::lock_guard<std::mutex> traceLock(trace->mutex);
+            trace->events.clear();
+        }
+    }
+
+    void startTrace()
+    {
+        auto& r = registry();
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.traceStart = nowNs();
+        }
+        r.tracing.store(true, std::memory_order_release);
+    }
+
+    void stopTrace()
+    {
+        registry().tracing.store(false, std::memory_order_release);
+    }
+
+    bool writeChromeTrace(const std::string& path)
+    {
+        FILE* fp = fopen(path.c_str(), "w");
+        if (!fp) return false;
+
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        const uint64_t origin = r.traceStart;
+        uint64_t end = origin;
+        bool first = true;
+        fprintf(fp, "{\"traceEvents\":[");
+        for (auto& trace : r.traces)
+        {
+            std::lock_guard<std::mutex> traceLock(trace->mutex);
+            for (auto& e : trace->events)
+            {
+                if (e.start < origin) continue;
+                fprintf(fp, "%s\n{\"name\":", first ? "" : ",");
+                writeJSONString(fp, e.name);
+                fprintf(fp, ",\"cat\":\"text\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    (e.start - origin) / 1e3, e.duration / 1e3, trace->tid);
+                end = std::max(end, e.start + e.duration);
+                first = false;
+            }
+        }
+        if (!r.counters.empty())
+        {
+            fprintf(fp, "%s\n{\"name\":\"counters\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{", first ? "" : ",", (end - origin) / 1e3);
+            for (size_t i = 0; i < r.counters.size(); i++)
+            {
+                if (i) fputc(',', fp);
+                writeJSONString(fp, r.counters[i]->name);
+                fprintf(fp, ":%llu", static_cast<unsigned long long>(r.counters[i]->value.load(std::memory_order_relaxed)));
+            }
+            fprintf(fp, "}}");
+        }
+        fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+        return fclose(fp) == 0;
+    }
+
+    uint64_t nowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    ScopedTimer::~ScopedTimer()
+    {
+        const uint64_t end = nowNs();
+        _timer->record(end - _start);
+        if (registry().tracing.load(std::memory_order_acquire))
+        {
+            auto& trace = threadTrace();
+            std::lock_guard<std::mutex> lock(trace.mutex);
+            trace.events.push_back(TraceEvent{ _timer->name, _start, end - _start });
+        }
+    }
+}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+* Scoped timers and counters on the hot paths of fonts, atlases and labels.
+*
+* The call sites use PROFILE_SCOPE and PROFILE_COUNT, which are compiled in
+* with ENABLE_TEXT_PROFILER and expand to nothing otherwise. Every call site
+* looks its timer or counter up by name once, afterwards it only updates
+* relaxed atomics. Between startTrace() and stopTrace() the scopes are also
+* kept as events for writeChromeTrace().
+*/
+namespace utils
+{
+namespace profiler
+{
+    // bucket i of a histogram counts durations in [2^i, 2^(i+1)) ns
+    const int HISTOGRAM_BUCKETS = 40;
+
+    struct Counter
+    {
+        explicit Counter(const char* name) : name(name) {}
+
+        const char* name;
+        std::atomic<uint64_t> value{ 0 };
+    };
+
+    struct Timer
+    {
+        explicit Timer(const char* name);
+
+        void record(uint64_t ns);
+
+        const char* name;
+        std::atomic<uint64_t> count{ 0 };
+        std::atomic<uint64_t> totalNs{ 0 };
+        std::atomic<uint64_t> maxNs{ 0 };
+        std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    };
+
+    /**
+    * Returns the counter or timer of `name`, created on first use and alive
+    * until the program exits. `name` must be a string literal.
+    */
+    Counter* getCounter(const char* name);
+    Timer* getTimer(const char* name);
+
+    struct CounterSnapshot
+    {
+        std::string name;
+        uint64_t value = 0;
+    };
+
+    struct TimerSnapshot
+    {
+        std::string name;
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+        std::vector<uint64_t> buckets;
+
+        double meanNs() const { return count ? static_cast<double>(totalNs) / count : 0; }
+
+        /**
+        * Upper bound of the histogram bucket holding percentile `p`.
+        */
+        uint64_t percentileNs(double p) const;
+    };
+
+    struct Snapshot
+    {
+        std::vector<CounterSnapshot> counters;
+        std::vector<TimerSnapshot> timers;
+
+        /**
+        * 0 and nullptr for names which were never used.
+        */
+        uint64_t getCounter(const std::string& name) const;
+        const TimerSnapshot* getTimer(const std::string& name) const;
+    };
+
+    /**
+    * Copies all counters and timers, sorted by name.
+    */
+    Snapshot snapshot();
+
+    /**
+    * Zeroes all counters and timers and drops the trace events.
+    */
+    void reset();
+
+    void startTrace();
+    void stopTrace();
+
+    /**
+    * Writes the trace events as Chrome trace JSON (chrome://tracing, Perfetto),
+    * the counters are added as one counter event at the end.
+    */
+    bool writeChromeTrace(const std::string& path);
+
+    uint64_t nowNs();
+
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Timer* timer) : _timer(timer), _start(nowNs()) {}
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Timer* _timer;
+        uint64_t _start;
+    };
+}
+}
+
+#ifdef ENABLE_TEXT_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) \
+    static utils::profiler::Timer* PROFILE_CONCAT(profileTimer_, __LINE__) = utils::profiler::getTimer(name); \
+    utils::profiler::ScopedTimer PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileTimer_, __LINE__))
+#define PROFILE_COUNT(name, n) do { \
+        static utils::profiler::Counter* profileCounter_ = utils::profiler::getCounter(name); \
+        profileCounter_->value.fetch_add(n, std::memory_order_relaxed); \
+    } while (0)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNT(name, n) ((void)0)
+#endif
@@ -0,0 +1,69 @@
+#include "TextSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define TEXT_SOURCE_FSEEK _fseeki64
+#define TEXT_SOURCE_FTELL _ftelli64
+#else
+#define TEXT_SOURCE_FSEEK fseeko
+#define TEXT_SOURCE_FTELL ftello
+#endif
+
+namespace utils
+{
+    FileTextSource::~FileTextSource()
+    {
+        if (_fp)
+        {
+            fclose(_fp);
+        }
+    }
+
+    bool FileTextSource::open(const std::string& path)
+    {
+        if (_fp)
+        {
+            fclose(_fp);
+            _size = 0;
+        }
+        _fp = fopen(path.c_str(), "rb");
+        if (!_fp) return false;
+
+        if (TEXT_SOURCE_FSEEK(_fp, 0, SEEK_END) != 0)
+        {
+            fclose(_fp);
+            _fp = nullptr;
+            return false;
+        }
+        _size = static_cast<uint64_t>(TEXT_SOURCE_FTELL(_fp));
+        TEXT_SOURCE_FSEEK(_fp, 0, SEEK_SET);
+        return true;
+    }
+
+    size_t FileTextSource::read(char* buffer, size_t capacity)
+    {
+        return _fp ? fread(buffer, 1, capacity, _fp) : 0;
+    }
+
+    bool FileTextSource::seek(uint64_t offset)
+    {
+        return _fp && offset <= _size && TEXT_SOURCE_FSEEK(_fp, offset, SEEK_SET) == 0;
+    }
+
+    size_t MemoryTextSource::read(char* buffer, size_t capacity)
+    {
+        const size_t n = std::min(capacity, _length - _position);
+        memcpy(buffer, _data + _position, n);
+        _position += n;
+        return n;
+    }
+
+    bool MemoryTextSource::seek(uint64_t offset)
+    {
+        if (offset > _length) return false;
+        _position = static_cast<size_t>(offset);
+        return true;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace utils
+{
+    /**
+    * Random access byte stream, text too large to be held in memory is read
+    * through it chunk by chunk.
+    */
+    class TextSource {
+    public:
+        virtual ~TextSource() {}
+
+        /**
+        * Reads up to `capacity` bytes, returns the number of bytes read, 0 at the end.
+        */
+        virtual size_t read(char* buffer, size_t capacity) = 0;
+        virtual bool seek(uint64_t offset) = 0;
+        virtual uint64_t size() const = 0;
+    };
+
+    class FileTextSource : public TextSource {
+    public:
+        FileTextSource() = default;
+        virtual ~FileTextSource();
+
+        bool open(const std::string& path);
+
+        size_t read(char* buffer, size_t capacity) override;
+        bool seek(uint64_t offset) override;
+        uint64_t size() const override { return _size; }
+
+    private:
+        FILE* _fp = nullptr;
+        uint64_t _size = 0;
+    };
+
+    /**
+    * Reads from memory owned by the caller.
+    */
+    class MemoryTextSource : public TextSource {
+    public:
+        MemoryTextSource(const char* data, size_t length) : _data(data), _length(length) {}
+
+        size_t read(char* buffer, size_t capacity) override;
+        bool seek(uint64_t offset) override;
+        uint64_t size() const override { return _length; }
+
+    private:
+        const char* _data = nullptr;
+        size_t _length = 0;
+        size_t _position = 0;
+    };
+}
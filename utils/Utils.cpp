@@ -1,30 +1,46 @@
 #include "Utils.h"
+#include "TextSource.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstdint>
 
 #include <iostream>
 
 namespace utils
 {
 
+    bool readFile(const std::string &path, std::vector<uint8_t> &data)
+    {
+        FileTextSource file;
+        if (!file.open(path))
+        {
+            return false;
+        }
+        const uint64_t size = file.size();
+        if (size > SIZE_MAX)
+        {
+            return false;
+        }
+        data.resize(static_cast<size_t>(size));
+        size_t got = 0;
+        size_t n;
+        while (got < data.size() && (n = file.read(reinterpret_cast<char*>(data.data()) + got, data.size() - got)) > 0)
+        {
+            got += n;
+        }
+        data.resize(got);
+        return got == size;
+    }
+
     std::vector<uint8_t> readFile(const std::string &path)
     {
-        FILE *fp = fopen(path.c_str(), "rb");
-        fseek(fp, 0, SEEK_END);
-        int size = ftell(fp);
-        fseek(fp, 0, SEEK_SET);
         std::vector<uint8_t> data;
-        data.reserve(size);
-        uint8_t *buffer = new uint8_t[4096]; // 4K
-        int got = 0;
-
-        while ((got = fread(buffer, 1, 4096, fp)) > 0) {
-            data.insert(data.end(), buffer, buffer + got);
+        if (!readFile(path, data))
+        {
+            data.clear();
         }
-
-        delete[]buffer;
-        return std::move(data);
+        return data;
     }
 
 
@@ -49,7 +65,7 @@ namespace utils
                 else
                 {
                     out << "{";
-                    for (int k = 0; k << pixelBytes; k++) {
+                    for (int k = 0; k < pixelBytes; k++) {
                         out << (int)data[(j + i * width) * pixelBytes + k];
                         if (k != pixelBytes - 1) {
                             out << ",";
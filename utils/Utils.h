@@ -8,7 +8,16 @@
 
 namespace utils
 {
+    /**
+    * Returns the content of the file, or an empty vector if it can not be read.
+    */
     std::vector<uint8_t> readFile(const std::string &path);
 
+    /**
+    * Reads the whole file into `data`, returns false if it can not be opened
+    * or is shorter than its reported size.
+    */
+    bool readFile(const std::string &path, std::vector<uint8_t> &data);
+
     void inspectData(std::ostream& out, int width, int height, int pixelBytes, const std::vector<uint8_t>& data);
 };
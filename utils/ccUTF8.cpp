@@ -26,9 +26,11 @@
 
 #include "ccUTF8.h"
 #include "ConvertUTF.h"
+#include <algorithm>
 #include <limits>
 #include <cstdarg>
 #include <cassert>
+#include <cstring>
 
 namespace StringUtils {
 
@@ -139,30 +141,17 @@ static void trimUTF32VectorFromIndex(std::vector<char32_t>& str, int index)
  * */
 bool isUnicodeSpace(char32_t ch)
 {
-    return  (ch >= 0x0009 && ch <= 0x000D) || ch == 0x0020 || ch == 0x0085 || ch == 0x00A0 || ch == 0x1680
-    || (ch >= 0x2000 && ch <= 0x200A) || ch == 0x2028 || ch == 0x2029 || ch == 0x202F
-    ||  ch == 0x205F || ch == 0x3000;
+    return (getUnicodeProperties(ch) & UnicodeProperty::Space) != 0;
 }
 
 bool isCJKUnicode(char32_t ch)
 {
-    return (ch >= 0x4E00 && ch <= 0x9FBF)   // CJK Unified Ideographs
-        || (ch >= 0x2E80 && ch <= 0x2FDF)   // CJK Radicals Supplement & Kangxi Radicals
-        || (ch >= 0x2FF0 && ch <= 0x30FF)   // Ideographic Description Characters, CJK Symbols and Punctuation & Japanese
-        || (ch >= 0x3100 && ch <= 0x31BF)   // Korean
-        || (ch >= 0xAC00 && ch <= 0xD7AF)   // Hangul Syllables
-        || (ch >= 0xF900 && ch <= 0xFAFF)   // CJK Compatibility Ideographs
-        || (ch >= 0xFE30 && ch <= 0xFE4F)   // CJK Compatibility Forms
-        || (ch >= 0x31C0 && ch <= 0x4DFF)   // Other extensions
-        || (ch >= 0x1f004 && ch <= 0x1f682);// Emoji
+    return (getUnicodeProperties(ch) & UnicodeProperty::CJK) != 0;
 }
     
 bool isUnicodeNonBreaking(char32_t ch)
 {
-    return ch == 0x00A0   // Non-Breaking Space
-    || ch == 0x202F       // Narrow Non-Breaking Space
-    || ch == 0x2007       // Figure Space
-    || ch == 0x2060;      // Word Joiner
+    return (getUnicodeProperties(ch) & UnicodeProperty::NonBreaking) != 0;
 }
     
 void trimUTF16Vector(std::vector<char16_t>& str)
@@ -232,46 +221,116 @@ struct ConvertTrait<char32_t> {
 };
 
 template <typename From, typename To, typename FromTrait = ConvertTrait<From>, typename ToTrait = ConvertTrait<To>>
-bool utfConvert(
-    const std::basic_string<From>& from, std::basic_string<To>& to,
-    ConversionResult(*cvtfunc)(const typename FromTrait::ArgType**, const typename FromTrait::ArgType*,
+struct ConvertFunc {
+    typedef ConversionResult(*Type)(const typename FromTrait::ArgType**, const typename FromTrait::ArgType*,
         typename ToTrait::ArgType**, typename ToTrait::ArgType*,
-        ConversionFlags)
-    )
+        ConversionFlags);
+};
+
+// returns the number of code units written, -1 on invalid input or a too small buffer
+template <typename From, typename To, typename FromTrait = ConvertTrait<From>, typename ToTrait = ConvertTrait<To>>
+long utfConvertInto(const From* from, size_t length, To* out, size_t outCapacity,
+    typename ConvertFunc<From, To>::Type cvtfunc)
 {
     static_assert(sizeof(From) == sizeof(typename FromTrait::ArgType), "Error size mismatched");
     static_assert(sizeof(To) == sizeof(typename ToTrait::ArgType), "Error size mismatched");
 
-    if (from.empty())
+    if (length == 0)
+        return 0;
+
+    auto inbeg = reinterpret_cast<const typename FromTrait::ArgType*>(from);
+    auto outbeg = reinterpret_cast<typename ToTrait::ArgType*>(out);
+    if (cvtfunc(&inbeg, inbeg + length, &outbeg, outbeg + outCapacity, strictConversion) != conversionOK)
+        return -1;
+    return static_cast<long>(reinterpret_cast<To*>(outbeg) - out);
+}
+
+// converts into a small stack buffer chunk by chunk, only counting the output
+template <typename From, typename To, typename FromTrait = ConvertTrait<From>, typename ToTrait = ConvertTrait<To>>
+long utfConvertedLength(const From* from, size_t length, typename ConvertFunc<From, To>::Type cvtfunc)
+{
+    typename ToTrait::ArgType buffer[256];
+    auto inbeg = reinterpret_cast<const typename FromTrait::ArgType*>(from);
+    auto inend = inbeg + length;
+    long count = 0;
+    while (inbeg < inend)
     {
-        to.clear();
-        return true;
+        auto outbeg = buffer;
+        auto r = cvtfunc(&inbeg, inend, &outbeg, buffer + 256, strictConversion);
+        count += static_cast<long>(outbeg - buffer);
+        if (r == conversionOK)
+            break;
+        if (r != targetExhausted)
+            return -1;
     }
+    return count;
+}
 
-    // See: http://unicode.org/faq/utf_bom.html#gen6
-    static const int most_bytes_per_character = 4;
+// sizes `to` exactly and converts in place, so a reused string with enough
+// capacity is not reallocated, and `to` is untouched on failure
+template <typename From, typename To>
+bool utfConvert(const std::basic_string<From>& from, std::basic_string<To>& to,
+    typename ConvertFunc<From, To>::Type cvtfunc)
+{
+    const long length = utfConvertedLength<From, To>(from.data(), from.length(), cvtfunc);
+    if (length < 0)
+        return false;
 
-    const size_t maxNumberOfChars = from.length(); // all UTFs at most one element represents one character.
-    const size_t numberOfOut = maxNumberOfChars * most_bytes_per_character / sizeof(To);
+    to.resize(length);
+    if (length > 0)
+        utfConvertInto(from.data(), from.length(), &to[0], length, cvtfunc);
+    return true;
+}
 
-    std::basic_string<To> working(numberOfOut, 0);
+long UTF8ToUTF16(const char* utf8, size_t length, char16_t* out, size_t outCapacity)
+{
+    return utfConvertInto(utf8, length, out, outCapacity, ConvertUTF8toUTF16);
+}
 
-    auto inbeg = reinterpret_cast<const typename FromTrait::ArgType*>(&from[0]);
-    auto inend = inbeg + from.length();
+long UTF16ToUTF8(const char16_t* utf16, size_t length, char* out, size_t outCapacity)
+{
+    return utfConvertInto(utf16, length, out, outCapacity, ConvertUTF16toUTF8);
+}
 
+long UTF16ToUTF32(const char16_t* utf16, size_t length, char32_t* out, size_t outCapacity)
+{
+    return utfConvertInto(utf16, length, out, outCapacity, ConvertUTF16toUTF32);
+}
 
-    auto outbeg = reinterpret_cast<typename ToTrait::ArgType*>(&working[0]);
-    auto outend = outbeg + working.length();
-    auto r = cvtfunc(&inbeg, inend, &outbeg, outend, strictConversion);
-    if (r != conversionOK)
-        return false;
+long UTF32ToUTF8(const char32_t* utf32, size_t length, char* out, size_t outCapacity)
+{
+    return utfConvertInto(utf32, length, out, outCapacity, ConvertUTF32toUTF8);
+}
 
-    working.resize(reinterpret_cast<To*>(outbeg) - &working[0]);
-    to = std::move(working);
+long UTF32ToUTF16(const char32_t* utf32, size_t length, char16_t* out, size_t outCapacity)
+{
+    return utfConvertInto(utf32, length, out, outCapacity, ConvertUTF32toUTF16);
+}
 
-    return true;
-};
+long getUTF16LengthOfUTF8(const char* utf8, size_t length)
+{
+    return utfConvertedLength<char, char16_t>(utf8, length, ConvertUTF8toUTF16);
+}
 
+long getUTF8LengthOfUTF16(const char16_t* utf16, size_t length)
+{
+    return utfConvertedLength<char16_t, char>(utf16, length, ConvertUTF16toUTF8);
+}
+
+long getUTF32LengthOfUTF16(const char16_t* utf16, size_t length)
+{
+    return utfConvertedLength<char16_t, char32_t>(utf16, length, ConvertUTF16toUTF32);
+}
+
+long getUTF8LengthOfUTF32(const char32_t* utf32, size_t length)
+{
+    return utfConvertedLength<char32_t, char>(utf32, length, ConvertUTF32toUTF8);
+}
+
+long getUTF16LengthOfUTF32(const char32_t* utf32, size_t length)
+{
+    return utfConvertedLength<char32_t, char16_t>(utf32, length, ConvertUTF32toUTF16);
+}
 
 bool UTF8ToUTF16(const std::string& utf8, std::u16string& outUtf16)
 {
@@ -280,7 +339,15 @@ bool UTF8ToUTF16(const std::string& utf8, std::u16string& outUtf16)
 
 bool UTF8ToUTF32(const std::string& utf8, std::u32string& outUtf32)
 {
-    return utfConvert(utf8, outUtf32, ConvertUTF8toUTF32);
+    // validate and size exactly first, so that outUtf32 is untouched on failure
+    const long length = getUTF32LengthOfUTF8(utf8.data(), utf8.length());
+    if (length < 0)
+        return false;
+
+    outUtf32.resize(length);
+    if (length > 0)
+        UTF8ToUTF32(utf8.data(), utf8.length(), &outUtf32[0], length);
+    return true;
 }
 
 bool UTF16ToUTF8(const std::u16string& utf16, std::string& outUtf8)
@@ -314,6 +381,24 @@ long getCharacterCountInUTF8String(const std::string& utf8)
 }
 
 
+namespace {
+    const std::size_t MIN_GAP = 16;
+
+    inline std::size_t nextChar(const std::vector<char>& buffer, std::size_t offset)
+    {
+        return offset + getNumBytesForUTF8(static_cast<UTF8>(buffer[offset]));
+    }
+
+    inline std::size_t prevChar(const std::vector<char>& buffer, std::size_t offset)
+    {
+        do
+        {
+            --offset;
+        } while ((static_cast<UTF8>(buffer[offset]) & 0xC0) == 0x80);
+        return offset;
+    }
+}
+
 StringUTF8::StringUTF8()
 {
 
@@ -331,37 +416,141 @@ StringUTF8::~StringUTF8()
 
 std::size_t StringUTF8::length() const
 {
-    return _str.size();
+    return _length;
 }
 
 void StringUTF8::replace(const std::string& newStr)
 {
-    _str.clear();
+    _buffer.clear();
+    _frontIndex.clear();
+    _backIndex.clear();
+    _gapBegin = _gapEnd = 0;
+    _gapChar = _length = 0;
     if (!newStr.empty())
     {
-        UTF8* sequenceUtf8 = (UTF8*)newStr.c_str();
-
-        int lengthString = getUTF8StringLength(sequenceUtf8);
+        long lengthString = getUTF32LengthOfUTF8(newStr.data(), newStr.length());
 
-        if (lengthString == 0)
+        if (lengthString <= 0)
         {
             printf("Bad utf-8 set string: %s", newStr.c_str());
             return;
         }
 
-        while (*sequenceUtf8)
+        _buffer.assign(newStr.begin(), newStr.end());
+        _gapBegin = _gapEnd = _buffer.size();
+        _gapChar = _length = lengthString;
+    }
+}
+
+std::size_t StringUTF8::offsetOf(std::size_t pos) const
+{
+    if (pos < _gapChar)
+    {
+        const std::size_t k = pos / INDEX_STRIDE;
+        if (_frontIndex.empty())
         {
-            std::size_t lengthChar = getNumBytesForUTF8(*sequenceUtf8);
+            _frontIndex.push_back(0);
+        }
+        while (_frontIndex.size() <= k)
+        {
+            std::size_t offset = _frontIndex.back();
+            for (std::size_t i = 0; i < INDEX_STRIDE; i++) offset = nextChar(_buffer, offset);
+            _frontIndex.push_back(offset);
+        }
+        std::size_t offset = _frontIndex[k];
+        for (std::size_t i = k * INDEX_STRIDE; i < pos; i++) offset = nextChar(_buffer, offset);
+        return offset;
+    }
+    if (pos >= _length)
+    {
+        return _buffer.size();
+    }
 
-            CharUTF8 charUTF8;
-            charUTF8._char.append((char*)sequenceUtf8, lengthChar);
-            sequenceUtf8 += lengthChar;
+    // the text after the gap is indexed by the distance from its last character
+    const std::size_t distance = _length - 1 - pos;
+    const std::size_t m = distance / INDEX_STRIDE;
+    if (_backIndex.empty())
+    {
+        _backIndex.push_back(prevChar(_buffer, _buffer.size()));
+    }
+    while (_backIndex.size() <= m)
+    {
+        std::size_t offset = _backIndex.back();
+        for (std::size_t i = 0; i < INDEX_STRIDE; i++) offset = prevChar(_buffer, offset);
+        _backIndex.push_back(offset);
+    }
+    std::size_t offset = _backIndex[m];
+    for (std::size_t i = m * INDEX_STRIDE; i < distance; i++) offset = prevChar(_buffer, offset);
+    return offset;
+}
 
-            _str.push_back(charUTF8);
+void StringUTF8::moveGap(std::size_t pos)
+{
+    if (pos == _gapChar) return;
+
+    const std::size_t offset = offsetOf(pos);
+    if (pos < _gapChar)
+    {
+        // the bytes of [pos, gap) move behind the gap, the back index stays valid
+        const std::size_t bytes = _gapBegin - offset;
+        memmove(&_buffer[_gapEnd - bytes], &_buffer[offset], bytes);
+        _gapBegin = offset;
+        _gapEnd -= bytes;
+        _frontIndex.resize(std::min(_frontIndex.size(), (pos + INDEX_STRIDE - 1) / INDEX_STRIDE));
+    }
+    else
+    {
+        const std::size_t bytes = offset - _gapEnd;
+        if (bytes > 0)
+        {
+            memmove(&_buffer[_gapBegin], &_buffer[_gapEnd], bytes);
         }
+        _gapBegin += bytes;
+        _gapEnd = offset;
+        _backIndex.resize(std::min(_backIndex.size(), (_length - pos + INDEX_STRIDE - 1) / INDEX_STRIDE));
+    }
+    _gapChar = pos;
+}
+
+void StringUTF8::reserveGap(std::size_t bytes)
+{
+    if (_gapEnd - _gapBegin >= bytes) return;
+
+    const std::size_t used = _buffer.size() - (_gapEnd - _gapBegin);
+    const std::size_t size = std::max(_buffer.size() * 2, used + bytes + MIN_GAP);
+    const std::size_t tail = _buffer.size() - _gapEnd;
+    const std::size_t delta = size - _buffer.size();
+
+    std::vector<char> buffer(size);
+    if (_gapBegin > 0) memcpy(buffer.data(), _buffer.data(), _gapBegin);
+    if (tail > 0) memcpy(buffer.data() + size - tail, _buffer.data() + _gapEnd, tail);
+    _buffer.swap(buffer);
+    _gapEnd += delta;
+    for (auto& offset : _backIndex)
+    {
+        offset += delta;
     }
 }
 
+bool StringUTF8::insertBytes(std::size_t pos, const char* utf8, std::size_t bytes, std::size_t chars)
+{
+    if (pos > _length)
+    {
+        return false;
+    }
+    if (bytes == 0)
+    {
+        return true;
+    }
+    moveGap(pos);
+    reserveGap(bytes);
+    memcpy(&_buffer[_gapBegin], utf8, bytes);
+    _gapBegin += bytes;
+    _gapChar += chars;
+    _length += chars;
+    return true;
+}
+
 std::string StringUTF8::getAsCharSequence() const
 {
     return getAsCharSequence(0, std::numeric_limits<std::size_t>::max());
@@ -375,26 +564,52 @@ std::string StringUTF8::getAsCharSequence(std::size_t pos) const
 std::string StringUTF8::getAsCharSequence(std::size_t pos, std::size_t len) const
 {
     std::string charSequence;
-    std::size_t maxLen = _str.size() - pos;
+    if (pos >= _length)
+    {
+        return charSequence;
+    }
+    std::size_t maxLen = _length - pos;
     if (len > maxLen)
     {
         len = maxLen;
     }
 
-    std::size_t endPos = len + pos;
-    while (pos < endPos)
+    const std::size_t begin = offsetOf(pos);
+    const std::size_t end = offsetOf(pos + len);
+    if (begin < _gapBegin && end >= _gapEnd)
+    {
+        charSequence.reserve((_gapBegin - begin) + (end - _gapEnd));
+        charSequence.append(&_buffer[begin], _gapBegin - begin);
+        charSequence.append(_buffer.data() + _gapEnd, end - _gapEnd);
+    }
+    else
     {
-        charSequence.append(_str[pos++]._char);
+        charSequence.assign(_buffer.data() + begin, end - begin);
     }
 
     return charSequence;
 }
 
+char32_t StringUTF8::getCharAt(std::size_t pos) const
+{
+    if (pos >= _length)
+    {
+        return 0;
+    }
+    const std::size_t offset = offsetOf(pos);
+    char32_t ch = 0;
+    UTF8ToUTF32(&_buffer[offset], nextChar(_buffer, offset) - offset, &ch, 1);
+    return ch;
+}
+
 bool StringUTF8::deleteChar(std::size_t pos)
 {
-    if (pos < _str.size())
+    if (pos < _length)
     {
-        _str.erase(_str.begin() + pos);
+        moveGap(pos);
+        _gapEnd = nextChar(_buffer, _gapEnd);
+        _length--;
+        _backIndex.resize(std::min(_backIndex.size(), (_length - pos + INDEX_STRIDE - 1) / INDEX_STRIDE));
         return true;
     }
     else
@@ -405,23 +620,51 @@ bool StringUTF8::deleteChar(std::size_t pos)
 
 bool StringUTF8::insert(std::size_t pos, const std::string& insertStr)
 {
-    StringUTF8 utf8(insertStr);
+    long chars = getUTF32LengthOfUTF8(insertStr.data(), insertStr.length());
+    if (chars < 0)
+    {
+        printf("Bad utf-8 insert string: %s", insertStr.c_str());
+        return false;
+    }
 
-    return insert(pos, utf8);
+    return insertBytes(pos, insertStr.data(), insertStr.length(), chars);
 }
 
 bool StringUTF8::insert(std::size_t pos, const StringUTF8& insertStr)
 {
-    if (pos <= _str.size())
+    if (&insertStr == this)
     {
-        _str.insert(_str.begin() + pos, insertStr._str.begin(), insertStr._str.end());
-
-        return true;
+        return insert(pos, insertStr.getAsCharSequence());
     }
-    else
+    if (pos > _length)
     {
         return false;
     }
+    const auto& src = insertStr._buffer;
+    const std::size_t tail = src.size() - insertStr._gapEnd;
+    return insertBytes(pos, src.data(), insertStr._gapBegin, insertStr._gapChar)
+        && insertBytes(pos + insertStr._gapChar, src.data() + insertStr._gapEnd, tail, insertStr._length - insertStr._gapChar);
+}
+
+std::size_t StringUTF8::getMemoryUsage() const
+{
+    return _buffer.capacity() + (_frontIndex.capacity() + _backIndex.capacity()) * sizeof(std::size_t);
+}
+
+StringUTF8::CharUTF8Store StringUTF8::getString() const
+{
+    CharUTF8Store str;
+    str.reserve(_length);
+    const std::string text = getAsCharSequence();
+    for (std::size_t i = 0; i < text.size(); )
+    {
+        const std::size_t bytes = getNumBytesForUTF8(static_cast<UTF8>(text[i]));
+        CharUTF8 charUTF8;
+        charUTF8._char.assign(text, i, bytes);
+        str.push_back(std::move(charUTF8));
+        i += bytes;
+    }
+    return str;
 }
 
 } //namespace StringUtils {
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstdint>
 
 
 namespace StringUtils {
@@ -61,6 +62,81 @@ bool UTF8ToUTF16(const std::string& inUtf8, std::u16string& outUtf16);
  */
 bool UTF8ToUTF32(const std::string& inUtf8, std::u32string& outUtf32);
 
+/**
+ *  @brief Decodes UTF8 into a caller supplied buffer.
+ *
+ *  Runs of ASCII are validated and widened with SIMD when available.
+ *
+ *  @param utf8 The UTF8 bytes, not required to be null terminated.
+ *  @param length The number of bytes of \p utf8.
+ *  @param out The buffer receiving the UTF32 characters.
+ *  @param outCapacity The number of characters \p out can hold.
+ *  @return The number of characters written, or -1 if the input is not
+ *          valid UTF8 or \p out is too small.
+ */
+long UTF8ToUTF32(const char* utf8, size_t length, char32_t* out, size_t outCapacity);
+
+/**
+ *  @brief Returns the exact number of UTF32 characters \p utf8 decodes to,
+ *         or -1 if it is not valid UTF8.
+ */
+long getUTF32LengthOfUTF8(const char* utf8, size_t length);
+
+/**
+ *  @brief Converts into a caller supplied buffer without allocating.
+ *
+ *  The std::string overloads size their output exactly and convert in place,
+ *  so a reused output string only allocates when it has to grow.
+ *
+ *  @return The number of code units written, or -1 if the input is not valid
+ *          or \p outCapacity is too small.
+ *  @see getUTF16LengthOfUTF8 and the other helpers below to size \p out.
+ */
+long UTF8ToUTF16(const char* utf8, size_t length, char16_t* out, size_t outCapacity);
+long UTF16ToUTF8(const char16_t* utf16, size_t length, char* out, size_t outCapacity);
+long UTF16ToUTF32(const char16_t* utf16, size_t length, char32_t* out, size_t outCapacity);
+long UTF32ToUTF8(const char32_t* utf32, size_t length, char* out, size_t outCapacity);
+long UTF32ToUTF16(const char32_t* utf32, size_t length, char16_t* out, size_t outCapacity);
+
+/**
+ *  @brief Returns the exact number of code units the conversion produces,
+ *         or -1 if the input is not valid.
+ */
+long getUTF16LengthOfUTF8(const char* utf8, size_t length);
+long getUTF8LengthOfUTF16(const char16_t* utf16, size_t length);
+long getUTF32LengthOfUTF16(const char16_t* utf16, size_t length);
+long getUTF8LengthOfUTF32(const char32_t* utf32, size_t length);
+long getUTF16LengthOfUTF32(const char32_t* utf32, size_t length);
+
+/**
+ *  @brief Decodes UTF8 delivered in chunks.
+ *
+ *  A sequence split across two chunks is held back until the next chunk
+ *  completes it, so the input may be cut at any byte.
+ */
+class UTF8StreamDecoder
+{
+public:
+    /**
+     *  @brief Appends the characters of the next \p length bytes to \p out.
+     *  @return False if the input is not valid UTF8, the decoder must be
+     *          reset before it is used again.
+     */
+    bool decode(const char* data, size_t length, std::u32string& out);
+
+    /**
+     *  @brief Ends the stream.
+     *  @return False if it stopped in the middle of a sequence.
+     */
+    bool finish();
+
+    void reset() { _pendingLength = 0; }
+
+private:
+    char _pending[4];
+    size_t _pendingLength = 0;
+};
+
 /**
  *  @brief Same as \a UTF8ToUTF16 but converts form UTF16 to UTF8.
  *
@@ -134,6 +210,53 @@ bool isCJKUnicode(char32_t ch);
  */
 bool isUnicodeNonBreaking(char32_t ch);
     
+namespace UnicodeProperty {
+    const uint16_t Space                  = 1 << 0;
+    const uint16_t CJK                    = 1 << 1;
+    const uint16_t NonBreaking            = 1 << 2;
+    const uint16_t Combining              = 1 << 3;
+    const uint16_t BreakClassShift        = 4;
+    const uint16_t BreakClassMask         = 0xF << BreakClassShift;
+}
+
+/**
+ *  @brief Simplified line breaking classes, see UAX #14.
+ */
+enum class LineBreakClass : uint8_t {
+    OTHER,          // letters, digits and symbols, no break inside a word
+    MANDATORY,      // line and paragraph separators
+    SPACE,          // break after
+    GLUE,           // no break on either side
+    IDEOGRAPHIC,    // break before and after
+    OPEN,           // no break after
+    CLOSE,          // no break before
+    BREAK_AFTER,    // hyphens
+    COMBINING,      // takes the class of the base character
+};
+
+/**
+ *  @brief Returns the UnicodeProperty flags and the line breaking class of
+ *         \p ch in one table lookup.
+ *
+ *  The two-stage table is built at compile time.
+ */
+uint16_t getUnicodeProperties(char32_t ch);
+
+/**
+ *  @brief Classifies \p length characters of \p text into \p out.
+ */
+void getUnicodeProperties(const char32_t* text, size_t length, uint16_t* out);
+
+/**
+ *  @brief Same as above for a whole string, \p out is resized to its length.
+ */
+void getUnicodeProperties(const std::u32string& text, std::vector<uint16_t>& out);
+
+inline LineBreakClass getLineBreakClass(uint16_t properties)
+{
+    return static_cast<LineBreakClass>((properties & UnicodeProperty::BreakClassMask) >> UnicodeProperty::BreakClassShift);
+}
+
 /**
  *  @brief Returns the length of the string in characters.
  *  @param utf8 An UTF-8 encoded string.
@@ -158,7 +281,15 @@ std::vector<char16_t> getChar16VectorFromUTF16String(const std::u16string& utf16
 
 /**
 * Utf8 sequence
-* Store all utf8 chars as std::string
+* Stores the text as one UTF8 buffer with a gap at the last edit position, so
+* that edits around a cursor only move the bytes between two cursor positions.
+* Every 64th character of the text before and after the gap has its byte
+* offset indexed, the index is built lazily and only the entries behind an
+* edit are dropped. Offsets of the text after the gap are counted from its
+* end, edits in front of them do not invalidate them.
+* An edit far from the previous one moves every byte in between, it costs
+* O(distance) rather than O(log n): fine for a text field, slow for random
+* edits all over a large document.
 * Build from std::string
 */
 class StringUTF8
@@ -171,6 +302,8 @@ public:
     };
     typedef std::vector<CharUTF8> CharUTF8Store;
 
+    static const std::size_t INDEX_STRIDE = 64;
+
     StringUTF8();
     StringUTF8(const std::string& newStr);
     ~StringUTF8();
@@ -182,15 +315,42 @@ public:
     std::string getAsCharSequence(std::size_t pos) const;
     std::string getAsCharSequence(std::size_t pos, std::size_t len) const;
 
+    /**
+     *  @brief Returns the character at \p pos, 0 if \p pos is out of range.
+     */
+    char32_t getCharAt(std::size_t pos) const;
+
     bool deleteChar(std::size_t pos);
     bool insert(std::size_t pos, const std::string& insertStr);
     bool insert(std::size_t pos, const StringUTF8& insertStr);
 
-    CharUTF8Store& getString() { return _str; }
-    const CharUTF8Store& getString() const { return _str; }
+    /**
+     *  @brief Bytes held by the buffer and the index.
+     */
+    std::size_t getMemoryUsage() const;
+
+    /**
+     *  @brief A copy of the text split into characters, changing it does not edit this string.
+     *  @deprecated Allocates a string per character, use getCharAt() or getAsCharSequence().
+     */
+    [[deprecated("use getCharAt() or getAsCharSequence()")]]
+    CharUTF8Store getString() const;
 
 private:
-    CharUTF8Store _str;
+    std::size_t offsetOf(std::size_t pos) const;
+    void moveGap(std::size_t pos);
+    void reserveGap(std::size_t bytes);
+    bool insertBytes(std::size_t pos, const char* utf8, std::size_t bytes, std::size_t chars);
+
+    std::vector<char> _buffer;
+    std::size_t _gapBegin = 0;
+    std::size_t _gapEnd = 0;
+    std::size_t _gapChar = 0;   // characters in front of the gap
+    std::size_t _length = 0;
+    // buffer offsets of characters 0, 64, 128... in front of the gap
+    mutable std::vector<std::size_t> _frontIndex;
+    // buffer offsets of the characters 0, 64, 128... places before the end
+    mutable std::vector<std::size_t> _backIndex;
 };
 
 } // namespace StringUtils {
@@ -0,0 +1,292 @@
+/*
+ * UTF-8 -> UTF-32 decoding with a vectorized ASCII path.
+ *
+ * Blocks of 32 (AVX2), 16 (SSE2, NEON) or 8 (portable) bytes without the high
+ * bit set are widened at once, any other byte goes through a strict scalar
+ * decoder which rejects the same input as ConvertUTF8toUTF32 in strict mode:
+ * overlong forms, surrogates, code points above U+10FFFF and truncated
+ * sequences.
+ */
+
+#include "ccUTF8.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define UTF8_DECODE_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF8_DECODE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define UTF8_DECODE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+    // bytes decoded by the scalar path before trying the vector path again
+    const size_t SCALAR_SPAN = 32;
+
+    // returns the number of bytes consumed, 0 if the sequence is invalid
+    inline int decodeSequence(const uint8_t* s, const uint8_t* end, char32_t& cp)
+    {
+        const uint8_t b0 = s[0];
+        if (b0 < 0x80)
+        {
+            cp = b0;
+            return 1;
+        }
+        const size_t avail = end - s;
+        if (b0 < 0xC2)
+        {
+            return 0;
+        }
+        if (b0 < 0xE0)
+        {
+            if (avail < 2 || (s[1] & 0xC0) != 0x80) return 0;
+            cp = ((b0 & 0x1F) << 6) | (s[1] & 0x3F);
+            return 2;
+        }
+        if (b0 < 0xF0)
+        {
+            if (avail < 3) return 0;
+            const uint8_t b1 = s[1];
+            if ((b1 & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80) return 0;
+            if (b0 == 0xE0 && b1 < 0xA0) return 0;     // overlong
+            if (b0 == 0xED && b1 >= 0xA0) return 0;    // surrogates
+            cp = ((b0 & 0x0F) << 12) | ((b1 & 0x3F) << 6) | (s[2] & 0x3F);
+            return 3;
+        }
+        if (b0 < 0xF5)
+        {
+            if (avail < 4) return 0;
+            const uint8_t b1 = s[1];
+            if ((b1 & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80) return 0;
+            if (b0 == 0xF0 && b1 < 0x90) return 0;     // overlong
+            if (b0 == 0xF4 && b1 >= 0x90) return 0;    // > U+10FFFF
+            cp = ((b0 & 0x07) << 18) | ((b1 & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+            return 4;
+        }
+        return 0;
+    }
+
+    // length of the leading run of whole ASCII blocks in s[0, n)
+    inline size_t asciiBlocks(const uint8_t* s, size_t n)
+    {
+        size_t i = 0;
+#if UTF8_DECODE_AVX2
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            if (_mm256_movemask_epi8(v)) return i;
+        }
+#endif
+#if UTF8_DECODE_AVX2 || UTF8_DECODE_SSE2
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            if (_mm_movemask_epi8(v)) return i;
+        }
+#elif UTF8_DECODE_NEON
+        for (; i + 16 <= n; i += 16)
+        {
+            if (vmaxvq_u8(vld1q_u8(s + i)) >= 0x80) return i;
+        }
+#endif
+        for (; i + 8 <= n; i += 8)
+        {
+            uint64_t w;
+            memcpy(&w, s + i, 8);
+            if (w & 0x8080808080808080ULL) return i;
+        }
+        return i;
+    }
+
+    // widens the leading ASCII blocks of s[0, n) into out, returns the bytes consumed
+    inline size_t widenASCII(const uint8_t* s, size_t n, char32_t* out)
+    {
+        size_t i = 0;
+#if UTF8_DECODE_AVX2
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            if (_mm256_movemask_epi8(v)) return i;
+            for (int k = 0; k < 4; k++)
+            {
+                __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s + i + k * 8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + k * 8), _mm256_cvtepu8_epi32(bytes));
+            }
+        }
+#endif
+#if UTF8_DECODE_AVX2 || UTF8_DECODE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            if (_mm_movemask_epi8(v)) return i;
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            __m128i* dst = reinterpret_cast<__m128i*>(out + i);
+            _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+        }
+#elif UTF8_DECODE_NEON
+        for (; i + 16 <= n; i += 16)
+        {
+            uint8x16_t v = vld1q_u8(s + i);
+            if (vmaxvq_u8(v) >= 0x80) return i;
+            uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+            uint32_t* dst = reinterpret_cast<uint32_t*>(out + i);
+            vst1q_u32(dst + 0, vmovl_u16(vget_low_u16(lo)));
+            vst1q_u32(dst + 4, vmovl_u16(vget_high_u16(lo)));
+            vst1q_u32(dst + 8, vmovl_u16(vget_low_u16(hi)));
+            vst1q_u32(dst + 12, vmovl_u16(vget_high_u16(hi)));
+        }
+#endif
+        for (; i + 8 <= n; i += 8)
+        {
+            uint64_t w;
+            memcpy(&w, s + i, 8);
+            if (w & 0x8080808080808080ULL) return i;
+            for (int k = 0; k < 8; k++)
+            {
+                out[i + k] = s[i + k];
+            }
+        }
+        return i;
+    }
+}
+
+namespace StringUtils {
+
+long getUTF32LengthOfUTF8(const char* utf8, size_t length)
+{
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(utf8);
+    const uint8_t* end = s + length;
+    long count = 0;
+    char32_t cp;
+    while (s < end)
+    {
+        size_t ascii = asciiBlocks(s, end - s);
+        s += ascii;
+        count += static_cast<long>(ascii);
+
+        // stay scalar for a while, mixed text rarely has a whole ASCII block
+        const uint8_t* stop = s + std::min<size_t>(end - s, SCALAR_SPAN);
+        while (s < stop)
+        {
+            int n = decodeSequence(s, end, cp);
+            if (n == 0) return -1;
+            s += n;
+            count++;
+        }
+    }
+    return count;
+}
+
+long UTF8ToUTF32(const char* utf8, size_t length, char32_t* out, size_t outCapacity)
+{
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(utf8);
+    const uint8_t* end = s + length;
+    size_t o = 0;
+    while (s < end)
+    {
+        size_t ascii = widenASCII(s, std::min<size_t>(end - s, outCapacity - o), out + o);
+        s += ascii;
+        o += ascii;
+
+        const uint8_t* stop = s + std::min<size_t>(end - s, SCALAR_SPAN);
+        while (s < stop)
+        {
+            if (o == outCapacity) return -1;
+            int n = decodeSequence(s, end, out[o]);
+            if (n == 0) return -1;
+            s += n;
+            o++;
+        }
+    }
+    return static_cast<long>(o);
+}
+
+} // namespace StringUtils
+
+namespace {
+
+    // length of the sequence started by lead byte b, 1 for bytes which can not start one
+    inline size_t sequenceLength(uint8_t b)
+    {
+        if (b < 0xC0) return 1;
+        if (b < 0xE0) return 2;
+        if (b < 0xF0) return 3;
+        if (b < 0xF8) return 4;
+        return 1;
+    }
+}
+
+namespace StringUtils {
+
+bool UTF8StreamDecoder::decode(const char* data, size_t length, std::u32string& out)
+{
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = s + length;
+
+    if (_pendingLength > 0)
+    {
+        const size_t need = sequenceLength(static_cast<uint8_t>(_pending[0]));
+        while (_pendingLength < need && s < end)
+        {
+            if ((*s & 0xC0) != 0x80) return false;
+            _pending[_pendingLength++] = static_cast<char>(*s++);
+        }
+        if (_pendingLength < need) return true;
+
+        char32_t ch;
+        if (UTF8ToUTF32(_pending, _pendingLength, &ch, 1) != 1) return false;
+        out.push_back(ch);
+        _pendingLength = 0;
+    }
+
+    // hold back a sequence cut by the end of the chunk
+    const uint8_t* tail = end;
+    for (const uint8_t* p = end; p > s && end - p < 4;)
+    {
+        --p;
+        if ((*p & 0xC0) != 0x80)
+        {
+            if (sequenceLength(*p) > static_cast<size_t>(end - p)) tail = p;
+            break;
+        }
+    }
+
+    const size_t bodyLength = tail - s;
+    if (bodyLength > 0)
+    {
+        const size_t offset = out.length();
+        out.resize(offset + bodyLength);
+        long count = UTF8ToUTF32(reinterpret_cast<const char*>(s), bodyLength, &out[offset], bodyLength);
+        if (count < 0)
+        {
+            out.resize(offset);
+            return false;
+        }
+        out.resize(offset + count);
+    }
+
+    memcpy(_pending, tail, end - tail);
+    _pendingLength = end - tail;
+    return true;
+}
+
+bool UTF8StreamDecoder::finish()
+{
+    const bool complete = _pendingLength == 0;
+    _pendingLength = 0;
+    return complete;
+}
+
+} // namespace StringUtils
@@ -0,0 +1,261 @@
+/*
+ * Two-stage Unicode property table.
+ *
+ * The properties are listed as ranges below, the table is built from them at
+ * compile time: stage 1 maps every block of 256 code points to a block of
+ * stage 2, blocks whose code points all share the same properties share one
+ * stage 2 block.
+ */
+
+#include "ccUTF8.h"
+
+#include <algorithm>
+
+namespace {
+
+    using namespace StringUtils::UnicodeProperty;
+    using StringUtils::LineBreakClass;
+
+    struct PropertyRange {
+        char32_t first;
+        char32_t last;
+        uint16_t properties;
+    };
+
+    constexpr uint16_t breakClass(LineBreakClass c)
+    {
+        return static_cast<uint16_t>(c) << BreakClassShift;
+    }
+
+    const uint16_t IDEOGRAPHIC = CJK | breakClass(LineBreakClass::IDEOGRAPHIC);
+    const uint16_t MANDATORY = breakClass(LineBreakClass::MANDATORY);
+    const uint16_t BREAKING_SPACE = Space | breakClass(LineBreakClass::SPACE);
+    const uint16_t GLUE = breakClass(LineBreakClass::GLUE);
+    const uint16_t OPEN = breakClass(LineBreakClass::OPEN);
+    const uint16_t CLOSE = breakClass(LineBreakClass::CLOSE);
+    const uint16_t HYPHEN = breakClass(LineBreakClass::BREAK_AFTER);
+    const uint16_t MARK = Combining | breakClass(LineBreakClass::COMBINING);
+
+    // applied in order, flags add up and a later break class replaces an earlier one
+    constexpr PropertyRange RANGES[] = {
+        { 0x4E00, 0x9FBF, IDEOGRAPHIC },    // CJK Unified Ideographs
+        { 0x2E80, 0x2FDF, IDEOGRAPHIC },    // CJK Radicals Supplement & Kangxi Radicals
+        { 0x2FF0, 0x30FF, IDEOGRAPHIC },    // Ideographic Description Characters, CJK Symbols and Punctuation & Japanese
+        { 0x3100, 0x31BF, IDEOGRAPHIC },    // Korean
+        { 0xAC00, 0xD7AF, IDEOGRAPHIC },    // Hangul Syllables
+        { 0xF900, 0xFAFF, IDEOGRAPHIC },    // CJK Compatibility Ideographs
+        { 0xFE30, 0xFE4F, IDEOGRAPHIC },    // CJK Compatibility Forms
+        { 0x31C0, 0x4DFF, IDEOGRAPHIC },    // Other extensions
+        { 0x1F004, 0x1F682, IDEOGRAPHIC },  // Emoji
+
+        { 0x0009, 0x000D, BREAKING_SPACE },
+        { 0x000A, 0x000D, MANDATORY },
+        { 0x0020, 0x0020, BREAKING_SPACE },
+        { 0x0085, 0x0085, Space | MANDATORY },
+        { 0x00A0, 0x00A0, Space | NonBreaking | GLUE },  // Non-Breaking Space
+        { 0x1680, 0x1680, BREAKING_SPACE },
+        { 0x2000, 0x200A, BREAKING_SPACE },
+        { 0x2007, 0x2007, NonBreaking | GLUE },          // Figure Space
+        { 0x2028, 0x2029, Space | MANDATORY },
+        { 0x202F, 0x202F, Space | NonBreaking | GLUE },  // Narrow Non-Breaking Space
+        { 0x205F, 0x205F, BREAKING_SPACE },
+        { 0x2060, 0x2060, NonBreaking | GLUE },          // Word Joiner
+        { 0x3000, 0x3000, BREAKING_SPACE },
+        { 0xFEFF, 0xFEFF, GLUE },
+
+        { '(', '(', OPEN }, { '[', '[', OPEN }, { '{', '{', OPEN },
+        { 0x3008, 0x3008, OPEN }, { 0x300A, 0x300A, OPEN }, { 0x300C, 0x300C, OPEN },
+        { 0x300E, 0x300E, OPEN }, { 0x3010, 0x3010, OPEN }, { 0x3014, 0x3014, OPEN },
+        { 0x3016, 0x3016, OPEN }, { 0x3018, 0x3018, OPEN }, { 0x301A, 0x301A, OPEN },
+        { 0xFF08, 0xFF08, OPEN }, { 0xFF3B, 0xFF3B, OPEN }, { 0xFF5B, 0xFF5B, OPEN },
+
+        { '!', '!', CLOSE }, { ')', ')', CLOSE }, { ',', ',', CLOSE }, { '.', '.', CLOSE },
+        { ':', ';', CLOSE }, { '?', '?', CLOSE }, { ']', ']', CLOSE }, { '}', '}', CLOSE },
+        { 0x3001, 0x3002, CLOSE }, { 0x3009, 0x3009, CLOSE }, { 0x300B, 0x300B, CLOSE },
+        { 0x300D, 0x300D, CLOSE }, { 0x300F, 0x300F, CLOSE }, { 0x3011, 0x3011, CLOSE },
+        { 0x3015, 0x3015, CLOSE }, { 0x3017, 0x3017, CLOSE }, { 0x3019, 0x3019, CLOSE },
+        { 0x301B, 0x301B, CLOSE }, { 0xFF01, 0xFF01, CLOSE }, { 0xFF09, 0xFF09, CLOSE },
+        { 0xFF0C, 0xFF0C, CLOSE }, { 0xFF0E, 0xFF0E, CLOSE }, { 0xFF1A, 0xFF1B, CLOSE },
+        { 0xFF1F, 0xFF1F, CLOSE }, { 0xFF3D, 0xFF3D, CLOSE }, { 0xFF5D, 0xFF5D, CLOSE },
+
+        { '-', '-', HYPHEN }, { 0x00AD, 0x00AD, HYPHEN }, { 0x2010, 0x2010, HYPHEN },
+        { 0x2012, 0x2013, HYPHEN },
+
+        { 0x0300, 0x036F, MARK },   // Combining Diacritical Marks
+        { 0x0483, 0x0489, MARK },   // Cyrillic
+        { 0x0591, 0x05BD, MARK },   // Hebrew
+        { 0x05BF, 0x05BF, MARK },
+        { 0x05C1, 0x05C2, MARK },
+        { 0x05C4, 0x05C5, MARK },
+        { 0x05C7, 0x05C7, MARK },
+        { 0x0610, 0x061A, MARK },   // Arabic
+        { 0x064B, 0x065F, MARK },
+        { 0x0670, 0x0670, MARK },
+        { 0x06D6, 0x06DC, MARK },
+        { 0x06DF, 0x06E4, MARK },
+        { 0x0900, 0x0903, MARK },   // Devanagari
+        { 0x093A, 0x094F, MARK },
+        { 0x0951, 0x0957, MARK },
+        { 0x0962, 0x0963, MARK },
+        { 0x0E31, 0x0E31, MARK },   // Thai
+        { 0x0E34, 0x0E3A, MARK },
+        { 0x0E47, 0x0E4E, MARK },
+        { 0x1AB0, 0x1AFF, MARK },   // Combining Diacritical Marks Extended
+        { 0x1DC0, 0x1DFF, MARK },   // Combining Diacritical Marks Supplement
+        { 0x200C, 0x200D, MARK },   // Zero Width Non-Joiner & Joiner
+        { 0x20D0, 0x20FF, MARK },   // Combining Diacritical Marks for Symbols
+        { 0x3099, 0x309A, MARK },   // Kana voiced sound marks
+        { 0xFE00, 0xFE0F, MARK },   // Variation Selectors
+        { 0xFE20, 0xFE2F, MARK },   // Combining Half Marks
+        { 0xE0020, 0xE007F, MARK }, // Tags
+        { 0xE0100, 0xE01EF, MARK }, // Variation Selectors Supplement
+    };
+    constexpr size_t RANGE_COUNT = sizeof(RANGES) / sizeof(RANGES[0]);
+
+    const unsigned BLOCK_BITS = 8;
+    const size_t BLOCK_SIZE = 1 << BLOCK_BITS;
+    const size_t BLOCK_COUNT = 0x110000 >> BLOCK_BITS;
+    const size_t MAX_UNIFORM = 16;
+
+    constexpr uint16_t apply(uint16_t properties, uint16_t range)
+    {
+        return (range & BreakClassMask) ? ((properties | range) & ~BreakClassMask) | (range & BreakClassMask) : properties | range;
+    }
+
+    struct BlockInfo {
+        uint16_t properties[BLOCK_COUNT];   // of all code points, unless mixed
+        bool mixed[BLOCK_COUNT];
+    };
+
+    constexpr BlockInfo analyzeBlocks()
+    {
+        BlockInfo info{};
+        for (size_t r = 0; r < RANGE_COUNT; r++)
+        {
+            const PropertyRange& range = RANGES[r];
+            const size_t firstBlock = range.first >> BLOCK_BITS;
+            const size_t lastBlock = range.last >> BLOCK_BITS;
+            if (range.first % BLOCK_SIZE != 0) info.mixed[firstBlock] = true;
+            if (range.last % BLOCK_SIZE != BLOCK_SIZE - 1) info.mixed[lastBlock] = true;
+            for (size_t b = firstBlock; b <= lastBlock; b++)
+            {
+                info.properties[b] = apply(info.properties[b], range.properties);
+            }
+        }
+        return info;
+    }
+
+    struct TrieLayout {
+        size_t mixed;
+        size_t uniform;
+        uint16_t uniformProperties[MAX_UNIFORM];
+    };
+
+    constexpr TrieLayout layoutTrie()
+    {
+        const BlockInfo info = analyzeBlocks();
+        TrieLayout layout{};
+        layout.uniform = 1; // properties 0, also used for code points above U+10FFFF
+        for (size_t b = 0; b < BLOCK_COUNT; b++)
+        {
+            if (info.mixed[b])
+            {
+                layout.mixed++;
+                continue;
+            }
+            size_t u = 0;
+            while (u < layout.uniform && layout.uniformProperties[u] != info.properties[b]) u++;
+            if (u == layout.uniform && u < MAX_UNIFORM)
+            {
+                layout.uniformProperties[layout.uniform++] = info.properties[b];
+            }
+        }
+        return layout;
+    }
+
+    template<size_t STAGE2_BLOCKS>
+    struct PropertyTrie {
+        uint16_t stage1[BLOCK_COUNT + 1];
+        uint16_t stage2[STAGE2_BLOCKS * BLOCK_SIZE];
+    };
+
+    template<size_t STAGE2_BLOCKS>
+    constexpr PropertyTrie<STAGE2_BLOCKS> buildTrie(const TrieLayout layout)
+    {
+        const BlockInfo info = analyzeBlocks();
+        PropertyTrie<STAGE2_BLOCKS> trie{};
+
+        // the blocks of uniform properties come first
+        for (size_t u = 0; u < layout.uniform; u++)
+        {
+            for (size_t i = 0; i < BLOCK_SIZE; i++)
+            {
+                trie.stage2[u * BLOCK_SIZE + i] = layout.uniformProperties[u];
+            }
+        }
+
+        size_t next = layout.uniform;
+        for (size_t b = 0; b < BLOCK_COUNT; b++)
+        {
+            if (!info.mixed[b])
+            {
+                size_t u = 0;
+                while (layout.uniformProperties[u] != info.properties[b]) u++;
+                trie.stage1[b] = static_cast<uint16_t>(u);
+                continue;
+            }
+
+            const char32_t blockFirst = static_cast<char32_t>(b << BLOCK_BITS);
+            const char32_t blockLast = blockFirst + BLOCK_SIZE - 1;
+            uint16_t* block = trie.stage2 + next * BLOCK_SIZE;
+            for (size_t r = 0; r < RANGE_COUNT; r++)
+            {
+                const PropertyRange& range = RANGES[r];
+                if (range.last < blockFirst || range.first > blockLast) continue;
+                const char32_t first = range.first > blockFirst ? range.first : blockFirst;
+                const char32_t last = range.last < blockLast ? range.last : blockLast;
+                for (char32_t ch = first; ch <= last; ch++)
+                {
+                    block[ch - blockFirst] = apply(block[ch - blockFirst], range.properties);
+                }
+            }
+            trie.stage1[b] = static_cast<uint16_t>(next++);
+        }
+        trie.stage1[BLOCK_COUNT] = 0;
+        return trie;
+    }
+
+    constexpr TrieLayout LAYOUT = layoutTrie();
+    static_assert(LAYOUT.uniform < MAX_UNIFORM, "too many kinds of uniform blocks");
+
+    constexpr PropertyTrie<LAYOUT.mixed + LAYOUT.uniform> TRIE = buildTrie<LAYOUT.mixed + LAYOUT.uniform>(LAYOUT);
+
+    inline uint16_t lookup(char32_t ch)
+    {
+        const size_t block = std::min<size_t>(ch >> BLOCK_BITS, BLOCK_COUNT);
+        return TRIE.stage2[TRIE.stage1[block] * BLOCK_SIZE + (ch & (BLOCK_SIZE - 1))];
+    }
+}
+
+namespace StringUtils {
+
+uint16_t getUnicodeProperties(char32_t ch)
+{
+    return lookup(ch);
+}
+
+void getUnicodeProperties(const char32_t* text, size_t length, uint16_t* out)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        out[i] = lookup(text[i]);
+    }
+}
+
+void getUnicodeProperties(const std::u32string& text, std::vector<uint16_t>& out)
+{
+    out.resize(text.length());
+    getUnicodeProperties(text.data(), text.length(), out.data());
+}
+
+} // namespace StringUtils